@@ -18,7 +18,7 @@
 # the exit code is 143 in this case.
 
 
-gcc -o build/etherate_mt src/main.c -lpthread -Wall -Werror -pedantic -ftrapv -O0 -g --std=c11 -Wjump-misses-init -Wlogical-op -Wshadow -Wformat=2 -Wformat-signedness -Wextra -Wdouble-promotion -Winit-self -Wtrampolines -Wcast-qual -Wcast-align -Wwrite-strings
+gcc -o build/etherate_mt src/main.c -lpthread -lm -Wall -Werror -pedantic -ftrapv -O0 -g --std=c11 -Wjump-misses-init -Wlogical-op -Wshadow -Wformat=2 -Wformat-signedness -Wextra -Wdouble-promotion -Winit-self -Wtrampolines -Wcast-qual -Wcast-align -Wwrite-strings
 
 if [ $? -ne 0 ]
 then
@@ -36,7 +36,7 @@ fi
 
 
 
-gcc -o build/etherate_mt src/main.c -pthread -Wall -Werror -O0 -g -fsanitize=leak -fsanitize=address -fno-omit-frame-pointer  -fno-common -fsanitize=bounds -fsanitize=undefined
+gcc -o build/etherate_mt src/main.c -pthread -lm -Wall -Werror -O0 -g -fsanitize=leak -fsanitize=address -fno-omit-frame-pointer  -fno-common -fsanitize=bounds -fsanitize=undefined
 
 if [ $? -ne 0 ]
 then
@@ -54,7 +54,7 @@ fi
 
 
 
-gcc -o build/etherate_mt src/main.c -pthread -Wall -Werror -O0 -g -fsanitize=thread
+gcc -o build/etherate_mt src/main.c -pthread -lm -Wall -Werror -O0 -g -fsanitize=thread
 
 if [ $? -ne 0 ]
 then
@@ -72,7 +72,7 @@ fi
 
 
 
-gcc -o build/etherate_mt src/main.c -lpthread -O3 --std=c11
+gcc -o build/etherate_mt src/main.c -lpthread -lm -O3 --std=c11
 
 
 if [ $? -ne 0 ]
@@ -0,0 +1,793 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "affinity.h"
+
+
+
+uint16_t cpu_irq_if(struct etherate *eth, uint16_t if_idx, cpu_set_t *cpus) {
+
+    uint8_t  *if_name = eth->sk_opt.if_opt[if_idx].if_name;
+    char     *line = NULL;
+    size_t   line_sz = 0;
+    size_t   name_len = strlen((char*)if_name);
+    uint16_t irq_nr = 0;
+
+    // IRQ actions are named after the interface (e.g. "eth0-TxRx-0"), drivers
+    // which name them after the PCI device aren't found here
+    FILE *irq_file = fopen("/proc/interrupts", "r");
+    if (irq_file == NULL)
+        return 0;
+
+    while (getline(&line, &line_sz, irq_file) != -1) {
+
+        char *end = NULL;
+        unsigned long irq = strtoul(line, &end, 10);
+
+        // Skip the header and the non-numeric NMI, LOC, etc. rows
+        if (end == line || *end != ':')
+            continue;
+
+        // Match the name as a whole word so that eth1 doesn't match eth10
+        char *name = line;
+        uint8_t found = 0;
+        while ((name = strstr(name, (char*)if_name)) != NULL) {
+            char next = name[name_len];
+            if ((name == line || name[-1] == ' ') &&
+                (next == '-' || next == '@' || next == '\n' || next == '\0' || next == ' '))
+            {
+                found = 1;
+                break;
+            }
+            name += name_len;
+        }
+
+        if (!found)
+            continue;
+
+        // Per-queue IRQs end in the queue number (e.g. "eth0-TxRx-3",
+        // "eth0-rx-3"), record which IRQ serves each Rx/Tx queue. Queues
+        // are only mapped with a single interface.
+        char *suffix = name + name_len;
+        char *q_str = NULL;
+        for (char *c = suffix; *c != '\0' && *c != ' ' && *c != '\n'; c += 1) {
+            if (*c >= '0' && *c <= '9') {
+                if (q_str == NULL) q_str = c;
+            } else {
+                q_str = NULL;
+            }
+        }
+
+        if (q_str != NULL && if_idx == 0) {
+            uint16_t q = (uint16_t)strtoul(q_str, NULL, 10);
+            uint8_t is_rx = (strcasestr(suffix, "rx") != NULL);
+            uint8_t is_tx = (strcasestr(suffix, "tx") != NULL);
+            // Combined queues (e.g. "TxRx", "comp") serve both directions
+            if (is_rx == is_tx) {
+                is_rx = 1;
+                is_tx = 1;
+            }
+            if (is_rx && q < eth->app_opt.q_rx_nr)
+                eth->app_opt.q_rx_irq[q] = (int32_t)irq;
+            if (is_tx && q < eth->app_opt.q_tx_nr)
+                eth->app_opt.q_tx_irq[q] = (int32_t)irq;
+        }
+
+        char path[64];
+        cpu_set_t irq_cpus;
+
+        // effective_affinity_list is where the IRQ is delivered, older Kernels
+        // only have the requested smp_affinity_list
+        snprintf(path, sizeof(path), "/proc/irq/%lu/effective_affinity_list", irq);
+        if (cpu_list_read(path, &irq_cpus) != EXIT_SUCCESS) {
+            snprintf(path, sizeof(path), "/proc/irq/%lu/smp_affinity_list", irq);
+            if (cpu_list_read(path, &irq_cpus) != EXIT_SUCCESS)
+                continue;
+        }
+
+        CPU_OR(cpus, cpus, &irq_cpus);
+        irq_nr += 1;
+
+    }
+
+    free(line);
+    fclose(irq_file);
+
+    return irq_nr;
+
+}
+
+
+
+int32_t cpu_list_parse(const char *list, cpu_set_t *cpus) {
+
+    const char *pos = list;
+    char *end = NULL;
+
+    CPU_ZERO(cpus);
+
+    while (*pos != '\0' && *pos != '\n') {
+
+        unsigned long first = strtoul(pos, &end, 10);
+        unsigned long last = first;
+
+        if (end == pos)
+            return EXIT_FAILURE;
+
+        if (*end == '-') {
+            pos = end + 1;
+            last = strtoul(pos, &end, 10);
+            if (end == pos)
+                return EXIT_FAILURE;
+        }
+
+        if (first > last || last >= CPU_SETSIZE)
+            return EXIT_FAILURE;
+
+        for (unsigned long cpu = first; cpu <= last; cpu += 1) {
+            CPU_SET(cpu, cpus);
+        }
+
+        if (*end == ',') {
+            end += 1;
+        } else if (*end != '\0' && *end != '\n') {
+            return EXIT_FAILURE;
+        }
+
+        pos = end;
+
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+void cpu_list_print(const char *msg, cpu_set_t *cpus) {
+
+    const char *sep = "";
+
+    printf("%s", msg);
+
+    for (int32_t cpu = 0; cpu < CPU_SETSIZE; cpu += 1) {
+
+        if (!CPU_ISSET(cpu, cpus))
+            continue;
+
+        int32_t last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, cpus))
+            last += 1;
+
+        if (last > cpu) {
+            printf("%s%" PRId32 "-%" PRId32, sep, cpu, last);
+        } else {
+            printf("%s%" PRId32, sep, cpu);
+        }
+
+        sep = ",";
+        cpu = last;
+
+    }
+
+    printf("\n");
+
+}
+
+
+
+int32_t cpu_list_read(const char *path, cpu_set_t *cpus) {
+
+    char list[4096];
+
+    FILE *list_file = fopen(path, "r");
+    if (list_file == NULL)
+        return EXIT_FAILURE;
+
+    // An empty file (e.g. no isolated CPUs) is an empty set
+    if (fgets(list, sizeof(list), list_file) == NULL)
+        list[0] = '\0';
+
+    fclose(list_file);
+
+    return cpu_list_parse(list, cpus);
+
+}
+
+
+
+int32_t cpu_mask_parse(const char *mask, cpu_set_t *cpus) {
+
+    int32_t cpu = 0;
+
+    CPU_ZERO(cpus);
+
+    // Hex digits from the end of the string, commas separate 32 bit words
+    for (int32_t i = (int32_t)strlen(mask) - 1; i >= 0; i -= 1) {
+
+        char c = mask[i];
+        uint8_t nibble;
+
+        if (c == ',' || c == '\n') {
+            continue;
+        } else if (c >= '0' && c <= '9') {
+            nibble = (uint8_t)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            nibble = (uint8_t)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            nibble = (uint8_t)(c - 'A' + 10);
+        } else {
+            return EXIT_FAILURE;
+        }
+
+        for (uint8_t bit = 0; bit < 4; bit += 1) {
+            if ((nibble & (1 << bit)) && cpu + bit < CPU_SETSIZE)
+                CPU_SET(cpu + bit, cpus);
+        }
+
+        cpu += 4;
+
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+int32_t cpu_node_if(uint8_t *if_name) {
+
+    char path[128];
+    int32_t node = -1;
+
+    // Virtual interfaces have no device link, and single node systems or
+    // firmware that doesn't report locality return -1
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", if_name);
+
+    FILE *node_file = fopen(path, "r");
+    if (node_file == NULL)
+        return -1;
+
+    if (fscanf(node_file, "%" SCNd32, &node) != 1)
+        node = -1;
+
+    fclose(node_file);
+
+    return node;
+
+}
+
+
+
+int32_t cpu_place_init(struct etherate *eth) {
+
+    char      path[128];
+    cpu_set_t allowed;
+    cpu_set_t base;
+    cpu_set_t cpus;
+    cpu_set_t isolated;
+    cpu_set_t irq_cpus;
+    cpu_set_t node_cpus;
+    cpu_set_t nohz;
+    cpu_set_t online;
+    cpu_set_t overlap;
+    cpu_set_t *hk_cpus = &eth->app_opt.hk_cpus;
+
+    // Never place a worker on a CPU this process isn't allowed to use
+    // (e.g. when started under taskset or a cpuset cgroup)
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0) {
+        perror("Can't get the CPU affinity of the process");
+        return EXIT_FAILURE;
+    }
+
+    if (cpu_list_read("/sys/devices/system/cpu/online", &online) != EXIT_SUCCESS)
+        memcpy(&online, &allowed, sizeof(cpu_set_t));
+
+    // CPUs set aside with isolcpus= or nohz_full= are where the workers
+    // belong, isolcpus are removed from the default affinity of every
+    // process so add them back. nohz_full reads "(null)" when it is unused.
+    if (cpu_list_read("/sys/devices/system/cpu/isolated", &isolated) != EXIT_SUCCESS)
+        CPU_ZERO(&isolated);
+    if (cpu_list_read("/sys/devices/system/cpu/nohz_full", &nohz) != EXIT_SUCCESS)
+        CPU_ZERO(&nohz);
+    CPU_OR(&isolated, &isolated, &nohz);
+    CPU_AND(&isolated, &isolated, &online);
+
+    CPU_OR(&base, &allowed, &isolated);
+    CPU_AND(&base, &base, &online);
+
+
+    // Prefer the CPUs on the interfaces' NUMA nodes, with several interfaces
+    // each worker is later placed on the node of its own interface
+    cpu_set_t if_cpus;
+    uint8_t   node_known = 1;
+
+    CPU_ZERO(&node_cpus);
+    eth->app_opt.numa_node = -1;
+
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+
+        struct if_opt *if_opt = &eth->sk_opt.if_opt[if_idx];
+
+        if_opt->numa_node = cpu_node_if(if_opt->if_name);
+
+        if (if_opt->numa_node < 0) {
+            if (eth->app_opt.verbose)
+                printf("NUMA node of %s is unknown.\n", if_opt->if_name);
+            node_known = 0;
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%" PRId32 "/cpulist",
+                 if_opt->numa_node);
+
+        if (cpu_list_read(path, &if_cpus) != EXIT_SUCCESS) {
+            printf("Can't read the CPUs of NUMA node %" PRId32 " from %s\n",
+                   if_opt->numa_node, path);
+            if_opt->numa_node = -1;
+            node_known = 0;
+            continue;
+        }
+
+        CPU_AND(&if_cpus, &if_cpus, &base);
+        // Running on a remote node is still better than not running at all
+        if (CPU_COUNT(&if_cpus) == 0) {
+            printf("No usable CPUs on NUMA node %" PRId32 " of %s, workers may "
+                   "run on any node.\n",
+                   if_opt->numa_node, if_opt->if_name);
+            if_opt->numa_node = -1;
+            node_known = 0;
+            continue;
+        }
+
+        memcpy(&if_opt->node_cpus, &if_cpus, sizeof(cpu_set_t));
+        CPU_OR(&node_cpus, &node_cpus, &if_cpus);
+        printf("Interface %s is on NUMA node %" PRId32 ".\n",
+               if_opt->if_name, if_opt->numa_node);
+
+        if (if_idx == 0)
+            eth->app_opt.numa_node = if_opt->numa_node;
+        else if (eth->app_opt.numa_node != if_opt->numa_node)
+            eth->app_opt.numa_node = -1;
+
+    }
+
+    // If any interface's node is unknown its workers may run anywhere
+    if (node_known) {
+        memcpy(&base, &node_cpus, sizeof(cpu_set_t));
+    } else {
+        eth->app_opt.numa_node = -1;
+    }
+
+
+    // A worker sharing a CPU with the NIC's IRQs loses around half its throughput
+    if (cpu_queue_init(eth) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    CPU_ZERO(&irq_cpus);
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+        CPU_ZERO(&if_cpus);
+        uint16_t irq_nr = cpu_irq_if(eth, if_idx, &if_cpus);
+        if (eth->app_opt.verbose && irq_nr > 0) {
+            printf("%s has %" PRIu16 " IRQs on ", eth->sk_opt.if_opt[if_idx].if_name, irq_nr);
+            cpu_list_print("CPUs ", &if_cpus);
+        }
+        CPU_OR(&irq_cpus, &irq_cpus, &if_cpus);
+    }
+
+
+    // Pin main() to the housekeeping CPUs before any other thread is created
+    if (CPU_COUNT(hk_cpus) > 0) {
+
+        CPU_AND(hk_cpus, hk_cpus, &online);
+        if (CPU_COUNT(hk_cpus) == 0) {
+            printf("Oops! None of the housekeeping CPUs are online.\n");
+            return EXIT_FAILURE;
+        }
+
+        if (sched_setaffinity(0, sizeof(cpu_set_t), hk_cpus) != 0) {
+            perror("Can't pin main() to the housekeeping CPUs");
+            return EXIT_FAILURE;
+        }
+
+        cpu_list_print("Housekeeping CPUs: ", hk_cpus);
+
+    }
+
+
+    // Without -x the workers are only kept off the housekeeping CPUs and on
+    // the interface's NUMA node, the scheduler balances them within that
+    if (!eth->app_opt.thd_affin) {
+
+        CPU_AND(&cpus, &base, &allowed);
+        CPU_AND(&overlap, &cpus, hk_cpus);
+        CPU_XOR(&cpus, &cpus, &overlap);
+        if (CPU_COUNT(&cpus) == 0)
+            CPU_AND(&cpus, &base, &allowed);
+
+        memcpy(&eth->app_opt.thd_cpus, &cpus, sizeof(cpu_set_t));
+
+        return EXIT_SUCCESS;
+
+    }
+
+
+    if (CPU_COUNT(&eth->app_opt.thd_cpus) > 0) {
+
+        // Use the CPUs listed with -x as given, only warn about collisions
+        CPU_AND(&cpus, &eth->app_opt.thd_cpus, &online);
+        if (!CPU_EQUAL(&cpus, &eth->app_opt.thd_cpus))
+            printf("Ignoring offline CPUs in the -x CPU list.\n");
+
+        if (CPU_COUNT(&cpus) == 0) {
+            printf("Oops! None of the CPUs in the -x CPU list are online.\n");
+            return EXIT_FAILURE;
+        }
+
+        CPU_AND(&overlap, &cpus, &irq_cpus);
+        if (CPU_COUNT(&overlap) > 0)
+            cpu_list_print("Warning: worker CPUs also service interface IRQs: ", &overlap);
+
+        CPU_AND(&overlap, &cpus, hk_cpus);
+        if (CPU_COUNT(&overlap) > 0)
+            cpu_list_print("Warning: worker CPUs are also housekeeping CPUs: ", &overlap);
+
+    } else {
+
+        // Otherwise start from the usable CPUs, minus the housekeeping ones
+        memcpy(&cpus, &base, sizeof(cpu_set_t));
+        CPU_AND(&overlap, &cpus, hk_cpus);
+        CPU_XOR(&cpus, &cpus, &overlap);
+        if (CPU_COUNT(&cpus) == 0)
+            memcpy(&cpus, &base, sizeof(cpu_set_t));
+
+        CPU_AND(&overlap, &cpus, &isolated);
+        if (CPU_COUNT(&overlap) > 0) {
+            // Only use the isolated CPUs if there are any
+            memcpy(&cpus, &overlap, sizeof(cpu_set_t));
+        } else if (CPU_COUNT(hk_cpus) == 0 && CPU_COUNT(&cpus) > 1) {
+            // Leave the first CPU for main() and the stats thread
+            for (int32_t cpu = 0; cpu < CPU_SETSIZE; cpu += 1) {
+                if (CPU_ISSET(cpu, &cpus)) {
+                    CPU_CLR(cpu, &cpus);
+                    break;
+                }
+            }
+        }
+
+        // Avoid the IRQ CPUs unless there is nothing else
+        CPU_AND(&overlap, &cpus, &irq_cpus);
+        if (CPU_COUNT(&overlap) < CPU_COUNT(&cpus))
+            CPU_XOR(&cpus, &cpus, &overlap);
+
+    }
+
+    memcpy(&eth->app_opt.thd_cpus, &cpus, sizeof(cpu_set_t));
+
+    if (cpu_smt_order(eth, &cpus) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    if (eth->app_opt.q_map == QMAP_IRQ) {
+        cpu_queue_place(eth);
+    } else if (eth->app_opt.q_map == QMAP_SET) {
+        cpu_queue_set(eth);
+    }
+
+    cpu_list_print("Worker CPUs: ", &eth->app_opt.thd_cpus);
+
+    if (eth->app_opt.thd_cpu_nr < eth->app_opt.thd_nr)
+        printf("Warning: %" PRIu16 " worker threads share %" PRIu16 " CPUs.\n",
+               eth->app_opt.thd_nr, eth->app_opt.thd_cpu_nr);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+int32_t cpu_queue_init(struct etherate *eth) {
+
+    char path[128];
+    struct dirent *entry;
+
+    snprintf(path, sizeof(path), "/sys/class/net/%s/queues", eth->sk_opt.if_opt[0].if_name);
+
+    DIR *q_dir = opendir(path);
+    if (q_dir == NULL) {
+        if (eth->app_opt.q_map != QMAP_OFF)
+            printf("Can't read the queues of %s from %s\n", eth->sk_opt.if_opt[0].if_name, path);
+        return EXIT_SUCCESS;
+    }
+
+    while ((entry = readdir(q_dir)) != NULL) {
+        if (strncmp(entry->d_name, "rx-", 3) == 0)
+            eth->app_opt.q_rx_nr += 1;
+        else if (strncmp(entry->d_name, "tx-", 3) == 0)
+            eth->app_opt.q_tx_nr += 1;
+    }
+
+    closedir(q_dir);
+
+    eth->app_opt.q_rx_irq = calloc(eth->app_opt.q_rx_nr + 1, sizeof(int32_t));
+    eth->app_opt.q_tx_irq = calloc(eth->app_opt.q_tx_nr + 1, sizeof(int32_t));
+    if (eth->app_opt.q_rx_irq == NULL || eth->app_opt.q_tx_irq == NULL) {
+        perror("Can't calloc queue IRQ lists");
+        return EXIT_FAILURE;
+    }
+
+    for (uint16_t q = 0; q < eth->app_opt.q_rx_nr; q += 1)
+        eth->app_opt.q_rx_irq[q] = -1;
+    for (uint16_t q = 0; q < eth->app_opt.q_tx_nr; q += 1)
+        eth->app_opt.q_tx_irq[q] = -1;
+
+    if (eth->app_opt.verbose)
+        printf("%s has %" PRIu16 " Rx and %" PRIu16 " Tx queues.\n",
+               eth->sk_opt.if_opt[0].if_name, eth->app_opt.q_rx_nr, eth->app_opt.q_tx_nr);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+void cpu_queue_place(struct etherate *eth) {
+
+    char      path[128];
+    cpu_set_t q_cpus;
+    uint8_t   rx = (eth->app_opt.sk_mode != SKT_TX);
+    uint16_t  q_nr = rx ? eth->app_opt.q_rx_nr : eth->app_opt.q_tx_nr;
+    int32_t   *q_irq = rx ? eth->app_opt.q_rx_irq : eth->app_opt.q_tx_irq;
+
+    if (q_nr < eth->app_opt.thd_nr)
+        printf("Warning: %s has %" PRIu16 " %s queues for %" PRIu16 " workers, "
+               "the extra workers get no queue.\n",
+               eth->sk_opt.if_opt[0].if_name, q_nr, (rx ? "Rx" : "Tx"), eth->app_opt.thd_nr);
+
+    for (uint16_t q = 0; q < q_nr && q < eth->app_opt.thd_nr; q += 1) {
+
+        CPU_ZERO(&q_cpus);
+
+        // A Tx queue is used by the CPUs in its XPS map, otherwise the CPU
+        // which handles the queue's IRQ is the one to share caches with
+        if (!rx) {
+            snprintf(path, sizeof(path), "/sys/class/net/%s/queues/tx-%" PRIu16 "/xps_cpus",
+                     eth->sk_opt.if_opt[0].if_name, q);
+            FILE *xps_file = fopen(path, "r");
+            if (xps_file != NULL) {
+                char mask[1024];
+                if (fgets(mask, sizeof(mask), xps_file) == NULL ||
+                    cpu_mask_parse(mask, &q_cpus) != EXIT_SUCCESS)
+                    CPU_ZERO(&q_cpus);
+                fclose(xps_file);
+            }
+        }
+
+        if (CPU_COUNT(&q_cpus) == 0 && q_irq[q] >= 0) {
+            snprintf(path, sizeof(path), "/proc/irq/%" PRId32 "/effective_affinity_list", q_irq[q]);
+            if (cpu_list_read(path, &q_cpus) != EXIT_SUCCESS) {
+                snprintf(path, sizeof(path), "/proc/irq/%" PRId32 "/smp_affinity_list", q_irq[q]);
+                if (cpu_list_read(path, &q_cpus) != EXIT_SUCCESS)
+                    CPU_ZERO(&q_cpus);
+            }
+        }
+
+        if (CPU_COUNT(&q_cpus) == 0) {
+            printf("Can't find the CPU for %s queue %" PRIu16 ", worker %" PRIu16 " "
+                   "keeps CPU %" PRId32 "\n",
+                   (rx ? "Rx" : "Tx"), q, q, cpu_worker(eth, q));
+            continue;
+        }
+
+        // The worker list wraps, so it needs an entry per worker from here on
+        if (eth->app_opt.thd_cpu_nr < eth->app_opt.thd_nr) {
+            int32_t *cpu_list = calloc(eth->app_opt.thd_nr, sizeof(int32_t));
+            if (cpu_list == NULL)
+                return;
+            for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1)
+                cpu_list[thread] = cpu_worker(eth, thread);
+            free(eth->app_opt.thd_cpu_list);
+            eth->app_opt.thd_cpu_list = cpu_list;
+            eth->app_opt.thd_cpu_nr = eth->app_opt.thd_nr;
+        }
+
+        for (int32_t cpu = 0; cpu < CPU_SETSIZE; cpu += 1) {
+            if (CPU_ISSET(cpu, &q_cpus)) {
+                eth->app_opt.thd_cpu_list[q] = cpu;
+                CPU_SET(cpu, &eth->app_opt.thd_cpus);
+                break;
+            }
+        }
+
+        if (eth->app_opt.verbose)
+            printf("Worker %" PRIu16 " follows %s queue %" PRIu16 " to CPU %" PRId32 "\n",
+                   q, (rx ? "Rx" : "Tx"), q, eth->app_opt.thd_cpu_list[q]);
+
+    }
+
+}
+
+
+
+void cpu_queue_set(struct etherate *eth) {
+
+    char path[128];
+
+    for (uint16_t q = 0; q < eth->app_opt.thd_nr; q += 1) {
+
+        int32_t cpu = cpu_worker(eth, q);
+        int32_t irqs[2] = { -1, -1 };
+
+        if (q < eth->app_opt.q_rx_nr)
+            irqs[0] = eth->app_opt.q_rx_irq[q];
+        if (q < eth->app_opt.q_tx_nr && eth->app_opt.q_tx_irq[q] != irqs[0])
+            irqs[1] = eth->app_opt.q_tx_irq[q];
+
+        // Deliver queue N's interrupts to worker N's CPU
+        for (uint8_t i = 0; i < 2; i += 1) {
+
+            if (irqs[i] < 0)
+                continue;
+
+            snprintf(path, sizeof(path), "/proc/irq/%" PRId32 "/smp_affinity_list", irqs[i]);
+            FILE *irq_file = fopen(path, "w");
+            if (irq_file == NULL || fprintf(irq_file, "%" PRId32 "\n", cpu) < 0 ||
+                fclose(irq_file) != 0) {
+                printf("Can't move IRQ %" PRId32 " to CPU %" PRId32 " (%s)\n",
+                       irqs[i], cpu, strerror(errno));
+            } else if (eth->app_opt.verbose) {
+                printf("Moved IRQ %" PRId32 " of queue %" PRIu16 " to CPU %" PRId32 "\n",
+                       irqs[i], q, cpu);
+            }
+
+        }
+
+        // Send frames from worker N's CPU on Tx queue N
+        if (q < eth->app_opt.q_tx_nr) {
+
+            snprintf(path, sizeof(path), "/sys/class/net/%s/queues/tx-%" PRIu16 "/xps_cpus",
+                     eth->sk_opt.if_opt[0].if_name, q);
+            FILE *xps_file = fopen(path, "w");
+
+            // A hex mask of 32 bit words, the Kernel fills in leading zero words
+            if (xps_file == NULL || fprintf(xps_file, "%x", 1U << (cpu % 32)) < 0) {
+                printf("Can't set the XPS map of Tx queue %" PRIu16 " (%s)\n", q, strerror(errno));
+                if (xps_file != NULL)
+                    fclose(xps_file);
+                continue;
+            }
+            for (int32_t word = 0; word < cpu / 32; word += 1)
+                fprintf(xps_file, ",00000000");
+            fprintf(xps_file, "\n");
+
+            if (fclose(xps_file) != 0)
+                printf("Can't set the XPS map of Tx queue %" PRIu16 " (%s)\n", q, strerror(errno));
+
+        }
+
+    }
+
+}
+
+
+
+int32_t cpu_smt_order(struct etherate *eth, cpu_set_t *cpus) {
+
+    char      path[96];
+    cpu_set_t siblings;
+    cpu_set_t used_cores;
+    uint16_t  cpu_nr = 0;
+
+    eth->app_opt.thd_cpu_list = calloc(CPU_COUNT(cpus), sizeof(int32_t));
+    if (eth->app_opt.thd_cpu_list == NULL) {
+        perror("Can't calloc worker CPU list");
+        return EXIT_FAILURE;
+    }
+
+    CPU_ZERO(&used_cores);
+
+    // First pass takes one hardware thread per core
+    for (int32_t cpu = 0; cpu < CPU_SETSIZE; cpu += 1) {
+
+        if (!CPU_ISSET(cpu, cpus) || CPU_ISSET(cpu, &used_cores))
+            continue;
+
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%" PRId32 "/topology/thread_siblings_list", cpu);
+
+        if (cpu_list_read(path, &siblings) != EXIT_SUCCESS) {
+            CPU_ZERO(&siblings);
+            CPU_SET(cpu, &siblings);
+        }
+
+        CPU_OR(&used_cores, &used_cores, &siblings);
+        eth->app_opt.thd_cpu_list[cpu_nr] = cpu;
+        cpu_nr += 1;
+
+    }
+
+    // Second pass adds the remaining SMT siblings
+    for (int32_t cpu = 0; cpu < CPU_SETSIZE; cpu += 1) {
+
+        if (!CPU_ISSET(cpu, cpus))
+            continue;
+
+        uint8_t listed = 0;
+        for (uint16_t i = 0; i < cpu_nr; i += 1) {
+            if (eth->app_opt.thd_cpu_list[i] == cpu)
+                listed = 1;
+        }
+
+        if (!listed) {
+            eth->app_opt.thd_cpu_list[cpu_nr] = cpu;
+            cpu_nr += 1;
+        }
+
+    }
+
+    eth->app_opt.thd_cpu_nr = cpu_nr;
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+int32_t cpu_worker(struct etherate *eth, uint16_t thread) {
+
+    struct if_opt *if_opt = &eth->sk_opt.if_opt[thd_if_idx(eth, thread)];
+
+    // With several interfaces each worker uses the worker CPUs on the
+    // NUMA node of its own interface
+    if (eth->sk_opt.if_nr > 1 && if_opt->numa_node >= 0 && eth->app_opt.q_map == QMAP_OFF) {
+
+        uint16_t node_nr = 0;
+        for (uint16_t i = 0; i < eth->app_opt.thd_cpu_nr; i += 1) {
+            if (CPU_ISSET(eth->app_opt.thd_cpu_list[i], &if_opt->node_cpus))
+                node_nr += 1;
+        }
+
+        // The Nth worker on a node takes the node's Nth CPU
+        if (node_nr > 0) {
+            uint16_t n = 0;
+            for (uint16_t prev = 0; prev < thread; prev += 1) {
+                if (eth->sk_opt.if_opt[thd_if_idx(eth, prev)].numa_node == if_opt->numa_node)
+                    n += 1;
+            }
+            n %= node_nr;
+            for (uint16_t i = 0; i < eth->app_opt.thd_cpu_nr; i += 1) {
+                int32_t cpu = eth->app_opt.thd_cpu_list[i];
+                if (CPU_ISSET(cpu, &if_opt->node_cpus) && n-- == 0)
+                    return cpu;
+            }
+        }
+
+    }
+
+    // If there are more workers than CPUs wrap around to the first CPU again
+    return eth->app_opt.thd_cpu_list[thread % eth->app_opt.thd_cpu_nr];
+
+}
\ No newline at end of file
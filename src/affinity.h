@@ -0,0 +1,70 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _AFFINITY_H_
+#define _AFFINITY_H_
+
+// Add the CPUs which service an interface's IRQs to cpus and record the IRQ
+// of each Rx/Tx queue of the first interface, return the number of IRQs found
+static uint16_t cpu_irq_if(struct etherate *eth, uint16_t if_idx, cpu_set_t *cpus);
+
+// Parse a Kernel style CPU list such as "0-3,8,10-11" into a CPU set
+static int32_t cpu_list_parse(const char *list, cpu_set_t *cpus);
+
+// Print a CPU set as a Kernel style CPU list
+static void cpu_list_print(const char *msg, cpu_set_t *cpus);
+
+// Read and parse a CPU list from a sysfs file such as a node cpulist
+static int32_t cpu_list_read(const char *path, cpu_set_t *cpus);
+
+// Parse a hex CPU mask such as "00000000,00000f00" into a CPU set
+static int32_t cpu_mask_parse(const char *mask, cpu_set_t *cpus);
+
+// Return the NUMA node an interface's device is attached to, or -1 if unknown
+static int32_t cpu_node_if(uint8_t *if_name);
+
+// Choose the CPUs for the worker threads and pin main() to the housekeeping
+// CPUs, the stats and metrics threads inherit this when they are created
+static int32_t cpu_place_init(struct etherate *eth);
+
+// Count the interface's Rx/Tx queues and allocate their IRQ lists
+static int32_t cpu_queue_init(struct etherate *eth);
+
+// Move worker N to the CPU which handles queue N (its XPS map for Tx, its IRQ for Rx)
+static void cpu_queue_place(struct etherate *eth);
+
+// Move the IRQs and XPS map of queue N to worker N's CPU
+static void cpu_queue_set(struct etherate *eth);
+
+// Order the worker CPUs so that each physical core is used once before
+// any SMT sibling is used
+static int32_t cpu_smt_order(struct etherate *eth, cpu_set_t *cpus);
+
+// Return the CPU a worker thread is pinned to with -x
+static int32_t cpu_worker(struct etherate *eth, uint16_t thread);
+
+#endif // _AFFINITY_H_
\ No newline at end of file
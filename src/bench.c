@@ -0,0 +1,268 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+static uint32_t bench_mtu(struct etherate *eth) {
+
+    uint32_t mtu = 0;
+
+    int32_t sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (sock == -1)
+        return 0;
+
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+
+        struct ifreq ifr;
+        memset(&ifr, 0, sizeof(ifr));
+        strncpy(ifr.ifr_name, (char*)eth->sk_opt.if_opt[if_idx].if_name, IF_NAMESIZE - 1);
+
+        if (ioctl(sock, SIOCGIFMTU, &ifr) == -1)
+            continue;
+
+        if (mtu == 0 || (uint32_t)ifr.ifr_mtu < mtu)
+            mtu = ifr.ifr_mtu;
+
+    }
+
+    close(sock);
+
+    return mtu;
+
+}
+
+
+
+static void bench_print(struct bench_cell *cell) {
+
+    printf("-p%" PRIu8 " %-22s %5" PRIu16 " %7" PRIu16 " ",
+           cell->sk_type, probe_name(cell->sk_type), cell->frame_sz, cell->thd_nr);
+
+    if (!cell->ok) {
+        printf("%10s\n", "failed");
+        return;
+    }
+
+    double fps = (double)cell->res.frms * 1000000000 / cell->res.ns;
+    double bps = (double)cell->res.bytes * 8 * 1000000000 / cell->res.ns;
+
+    printf("%10.3f %9.2f ", fps / 1000000, bps / 1000000000);
+
+    if (cell->res.cycles && cell->res.all_frms)
+        printf("%12.0f ", (double)cell->res.cycles / cell->res.all_frms);
+    else
+        printf("%12s ", "n/a");
+
+    if (cell->res.all_frms)
+        printf("%12.0f\n", (double)cell->res.cpu_ns / cell->res.all_frms);
+    else
+        printf("%12s\n", "n/a");
+
+}
+
+
+
+static int32_t bench_run(struct etherate *eth) {
+
+    // The RFC 2544 sizes 64 to 1518 without the FCS, as -f and --rfc2544
+    // send them, and a jumbo frame
+    const uint16_t frm_szs[] = {60, 124, 252, 508, 1020, 1276, 1514, 9000};
+    const uint8_t  engines[] = {
+        SKT_PACKET, SKT_PACKET_MMAP2, SKT_SENDMSG, SKT_SENDMMSG, SKT_PACKET_MMAP3
+    };
+    const uint32_t frm_sz_nr = sizeof(frm_szs) / sizeof(frm_szs[0]);
+    uint16_t       frame_sz = eth->frm_opt.frame_sz;
+    uint32_t       run_ms = (eth->app_opt.dur_lim ? eth->app_opt.dur_lim * 1000 : BENCH_RUN_MS);
+
+    // Random frame data up to the largest size
+    if (getrandom(eth->frm_opt.tx_buffer, DEF_FRM_SZ_MAX, 0) != DEF_FRM_SZ_MAX) {
+        perror("Can't generate random frame data");
+        return EXIT_FAILURE;
+    }
+
+    uint32_t mtu = bench_mtu(eth);
+    if (mtu != 0 && mtu + ETH_HLEN < frm_szs[frm_sz_nr - 1])
+        printf("Skipping frame sizes over %" PRIu32 " bytes, the interface MTU is %"
+               PRIu32 ".\n", mtu + ETH_HLEN, mtu);
+
+    struct bench_cell *cells = calloc(sizeof(engines) * frm_sz_nr * eth->app_opt.thd_nr,
+                                      sizeof(struct bench_cell));
+    uint32_t cell_nr = 0;
+
+    if (cells == NULL) {
+        perror("Can't allocate benchmark results");
+        return EXIT_FAILURE;
+    }
+
+    printf("Benchmarking for %.1f seconds per cell, %.1f seconds warm-up, frame sizes\n"
+           "are without the 4 byte FCS:\n", run_ms / 1000.0, BENCH_WARM_MS / 1000.0);
+    printf("%-26s %5s %7s %10s %9s %12s %12s\n",
+           "Engine", "Frame", "Threads", "Mpps", "Gbps", "Cycles/frm", "CPU ns/frm");
+
+    for (uint32_t engine = 0; engine < sizeof(engines); engine += 1) {
+
+        if (!probe_feature(eth, engines[engine])) {
+            printf("-p%" PRIu8 " %-22s not supported\n",
+                   engines[engine], probe_name(engines[engine]));
+            continue;
+        }
+
+        for (uint32_t frm_sz = 0; frm_sz < frm_sz_nr; frm_sz += 1) {
+
+            if (mtu != 0 && frm_szs[frm_sz] > mtu + ETH_HLEN)
+                continue;
+
+            for (uint16_t thd_nr = 1; thd_nr <= eth->app_opt.thd_nr; thd_nr += 1) {
+
+                struct bench_cell *cell = &cells[cell_nr];
+
+                cell->sk_type  = engines[engine];
+                cell->frame_sz = frm_szs[frm_sz];
+                cell->thd_nr   = thd_nr;
+
+                eth->frm_opt.frame_sz = cell->frame_sz;
+                cell->ok = (probe_trial(eth, cell->sk_type, thd_nr, BENCH_WARM_MS,
+                                        run_ms, &cell->res) == EXIT_SUCCESS);
+
+                // Keep what finished when interrupted
+                if (eth->app_opt.stop)
+                    break;
+
+                cell_nr += 1;
+                bench_print(cell);
+
+            }
+
+            if (eth->app_opt.stop)
+                break;
+
+        }
+
+        if (eth->app_opt.stop)
+            break;
+
+    }
+
+    eth->frm_opt.frame_sz = frame_sz;
+
+    int32_t ret = bench_write(eth, cells, cell_nr, run_ms);
+    free(cells);
+
+    return ret;
+
+}
+
+
+
+static int32_t bench_setup(struct etherate *eth) {
+
+    if (eth->app_opt.sk_mode != SKT_TX || eth->app_opt.mesh || eth->app_opt.xdp ||
+        eth->app_opt.memif_path != NULL) {
+        printf("Oops! --bench only runs in Tx mode, without --mesh, --memif or --xdp.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.sk_type != DEF_SKT_TYPE) {
+        printf("Oops! --bench runs every -p method, don't use -p.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->frm_opt.custom_frame) {
+        printf("Oops! --bench sets the frame sizes, it can't be used with -C.\n");
+        return EX_SOFTWARE;
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static int32_t bench_write(struct etherate *eth, struct bench_cell *cells,
+                           uint32_t cell_nr, uint32_t run_ms) {
+
+    FILE *out = fopen(eth->app_opt.bench_path, "w");
+
+    if (out == NULL) {
+        perror("Can't open benchmark results file");
+        return EXIT_FAILURE;
+    }
+
+    struct utsname uts;
+    if (uname(&uts) == -1)
+        strncpy(uts.release, "unknown", sizeof(uts.release));
+
+    fprintf(out, "{\"kernel\":\"%s\",\"interfaces\":[", uts.release);
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1)
+        fprintf(out, "%s\"%s\"", (if_idx ? "," : ""), eth->sk_opt.if_opt[if_idx].if_name);
+    fprintf(out, "],\"warm_ms\":%" PRIu32 ",\"run_ms\":%" PRIu32 ",\"results\":[",
+            (uint32_t)BENCH_WARM_MS, run_ms);
+
+    for (uint32_t idx = 0; idx < cell_nr; idx += 1) {
+
+        struct bench_cell *cell = &cells[idx];
+
+        // frame_sz_fcs is the size --rfc2544 reports
+        fprintf(out, "%s\n{\"engine\":\"p%" PRIu8 "\",\"name\":\"%s\",\"frame_sz\":%" PRIu16
+                ",\"frame_sz_fcs\":%" PRIu32 ",\"threads\":%" PRIu16 ",\"ok\":%s",
+                (idx ? "," : ""), cell->sk_type, probe_name(cell->sk_type),
+                cell->frame_sz, (uint32_t)cell->frame_sz + ETH_FCS_LEN, cell->thd_nr,
+                (cell->ok ? "true" : "false"));
+
+        if (cell->ok) {
+            fprintf(out, ",\"fps\":%.0f,\"mpps\":%.3f,\"gbps\":%.3f",
+                    (double)cell->res.frms * 1000000000 / cell->res.ns,
+                    (double)cell->res.frms * 1000 / cell->res.ns,
+                    (double)cell->res.bytes * 8 / cell->res.ns);
+        }
+
+        if (cell->ok && cell->res.cycles && cell->res.all_frms)
+            fprintf(out, ",\"cycles_per_frame\":%.1f",
+                    (double)cell->res.cycles / cell->res.all_frms);
+        else
+            fprintf(out, ",\"cycles_per_frame\":null");
+
+        if (cell->ok && cell->res.all_frms)
+            fprintf(out, ",\"cpu_ns_per_frame\":%.1f}",
+                    (double)cell->res.cpu_ns / cell->res.all_frms);
+        else
+            fprintf(out, ",\"cpu_ns_per_frame\":null}");
+
+    }
+
+    fprintf(out, "\n]}\n");
+
+    if (fclose(out) != 0) {
+        perror("Can't write benchmark results file");
+        return EXIT_FAILURE;
+    }
+
+    printf("Wrote %" PRIu32 " results to %s\n", cell_nr, eth->app_opt.bench_path);
+
+    return EXIT_SUCCESS;
+
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+/*
+ * Engine benchmark (--bench <file>). Each Tx engine the running Kernel
+ * supports is run with each frame size and with 1 to -c worker threads,
+ * every cell for a warm-up and then a measured period, using the same
+ * trials as -p auto. A table is printed as the cells finish and the
+ * results are written to <file> as JSON. Cycles per frame need a CPU
+ * cycle counter, which VMs often don't expose, CPU time per frame is
+ * always reported.
+ */
+
+#define BENCH_RUN_MS  3000     // Measured part of each cell, -d overrides it
+#define BENCH_WARM_MS 1000     // Start of each cell which isn't measured
+
+struct bench_cell {
+    uint8_t  sk_type;
+    uint16_t frame_sz;         // Without the FCS, as -f
+    uint16_t thd_nr;
+    uint8_t  ok;               // The trial ran, all workers sent until the end
+    struct   probe_res res;
+};
+
+// Return the smallest MTU of the interfaces, 0 if unknown
+static uint32_t bench_mtu(struct etherate *eth);
+
+// Print the table row of one cell
+static void bench_print(struct bench_cell *cell);
+
+// Run every engine, frame size and thread count and write the results
+static int32_t bench_run(struct etherate *eth);
+
+// Check the options can be used for the benchmark
+static int32_t bench_setup(struct etherate *eth);
+
+// Write the results as JSON
+static int32_t bench_write(struct etherate *eth, struct bench_cell *cells,
+                           uint32_t cell_nr, uint32_t run_ms);
+
+#endif // _BENCH_H_
\ No newline at end of file
@@ -0,0 +1,369 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "dpdk.h"
+
+
+
+void dpdk_cleanup(struct etherate *eth) {
+
+    if (!eth->app_opt.dpdk_eal)
+        return;
+
+    uint16_t port;
+    RTE_ETH_FOREACH_DEV(port) {
+        if (rte_eth_dev_stop(port) != 0 && eth->app_opt.verbose)
+            printf("Can't stop DPDK port %" PRIu16 ".\n", port);
+        rte_eth_dev_close(port);
+    }
+
+    // The queues hold mbufs from the pools until the ports are closed
+    if (eth->app_opt.dpdk_qs != NULL) {
+        for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1)
+            rte_mempool_free(eth->app_opt.dpdk_qs[thread].pool);
+        free(eth->app_opt.dpdk_qs);
+        eth->app_opt.dpdk_qs = NULL;
+    }
+
+    rte_eal_cleanup();
+    eth->app_opt.dpdk_eal = 0;
+
+}
+
+
+
+int32_t dpdk_eal_init(struct etherate *eth) {
+
+    if (eth->sk_opt.if_nr != 0) {
+        printf("Oops! -p6 uses the ports found by the DPDK EAL, not -i/-I.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.mesh || eth->app_opt.xdp || eth->app_opt.q_map != QMAP_OFF ||
+        eth->app_opt.sk_mode == SKT_REFLECT) {
+        printf("Oops! -p6 can't be used with --mesh, --xdp, -Q or -R.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (rte_eal_init(eth->app_opt.eal_argc, eth->app_opt.eal_argv) < 0) {
+        printf("Oops! Can't start the DPDK EAL: %s.\n", rte_strerror(rte_errno));
+        return EXIT_FAILURE;
+    }
+
+    eth->app_opt.dpdk_eal = 1;
+
+    uint16_t port;
+    RTE_ETH_FOREACH_DEV(port) {
+
+        char    name[RTE_ETH_NAME_MAX_LEN];
+        uint8_t if_name[IF_NAMESIZE] = {0};
+
+        if (rte_eth_dev_get_name_by_port(port, name) != 0)
+            snprintf(name, sizeof(name), "port%" PRIu16, port);
+        strncpy((char*)if_name, name, IF_NAMESIZE - 1);
+
+        if (add_if(eth, port, if_name) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+
+    }
+
+    if (eth->sk_opt.if_nr == 0) {
+        printf("Oops! The DPDK EAL found no ports, add -a <PCI> or --vdev after --.\n");
+        return EX_SOFTWARE;
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+void *dpdk_init(void* thd_opt_p) {
+
+    struct thd_opt *thd_opt = thd_opt_p;
+
+
+    // Save the thread tid
+    pid_t thread_id;
+    thread_id = syscall(SYS_gettid);
+    thd_opt->thd_id = thread_id;
+
+
+    // Set the thread cancel type and register the cleanup handler
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    pthread_cleanup_push(thd_cleanup, thd_opt_p);
+
+    
+    if (thd_opt->verbose) {
+        if (thd_opt->affinity >= 0) {
+            printf(
+                "Worker thread %" PRIu32 " started, bound to CPU %" PRId32 "\n",
+                thd_opt->thd_id, thd_opt->affinity
+            );
+        } else {
+            printf("Worker thread %" PRIu32 " started\n", thd_opt->thd_id);
+        }
+    }
+
+
+    if (thd_alloc_bufs(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+
+    // Without an lcore ID every mempool get and put goes to the shared ring
+    if (rte_thread_register() != 0) {
+        printf("%" PRIu32 ":Can't register worker as a DPDK lcore (%s)\n",
+               thd_opt->thd_id, rte_strerror(rte_errno));
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+    if (thd_opt->verbose)
+        printf("%" PRIu32 ":DPDK port %" PRId32 " queue %" PRIu16 ", lcore %" PRIu32 "\n",
+               thd_opt->thd_id, thd_opt->if_index, thd_opt->dpdk_q->queue, rte_lcore_id());
+
+
+    if (thd_opt->sk_mode == SKT_TX) {
+        dpdk_tx(thd_opt);
+    } else if (thd_opt->sk_mode == SKT_RX) {
+        dpdk_rx(thd_opt);
+    }
+
+    rte_thread_unregister();
+
+
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
+    pthread_cleanup_pop(0);
+    return NULL;
+
+}
+
+
+
+int32_t dpdk_port_init(struct etherate *eth) {
+
+    // In bidi mode a Tx only and an Rx only worker share each queue number,
+    // so that net_ring loops Tx queue N back to the Rx worker of pair N
+    uint16_t q_nr[DEF_IF_MAX][2] = {{0}};
+
+    eth->app_opt.dpdk_qs = calloc(eth->app_opt.thd_nr, sizeof(struct dpdk_q));
+    if (eth->app_opt.dpdk_qs == NULL) {
+        perror("Can't calloc DPDK queue list");
+        return EXIT_FAILURE;
+    }
+
+    // Each worker gets the next queue on its port and a mempool on the
+    // port's NUMA node, large enough for one frame per mbuf
+    uint16_t data_sz = RTE_PKTMBUF_HEADROOM +
+                       RTE_MAX(eth->frm_opt.frame_sz, RTE_MBUF_DEFAULT_DATAROOM);
+
+    for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+
+        uint16_t if_idx = thd_if_idx(eth, thread);
+        uint16_t port   = eth->sk_opt.if_opt[if_idx].if_index;
+        uint8_t  rx_only = (eth->app_opt.tx_nr && thread >= eth->app_opt.tx_nr);
+        char     name[RTE_MEMPOOL_NAMESIZE];
+
+        snprintf(name, sizeof(name), "etherate_%" PRIu16, thread);
+
+        eth->app_opt.dpdk_qs[thread].queue = q_nr[if_idx][rx_only];
+        q_nr[if_idx][rx_only] += 1;
+
+        eth->app_opt.dpdk_qs[thread].pool = rte_pktmbuf_pool_create(
+            name, DPDK_POOL_SZ, DPDK_POOL_CACHE, 0, data_sz, rte_eth_dev_socket_id(port)
+        );
+
+        if (eth->app_opt.dpdk_qs[thread].pool == NULL) {
+            printf("Oops! Can't create DPDK mempool %s: %s.\n", name, rte_strerror(rte_errno));
+            return EXIT_FAILURE;
+        }
+
+    }
+
+
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+
+        uint16_t port = eth->sk_opt.if_opt[if_idx].if_index;
+        uint16_t q_max = RTE_MAX(q_nr[if_idx][0], q_nr[if_idx][1]);
+        struct   rte_eth_conf conf;
+        struct   rte_eth_dev_info dev_info;
+
+        memset(&conf, 0, sizeof(conf));
+
+        if (rte_eth_dev_info_get(port, &dev_info) != 0) {
+            printf("Oops! Can't get DPDK port %" PRIu16 " info.\n", port);
+            return EXIT_FAILURE;
+        }
+
+        if (q_max > dev_info.max_rx_queues || q_max > dev_info.max_tx_queues) {
+            printf("Oops! DPDK port %" PRIu16 " has %" PRIu16 " Rx and %" PRIu16 " Tx queues, "
+                   "%" PRIu16 " are needed.\n",
+                   port, dev_info.max_rx_queues, dev_info.max_tx_queues, q_max);
+            return EX_SOFTWARE;
+        }
+
+        // Every mbuf sent from a queue comes from one pool with a refcnt of 1
+        if (dev_info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE)
+            conf.txmode.offloads |= RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE;
+
+        if (eth->frm_opt.frame_sz > RTE_ETHER_MAX_LEN - RTE_ETHER_CRC_LEN)
+            conf.rxmode.mtu = eth->frm_opt.frame_sz - RTE_ETHER_HDR_LEN;
+
+        if (rte_eth_dev_configure(port, q_max, q_max, &conf) != 0) {
+            printf("Oops! Can't configure DPDK port %" PRIu16 ".\n", port);
+            return EXIT_FAILURE;
+        }
+
+    }
+
+
+    for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+
+        struct   dpdk_q *dpdk_q = &eth->app_opt.dpdk_qs[thread];
+        uint16_t port   = eth->sk_opt.if_opt[thd_if_idx(eth, thread)].if_index;
+        uint16_t rx_sz  = DPDK_RING_SZ;
+        uint16_t tx_sz  = DPDK_RING_SZ;
+        int32_t  socket = rte_eth_dev_socket_id(port);
+
+        rte_eth_dev_adjust_nb_rx_tx_desc(port, &rx_sz, &tx_sz);
+
+        // Bidi Tx only workers set up just the Tx queue, Rx only just the Rx
+        uint8_t rx = !(eth->app_opt.tx_nr && thread < eth->app_opt.tx_nr);
+        uint8_t tx = !(eth->app_opt.tx_nr && thread >= eth->app_opt.tx_nr);
+
+        if ((rx && rte_eth_rx_queue_setup(port, dpdk_q->queue, rx_sz, socket, NULL, dpdk_q->pool) != 0) ||
+            (tx && rte_eth_tx_queue_setup(port, dpdk_q->queue, tx_sz, socket, NULL) != 0)) {
+            printf("Oops! Can't set up DPDK port %" PRIu16 " queue %" PRIu16 ".\n",
+                   port, dpdk_q->queue);
+            return EXIT_FAILURE;
+        }
+
+    }
+
+
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+
+        uint16_t port = eth->sk_opt.if_opt[if_idx].if_index;
+
+        if (rte_eth_dev_start(port) != 0) {
+            printf("Oops! Can't start DPDK port %" PRIu16 ".\n", port);
+            return EXIT_FAILURE;
+        }
+
+        // Not every PMD has a MAC filter to turn off (e.g. net_null)
+        if (rte_eth_promiscuous_enable(port) != 0 && eth->app_opt.verbose)
+            printf("Can't enable promiscuous mode on DPDK port %" PRIu16 ".\n", port);
+
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+void dpdk_rx(struct thd_opt *thd_opt) {
+
+    struct   rte_mbuf *mbufs[DPDK_BURST];
+    uint16_t port  = thd_opt->if_index;
+    uint16_t queue = thd_opt->dpdk_q->queue;
+
+    thd_opt->started = 1;
+
+    while(!thd_stopping(thd_opt)) {
+
+        uint16_t rx_nr = rte_eth_rx_burst(port, queue, mbufs, DPDK_BURST);
+
+        if (rx_nr == 0)
+            continue;
+
+        uint64_t bytes = 0;
+        for (uint16_t i = 0; i < rx_nr; i += 1) {
+            bytes += rte_pktmbuf_pkt_len(mbufs[i]);
+            if (thd_opt->rfc2544_rx)
+                rfc2544_rx(thd_opt, rte_pktmbuf_mtod(mbufs[i], uint8_t *),
+                           rte_pktmbuf_data_len(mbufs[i]));
+        }
+
+        rte_pktmbuf_free_bulk(mbufs, rx_nr);
+
+        thd_opt->rx_bytes += bytes;
+        thd_opt->rx_frms  += rx_nr;
+
+    }
+
+}
+
+
+
+void dpdk_tx(struct thd_opt *thd_opt) {
+
+    struct   rte_mbuf *mbufs[DPDK_BURST];
+    struct   rte_mempool *pool = thd_opt->dpdk_q->pool;
+    uint16_t port  = thd_opt->if_index;
+    uint16_t queue = thd_opt->dpdk_q->queue;
+
+    thd_opt->started = 1;
+
+    while(!thd_stopping(thd_opt)) {
+
+        uint16_t burst = DPDK_BURST;
+        if (thd_opt->frm_lim && thd_opt->frm_lim - thd_opt->tx_frms < burst)
+            burst = thd_opt->frm_lim - thd_opt->tx_frms;
+
+        // Only send the frames due under -t
+        burst = pace_tx(thd_opt, burst);
+        if (burst == 0)
+            continue;
+
+        // The pool runs dry while the NIC still holds the last bursts
+        if (rte_pktmbuf_alloc_bulk(pool, mbufs, burst) != 0)
+            continue;
+
+        for (uint16_t i = 0; i < burst; i += 1) {
+            rte_memcpy(rte_pktmbuf_mtod(mbufs[i], void*), thd_opt->tx_buffer, thd_opt->frame_sz);
+            mbufs[i]->data_len = thd_opt->frame_sz;
+            mbufs[i]->pkt_len  = thd_opt->frame_sz;
+        }
+
+        uint16_t tx_nr = rte_eth_tx_burst(port, queue, mbufs, burst);
+
+        // The Tx ring is full, the unsent mbufs go back to the pool
+        if (tx_nr < burst)
+            rte_pktmbuf_free_bulk(&mbufs[tx_nr], burst - tx_nr);
+
+        thd_opt->tx_bytes += (uint64_t)tx_nr * thd_opt->frame_sz;
+        thd_opt->tx_frms  += tx_nr;
+
+        if (thd_opt->frm_lim && thd_opt->tx_frms >= thd_opt->frm_lim)
+            break;
+
+    }
+
+}
\ No newline at end of file
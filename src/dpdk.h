@@ -0,0 +1,68 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DPDK_H_
+#define _DPDK_H_
+
+/*
+ * DPDK engine (-p6), only built with -DETHERATE_DPDK, see INSTALL. The EAL
+ * takes the args after "--" and every port it probes is used in place of
+ * -i/-I. Each worker stays a pthread but registers as an lcore so that it
+ * gets a mempool cache, and owns one mempool and one queue number on its
+ * port.
+ */
+
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+
+#define DPDK_BURST      32      // mbufs per rx_burst()/tx_burst()
+#define DPDK_POOL_CACHE 256     // Per-lcore mempool cache size
+#define DPDK_POOL_SZ    8191    // mbufs per worker mempool
+#define DPDK_RING_SZ    1024    // Rx and Tx descriptors per queue
+
+// Stop and close the ports, free the mempools and release the EAL
+void dpdk_cleanup(struct etherate *eth);
+
+// Start the EAL with the args after "--" and use its ports as the interfaces
+int32_t dpdk_eal_init(struct etherate *eth);
+
+// Worker thread entry function
+void *dpdk_init(void* thd_opt_p);
+
+// Create a mempool and queues per worker, then start the ports
+int32_t dpdk_port_init(struct etherate *eth);
+
+// Poll the worker's Rx queue
+void dpdk_rx(struct thd_opt *thd_opt);
+
+// Send bursts of mbufs copied from the test frame
+void dpdk_tx(struct thd_opt *thd_opt);
+
+#endif // _DPDK_H_
\ No newline at end of file
@@ -29,6 +29,43 @@
 
 
 
+int16_t add_if(struct etherate *eth, int32_t if_index, uint8_t *if_name) {
+
+    if (eth->sk_opt.if_nr == DEF_IF_MAX) {
+        printf("Oops! No more than %" PRId32 " interfaces can be used.\n", DEF_IF_MAX);
+        return EXIT_FAILURE;
+    }
+
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+        if (eth->sk_opt.if_opt[if_idx].if_index == if_index) {
+            printf("Oops! Interface %s is used more than once.\n", if_name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct if_opt *if_opt = &eth->sk_opt.if_opt[eth->sk_opt.if_nr];
+
+    // Each interface needs its own fanout group, the Kernel only allows
+    // sockets bound to the same device in a group
+    if_opt->fanout_grp  = (getpid() + eth->sk_opt.if_nr) & 0xffff;
+    if_opt->fanout_turn = 0;
+    if_opt->if_index    = if_index;
+    strncpy((char*)if_opt->if_name, (char*)if_name, IF_NAMESIZE);
+    CPU_ZERO(&if_opt->node_cpus);
+    if_opt->numa_node   = -1;
+    if_opt->promisc     = 0;
+    if_opt->thd_nr      = 0;
+
+    eth->sk_opt.if_nr += 1;
+
+    printf("Using inteface %s (%" PRId32 ").\n", if_opt->if_name, if_opt->if_index);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
 uint8_t cli_args(int argc, char *argv[], struct etherate *eth) {
 
     if (argc > 1) {
@@ -74,6 +111,34 @@ uint8_t cli_args(int argc, char *argv[], struct etherate *eth) {
                     return EXIT_FAILURE;
                 }
 
+
+
+            // Benchmark every engine, frame size and thread count
+            } else if (strncmp(argv[i], "--bench", 7) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->app_opt.bench_path = argv[i+1];
+                    i += 1;
+                } else {
+                    printf("Oops! Missing benchmark results filename.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Send bursts of frames separated by idle gaps
+            } else if (strncmp(argv[i], "--burst", 7) == 0) {
+
+                if (argc > (i+1) &&
+                    pace_burst_parse(argv[i+1], eth) == EXIT_SUCCESS) {
+                    i += 1;
+                } else {
+                    printf("Oops! Invalid or missing burst, expected "
+                           "<frames>,<gap us> or <frames>,<duty cycle>%%.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
             
             // Set number of worker threads
             } else if (strncmp(argv[i], "-c", 2) == 0) {
@@ -141,6 +206,19 @@ uint8_t cli_args(int argc, char *argv[], struct etherate *eth) {
                 }
 
 
+            // Stop after a number of seconds
+            } else if (strncmp(argv[i], "-d", 2) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->app_opt.dur_lim = strtoull(argv[i+1], NULL, 0);
+                    i += 1;
+                } else {
+                    printf("Oops! Missing duration.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
             // Specifying frame payload size in bytes
             } else if (strncmp(argv[i], "-f", 2) == 0) {
 
@@ -171,6 +249,18 @@ uint8_t cli_args(int argc, char *argv[], struct etherate *eth) {
                 }
 
 
+            // Choose the fanout mode and flags for multi-threaded Rx
+            } else if (strncmp(argv[i], "-F", 2) == 0) {
+
+                if (argc > (i+1) && fanout_parse(argv[i+1], eth) == EXIT_SUCCESS) {
+                    i += 1;
+                } else {
+                    printf("Oops! Missing or invalid fanout mode.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
             // Display usage information
             } else if (strncmp(argv[i], "-h", 2) == 0 ||
                        strncmp(argv[i], "--help", 6) == 0) {
@@ -179,20 +269,36 @@ uint8_t cli_args(int argc, char *argv[], struct etherate *eth) {
                 exit(EX_SOFTWARE);
 
 
-            // Set interface by name
+            // Keep a bounded multi-resolution rate history in a file
+            } else if (strncmp(argv[i], "-H", 2) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->stat_opt.hist_path = argv[i+1];
+                    i += 1;
+                } else {
+                    printf("Oops! Missing history filename.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Set interface by name, repeat to use several interfaces
             } else if (strncmp(argv[i], "-i", 2) == 0) {
 
                 if (argc > (i+1)) {
 
-                    strncpy((char*)eth->sk_opt.if_name, argv[i+1], IF_NAMESIZE);
-                    eth->sk_opt.if_index = get_if_index_by_name(eth->sk_opt.if_name);
+                    uint8_t if_name[IF_NAMESIZE] = {0};
+                    strncpy((char*)if_name, argv[i+1], IF_NAMESIZE - 1);
+                    int32_t if_index = get_if_index_by_name(if_name);
                     
-                    if (eth->sk_opt.if_index == -1) {
+                    if (if_index == -1) {
                         printf("Opps! Can't find interface with name: %s.\n", argv[i+1]);
                         return EXIT_FAILURE;
                     }
-                    
-                    printf("Using inteface %s (%" PRId32 ").\n", eth->sk_opt.if_name, eth->sk_opt.if_index);
+
+                    if (add_if(eth, if_index, if_name) != EXIT_SUCCESS)
+                        return EXIT_FAILURE;
+
                     i += 1;
 
                 } else {
@@ -202,20 +308,23 @@ uint8_t cli_args(int argc, char *argv[], struct etherate *eth) {
                 }
 
 
-            // Set interface by index number
+            // Set interface by index number, repeat to use several interfaces
             } else if (strncmp(argv[i], "-I", 2) == 0) {
 
                 if (argc > (i+1)) {
 
-                    eth->sk_opt.if_index = (uint32_t)strtoul(argv[i+1], NULL, 0);
-                    get_if_name_by_index(eth->sk_opt.if_index, eth->sk_opt.if_name);
+                    uint8_t if_name[IF_NAMESIZE] = {0};
+                    int32_t if_index = (int32_t)strtoul(argv[i+1], NULL, 0);
+                    get_if_name_by_index(if_index, if_name);
 
-                    if (eth->sk_opt.if_name[0] == 0) {
+                    if (if_name[0] == 0) {
                         printf("Opps! Can't find interface with index: %" PRIu32 ".\n", (uint32_t)strtoul(argv[i+1], NULL, 0));
                         return(EXIT_FAILURE);
                     }
-                    
-                    printf("Using inteface %s (%" PRId32 ").\n", eth->sk_opt.if_name, eth->sk_opt.if_index);
+
+                    if (add_if(eth, if_index, if_name) != EXIT_SUCCESS)
+                        return EXIT_FAILURE;
+
                     i += 1;
 
                 } else {
@@ -244,6 +353,134 @@ uint8_t cli_args(int argc, char *argv[], struct etherate *eth) {
                 }
 
 
+            // Serve OpenMetrics on a local TCP port or Unix socket
+            } else if (strncmp(argv[i], "-M", 2) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->stat_opt.metrics_addr = argv[i+1];
+                    i += 1;
+                } else {
+                    printf("Oops! Missing metrics port or socket path.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Measure probe latency while stepping a background load
+            } else if (strncmp(argv[i], "--latency", 9) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->app_opt.lat_rate = strtoull(argv[i+1], NULL, 0);
+                    i += 1;
+                } else {
+                    printf("Oops! Missing probe rate.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Exchange frames with another EtherateMT through shared memory
+            } else if (strncmp(argv[i], "--memif", 7) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->app_opt.memif_path = argv[i+1];
+                    i += 1;
+                } else {
+                    printf("Oops! Missing memif socket path.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Send from every interface to every other interface
+            } else if (strncmp(argv[i], "--mesh", 6) == 0) {
+                eth->app_opt.mesh = 1;
+
+
+            // Stop after a number of frames
+            } else if (strncmp(argv[i], "-n", 2) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->app_opt.frm_lim = strtoull(argv[i+1], NULL, 0);
+                    i += 1;
+                } else {
+                    printf("Oops! Missing frame count.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Stop after a number of bytes
+            } else if (strncmp(argv[i], "-N", 2) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->app_opt.byte_lim = strtoull(argv[i+1], NULL, 0);
+                    i += 1;
+                } else {
+                    printf("Oops! Missing byte count.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Set the stats output format
+            } else if (strncmp(argv[i], "-o", 2) == 0) {
+
+                if (argc > (i+1)) {
+
+                    if (strncmp(argv[i+1], "text", 4) == 0) {
+                        eth->stat_opt.fmt = STATS_FMT_TEXT;
+                    } else if (strncmp(argv[i+1], "json", 4) == 0) {
+                        eth->stat_opt.fmt = STATS_FMT_JSON;
+                    } else if (strncmp(argv[i+1], "csv", 3) == 0) {
+                        eth->stat_opt.fmt = STATS_FMT_CSV;
+                    } else {
+                        printf("Oops! Unknown stats format: %s.\n"
+                               "Usage info: %s -h\n", argv[i+1], argv[0]);
+                        return EXIT_FAILURE;
+                    }
+
+                    i += 1;
+
+                } else {
+                    printf("Oops! Missing stats format.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Write the stats records to a file instead of stdout
+            } else if (strncmp(argv[i], "-O", 2) == 0) {
+
+                if (argc > (i+1)) {
+
+                    if (eth->stat_opt.out != stdout)
+                        fclose(eth->stat_opt.out);
+
+                    eth->stat_opt.out = fopen(argv[i+1], "w");
+                    if (eth->stat_opt.out == NULL) {
+                        perror("Opps! Can't open stats output file");
+                        eth->stat_opt.out = stdout;
+                        return EXIT_FAILURE;
+                    }
+
+                    i += 1;
+
+                } else {
+                    printf("Oops! Missing stats output filename.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Choose the fastest method this Kernel and interface support
+            } else if (strcmp(argv[i], "-p") == 0 && argc > (i+1) &&
+                       strcmp(argv[i+1], "auto") == 0) {
+
+                eth->app_opt.sk_type = SKT_AUTO;
+                i += 1;
+
+
             // Use send()/read() syscalls
             } else if (strncmp(argv[i], "-p0", 3) == 0) {
 
@@ -274,23 +511,140 @@ uint8_t cli_args(int argc, char *argv[], struct etherate *eth) {
                 eth->app_opt.sk_type = SKT_PACKET_MMAP3;
 
 
+            // Have the Kernel send the frames with XDP live frames mode
+            } else if (strncmp(argv[i], "-p5", 3) == 0) {
+
+                eth->app_opt.sk_type = SKT_XDP_LIVE;
+
+
+            // Send and receive with a DPDK poll mode driver
+            } else if (strncmp(argv[i], "-p6", 3) == 0) {
+
+                eth->app_opt.sk_type = SKT_DPDK;
+
+
+            // Write and read frames on the queues of a TAP interface
+            } else if (strncmp(argv[i], "-p7", 3) == 0) {
+
+                eth->app_opt.sk_type = SKT_TAP;
+
+
+            // Vary the Tx rate over time
+            } else if (strncmp(argv[i], "--profile", 9) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->app_opt.prof_spec = argv[i+1];
+                    i += 1;
+                } else {
+                    printf("Oops! Missing rate profile.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Map worker N to NIC queue N, optionally moving the queue IRQs
+            } else if (strncmp(argv[i], "-Q", 2) == 0) {
+
+                eth->app_opt.q_map = QMAP_IRQ;
+                eth->app_opt.thd_affin = 1;
+
+                if (argc > (i+1) && strncmp(argv[i+1], "set", 3) == 0) {
+                    eth->app_opt.q_map = QMAP_SET;
+                    i += 1;
+                }
+
+
+            // Reflect received frames back to their sender
+            } else if (strncmp(argv[i], "-R", 2) == 0) {
+
+                eth->app_opt.sk_mode = SKT_REFLECT;
+
+
+            // Run in bidirectional mode, before -r which is a prefix of it
+            } else if (strncmp(argv[i], "-rt", 3) == 0) {
+
+                eth->app_opt.sk_mode = SKT_BIDI;
+
+
             // Run in receive mode
             } else if (strncmp(argv[i], "-r" ,2) == 0)  {
 
                 eth->app_opt.sk_mode = SKT_RX;
 
 
-            // Run in bidirectional mode
-            } else if (strncmp(argv[i], "-rt", 3) == 0) {
+            // Run the RFC 2544 throughput test with this loss threshold
+            } else if (strncmp(argv[i], "--rfc2544", 9) == 0) {
 
-                eth->app_opt.sk_mode = SKT_BIDI;
+                if (argc > (i+1)) {
+                    eth->app_opt.rfc2544_loss = strtod(argv[i+1], NULL);
+                    i += 1;
+                } else {
+                    printf("Oops! Missing RFC 2544 loss threshold.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
 
 
-            // Toggle strict thread/CPU affinity
+            // Publish live stats to a /dev/shm segment
+            } else if (strncmp(argv[i], "-S", 2) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->stat_opt.shm_name = argv[i+1];
+                    i += 1;
+                } else {
+                    printf("Oops! Missing stats segment name.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Limit the Tx rate in frames per second
+            } else if (strncmp(argv[i], "-t", 2) == 0) {
+
+                if (argc > (i+1)) {
+                    eth->app_opt.tx_rate = strtoull(argv[i+1], NULL, 0);
+                    i += 1;
+                } else {
+                    printf("Oops! Missing Tx rate.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Toggle strict thread/CPU affinity, optionally on a list of CPUs
             } else if (strncmp(argv[i], "-x", 2) == 0) {
 
                 eth->app_opt.thd_affin = 1;
 
+                if (argc > (i+1) && argv[i+1][0] >= '0' && argv[i+1][0] <= '9') {
+                    if (cpu_list_parse(argv[i+1], &eth->app_opt.thd_cpus) != EXIT_SUCCESS) {
+                        printf("Oops! Invalid worker CPU list %s.\n"
+                               "Usage info: %s -h\n", argv[i+1], argv[0]);
+                        return EXIT_FAILURE;
+                    }
+                    i += 1;
+                }
+
+
+            // Pin main() and the stats thread to housekeeping CPUs
+            } else if (strncmp(argv[i], "-X", 2) == 0) {
+
+                if (argc > (i+1) &&
+                    cpu_list_parse(argv[i+1], &eth->app_opt.hk_cpus) == EXIT_SUCCESS &&
+                    CPU_COUNT(&eth->app_opt.hk_cpus) > 0) {
+                    i += 1;
+                } else {
+                    printf("Oops! Missing or invalid housekeeping CPU list.\n"
+                           "Usage info: %s -h\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+
+
+            // Drop or reflect the frames with an XDP program instead of sockets
+            } else if (strncmp(argv[i], "--xdp", 5) == 0) {
+
+                eth->app_opt.xdp = 1;
+
 
             // Enable verbose output
             } else if (strncmp(argv[i], "-v" ,2) == 0)  {
@@ -306,6 +660,16 @@ uint8_t cli_args(int argc, char *argv[], struct etherate *eth) {
                 exit(EX_SOFTWARE);
 
 
+            // The rest are DPDK EAL args for -p6, rte_eal_init() expects
+            // the program name in place of the "--"
+            } else if (strcmp(argv[i], "--") == 0) {
+
+                argv[i] = argv[0];
+                eth->app_opt.eal_argc = argc - i;
+                eth->app_opt.eal_argv = &argv[i];
+                break;
+
+
             // Unknown CLI arg
             } else {
 
@@ -331,11 +695,67 @@ void etherate_cleanup(struct etherate *eth) {
     if (eth->app_opt.thd_attr != NULL)
         free(eth->app_opt.thd_attr);
 
+    if (eth->app_opt.thd_cpu_list != NULL)
+        free(eth->app_opt.thd_cpu_list);
+
+    // The DPDK ports and pools go before the per-thread settings which use them
+    dpdk_cleanup(eth);
+    memif_cleanup(eth);
+
+    free(eth->app_opt.lat_hists);
+    free(eth->app_opt.lat_res);
+    free(eth->app_opt.mesh_ctrs);
+    if (eth->app_opt.prof != NULL)
+        free(eth->app_opt.prof->pts);
+    free(eth->app_opt.prof);
+    free(eth->app_opt.q_rx_irq);
+    free(eth->app_opt.q_tx_irq);
+
+    if (eth->app_opt.fanout_prog != -1) {
+        if (close(eth->app_opt.fanout_prog) != 0)
+            perror("Can't close fanout eBPF program");
+        eth->app_opt.fanout_prog = -1;
+    }
+
     if (eth->frm_opt.tx_buffer != NULL)
         free(eth->frm_opt.tx_buffer);
 
-    if (eth->thd_opt != NULL)
+    // Close the worker sockets and free the per-thread buffers
+    if (eth->thd_opt != NULL) {
+        for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1)
+            thd_cleanup(&eth->thd_opt[thread]);
         free(eth->thd_opt);
+    }
+
+    if (eth->stat_opt.now != NULL)
+        free(eth->stat_opt.now);
+
+    if (eth->stat_opt.prev != NULL)
+        free(eth->stat_opt.prev);
+
+    free(eth->stat_opt.mesh_now);
+    free(eth->stat_opt.mesh_prev);
+
+    hist_close(eth);
+
+    shm_stats_remove(eth);
+
+    if (eth->stat_opt.snap.thd != NULL)
+        free(eth->stat_opt.snap.thd);
+
+    if (eth->stat_opt.metrics_sock != -1) {
+        if (close(eth->stat_opt.metrics_sock) != 0)
+            perror("Can't close metrics socket");
+        if (strchr(eth->stat_opt.metrics_addr, '/') != NULL)
+            unlink(eth->stat_opt.metrics_addr);
+        eth->stat_opt.metrics_sock = -1;
+    }
+
+    if (eth->stat_opt.out != NULL && eth->stat_opt.out != stdout) {
+        if (fclose(eth->stat_opt.out) != 0)
+            perror("Error closing stats output file");
+        eth->stat_opt.out = stdout;
+    }
 
     rem_int_promisc(eth);
 
@@ -345,17 +765,58 @@ void etherate_cleanup(struct etherate *eth) {
 
 void etherate_setup(struct etherate *eth) {
 
-    // All fanout worker threads will belong to the same fanout group
+    eth->app_opt.bench_path     = NULL;
+    eth->app_opt.byte_lim       = 0;
+    eth->app_opt.burst_duty     = 0;
+    eth->app_opt.burst_gap      = 0;
+    eth->app_opt.burst_nr       = 0;
+    eth->app_opt.dpdk_eal       = 0;
+    eth->app_opt.dpdk_qs        = NULL;
+    eth->app_opt.dur_lim        = 0;
+    eth->app_opt.eal_argc       = 0;
+    eth->app_opt.eal_argv       = NULL;
     eth->app_opt.err_len        = DEF_ERR_LEN;
     eth->app_opt.err_str        = NULL;
-    eth->app_opt.fanout_grp     = getpid() & 0xffff;
+    eth->app_opt.fanout_flags   = 0;
+    eth->app_opt.fanout_prog    = -1;
+    eth->app_opt.fanout_type    = PACKET_FANOUT_CPU;
+    CPU_ZERO(&eth->app_opt.hk_cpus);
+    eth->app_opt.frm_lim        = 0;
+    eth->app_opt.lat_hists      = NULL;
+    eth->app_opt.lat_rate       = 0;
+    eth->app_opt.lat_ref        = 0;
+    eth->app_opt.lat_res        = NULL;
+    eth->app_opt.lat_step       = 0;
+    eth->app_opt.lat_step_ms    = 0;
+    eth->app_opt.memif          = NULL;
+    eth->app_opt.memif_path     = NULL;
+    eth->app_opt.memif_qs       = NULL;
+    eth->app_opt.memif_sz       = 0;
+    eth->app_opt.mesh           = 0;
+    eth->app_opt.mesh_ctrs      = NULL;
+    eth->app_opt.numa_node      = -1;
+    eth->app_opt.prof           = NULL;
+    eth->app_opt.prof_spec      = NULL;
+    eth->app_opt.q_map          = QMAP_OFF;
+    eth->app_opt.q_rx_irq       = NULL;
+    eth->app_opt.q_rx_nr        = 0;
+    eth->app_opt.q_tx_irq       = NULL;
+    eth->app_opt.q_tx_nr        = 0;
+    eth->app_opt.rfc2544_loss   = -1;
     eth->app_opt.sk_mode        = SKT_TX;
     eth->app_opt.sk_type        = DEF_SKT_TYPE;
+    eth->app_opt.stop           = 0;
     eth->app_opt.thd            = NULL;
     eth->app_opt.thd_affin      = 0;
     eth->app_opt.thd_attr       = NULL;
+    CPU_ZERO(&eth->app_opt.thd_cpus);
+    eth->app_opt.thd_cpu_list   = NULL;
+    eth->app_opt.thd_cpu_nr     = 0;
     eth->app_opt.thd_nr         = DEF_THD_NR;
+    eth->app_opt.tx_nr          = 0;
+    eth->app_opt.tx_rate        = 0;
     eth->app_opt.verbose        = 0;
+    eth->app_opt.xdp            = 0;
     
     eth->frm_opt.block_frm_sz   = DEF_BLK_FRM_SZ;
     eth->frm_opt.block_nr       = DEF_BLK_NR;
@@ -370,16 +831,138 @@ void etherate_setup(struct etherate *eth) {
         exit(EXIT_FAILURE);
     }
     
-    eth->sk_opt.if_index        = -1;
-    memset(&eth->sk_opt.if_name, 0, IF_NAMESIZE);
+    memset(&eth->sk_opt.if_opt, 0, sizeof(eth->sk_opt.if_opt));
+    eth->sk_opt.if_nr           = 0;
     eth->sk_opt.msgvec_vlen     = DEF_MSGVEC_LEN;
 
+    eth->stat_opt.done          = 0;
+    eth->stat_opt.duration      = 0;
+    eth->stat_opt.fmt           = STATS_FMT_TEXT;
+    eth->stat_opt.hist          = NULL;
+    eth->stat_opt.hist_dump     = 0;
+    eth->stat_opt.hist_path     = NULL;
+    eth->stat_opt.hist_sz       = 0;
+    eth->stat_opt.mesh_now      = NULL;
+    eth->stat_opt.mesh_prev     = NULL;
+    eth->stat_opt.metrics_addr  = NULL;
+    eth->stat_opt.metrics_sock  = -1;
+    eth->stat_opt.out           = stdout;
+    eth->stat_opt.now           = NULL;
+    eth->stat_opt.shm_buf       = NULL;
+    eth->stat_opt.shm_name      = NULL;
+    eth->stat_opt.shm_sz        = 0;
+    eth->stat_opt.prev          = NULL;
+    memset(&eth->stat_opt.rx_fps, 0, sizeof(struct stat_sum));
+    memset(&eth->stat_opt.rx_gbps, 0, sizeof(struct stat_sum));
+    memset(&eth->stat_opt.tx_fps, 0, sizeof(struct stat_sum));
+    memset(&eth->stat_opt.tx_gbps, 0, sizeof(struct stat_sum));
+
     eth->thd_opt                = NULL;
 
 }
 
 
 
+int16_t fanout_parse(char *arg, struct etherate *eth) {
+
+    // A mode optionally followed by flags, e.g. "hash,defrag,rollover"
+    static const struct {
+        const char *name;
+        uint16_t   type;
+    } modes[] = {
+        { "hash",     PACKET_FANOUT_HASH },
+        { "lb",       PACKET_FANOUT_LB },
+        { "cpu",      PACKET_FANOUT_CPU },
+        { "rollover", PACKET_FANOUT_ROLLOVER },
+        { "random",   PACKET_FANOUT_RND },
+        { "qm",       PACKET_FANOUT_QM },
+        { "cbpf",     PACKET_FANOUT_CBPF },
+        { "ebpf",     PACKET_FANOUT_EBPF },
+    };
+
+    uint16_t flags = 0;
+    uint8_t  found = 0;
+    char     *save = NULL;
+    char     *arg_copy = strdup(arg);
+
+    if (arg_copy == NULL)
+        return EXIT_FAILURE;
+
+    char *tok = strtok_r(arg_copy, ",", &save);
+
+    for (uint8_t i = 0; tok != NULL && i < sizeof(modes) / sizeof(modes[0]); i += 1) {
+        if (strcmp(tok, modes[i].name) == 0) {
+            eth->app_opt.fanout_type = modes[i].type;
+            found = 1;
+        }
+    }
+
+    if (!found) {
+        free(arg_copy);
+        return EXIT_FAILURE;
+    }
+
+    while ((tok = strtok_r(NULL, ",", &save)) != NULL) {
+        if (strcmp(tok, "defrag") == 0) {
+            flags |= PACKET_FANOUT_FLAG_DEFRAG;
+        } else if (strcmp(tok, "rollover") == 0) {
+            flags |= PACKET_FANOUT_FLAG_ROLLOVER;
+        } else {
+            free(arg_copy);
+            return EXIT_FAILURE;
+        }
+    }
+
+    eth->app_opt.fanout_flags = flags;
+    free(arg_copy);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+int16_t fanout_prog_load(struct etherate *eth) {
+
+    // Return the flow ID at FLOW_ID_OFF from the MAC header, the Kernel
+    // takes it modulo the number of sockets in the fanout group:
+    // r6 = r1 (ctx for LD_ABS), r0 = ntohl(*(u32*)(mac + FLOW_ID_OFF)), exit
+    struct bpf_insn insns[] = {
+        { .code = BPF_ALU64 | BPF_MOV | BPF_X, .dst_reg = BPF_REG_6, .src_reg = BPF_REG_1 },
+        { .code = BPF_LD | BPF_W | BPF_ABS, .imm = SKF_LL_OFF + FLOW_ID_OFF },
+        { .code = BPF_JMP | BPF_EXIT },
+    };
+
+    char log_buf[1024] = {0};
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+    attr.insns     = (uint64_t)(uintptr_t)insns;
+    attr.insn_cnt  = sizeof(insns) / sizeof(insns[0]);
+    attr.license   = (uint64_t)(uintptr_t)"GPL";
+    attr.log_buf   = (uint64_t)(uintptr_t)log_buf;
+    attr.log_size  = sizeof(log_buf);
+    attr.log_level = 1;
+
+    eth->app_opt.fanout_prog = syscall(SYS_bpf, BPF_PROG_LOAD, &attr, sizeof(attr));
+
+    if (eth->app_opt.fanout_prog == -1) {
+        perror("Can't load the fanout eBPF program");
+        if (eth->app_opt.verbose && log_buf[0] != 0)
+            printf("%s\n", log_buf);
+        return EXIT_FAILURE;
+    }
+
+    if (eth->app_opt.verbose)
+        printf("Loaded fanout eBPF program (fd %" PRId32 ").\n", eth->app_opt.fanout_prog);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
 int32_t get_if_index_by_name(uint8_t if_name[IF_NAMESIZE]) {
 
     int32_t sock;
@@ -491,6 +1074,42 @@ void get_if_list() {
 
 
 
+int16_t get_if_macs(struct etherate *eth) {
+
+    int32_t sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (sock == -1) {
+        perror("Can't open socket to read the interface MACs");
+        return EXIT_FAILURE;
+    }
+
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+
+        struct if_opt *if_opt = &eth->sk_opt.if_opt[if_idx];
+        struct ifreq  ifr;
+
+        memset(&ifr, 0, sizeof(ifr));
+        strncpy(ifr.ifr_name, (char*)if_opt->if_name, IFNAMSIZ - 1);
+
+        if (ioctl(sock, SIOCGIFHWADDR, &ifr) == -1) {
+            perror("Can't get the interface MAC address");
+            if (close(sock) != 0)
+                perror("Can't close socket");
+            return EXIT_FAILURE;
+        }
+
+        memcpy(if_opt->mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+
+    }
+
+    if (close(sock) != 0)
+        perror("Can't close socket");
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
 void get_if_name_by_index(int32_t if_index, uint8_t* if_name) { //// Why no return value on this function?
 
     int32_t sock;
@@ -523,6 +1142,39 @@ void get_if_name_by_index(int32_t if_index, uint8_t* if_name) { //// Why no retu
 
 
 
+uint32_t get_if_speed(uint8_t *if_name) {
+
+    char    path[128];
+    int64_t speed = -1;
+
+    snprintf(path, sizeof(path), "/sys/class/net/%s/speed", if_name);
+
+    // Reading it fails or gives -1 when the link speed isn't known
+    FILE *speed_file = fopen(path, "r");
+    if (speed_file == NULL)
+        return 0;
+
+    if (fscanf(speed_file, "%" SCNd64, &speed) != 1)
+        speed = -1;
+
+    fclose(speed_file);
+
+    return (speed > 0 && speed <= UINT32_MAX ? speed : 0);
+
+}
+
+
+
+uint64_t get_time_ns() {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+
+}
+
+
+
 void print_usage () {
 
     printf ("Usage info;\n"
@@ -530,33 +1182,151 @@ void print_usage () {
             "\t\tThis includes meta data. Default is %" PRId32 " bytes.\n"
             "\t-b\tBlock size in ring buffer (for PACKET_MMAP). Default is %" PRId32 " bytes.\n"
             "\t-B\tNumber of blocks in ring buffer (for PACKET_MMAP). Default is %" PRId32 ".\n"
+            "\t--bench\tBenchmark -p0 to -p4 in Tx mode with the RFC 2544 frame sizes\n"
+            "\t\twithout the FCS (60 to 1514 bytes) and 9000 (up to the MTU), with\n"
+            "\t\t1 to -c worker threads, each for %.1f seconds\n"
+            "\t\t(or -d seconds) after %.1f seconds warm-up. Prints a table of Mpps,\n"
+            "\t\tGbps and cycles and CPU time per frame, and writes it as JSON to\n"
+            "\t\tthis file.\n"
+            "\t--burst <frames>,<gap us>|<duty %%>\n"
+            "\t\tMicrobursts. Each Tx worker sends <frames> frames back to back,\n"
+            "\t\tthen idles for <gap us> microseconds, or for as long as gives the\n"
+            "\t\tduty cycle at the interface's line rate when the gap ends in %%\n"
+            "\t\t(e.g. 64,10%%). Use one Tx worker per interface for exact bursts, and\n"
+            "\t\t-m (for -p3) or the ring (for -p1/-p4) at least <frames> big to\n"
+            "\t\tsend each burst with a single system call.\n"
             "\t-c\tNumber of worker threads to start. One more thread is started in addition\n"
             "\t\tto this value to print stats. Default is %" PRId32".\n"
             "\t-C\tLoad a custom frame from file formatted as hex bytes.\n"
             "\t\tDefault (when not using -C) the frame is random data.\n"
+            "\t-d\tStop after this many seconds. Default is to run until Ctrl+C.\n"
             "\t-f\tFrame size in bytes (excluding Preamble/SFD/CRC/IFG).\n"
             "\t\tThis has no effect when used with -C.\n"
             "\t\tDefault is %" PRId16 ", max %" PRId16 ".\n"
+            "\t-F\tFanout mode used to spread frames over the Rx worker threads, one of\n"
+            "\t\thash, lb, cpu, rollover, random, qm, cbpf or ebpf, optionally followed\n"
+            "\t\tby the flags defrag and/or rollover, e.g. hash,defrag. cbpf and ebpf\n"
+            "\t\tsteer by the flow ID that each Tx worker stamps into its frames (the\n"
+            "\t\t4 bytes after the Ethernet header). Default is cpu.\n"
+            "\t\tWith several Rx workers -v shows each worker's share of the frames,\n"
+            "\t\tand a warning is printed when the fanout is unbalanced.\n"
+            "\t-H\tKeep a fixed size rate history in this file (1s samples for an\n"
+            "\t\thour, 1m for a week, 1h for a year). It is written as CSV to\n"
+            "\t\t<file>.csv on exit or SIGUSR1, and survives a crash.\n"
             "\t-i\tSet interface by name.\n"
             "\t-I\tSet interface by index.\n"
+            "\t\t-i/-I can be repeated (up to %" PRId32 " interfaces), worker N then\n"
+            "\t\tuses interface N modulo the number of interfaces and each interface\n"
+            "\t\thas its own fanout group. At least one worker per interface is started.\n"
             "\t-l\tList available interfaces.\n"
+            "\t--latency <fps>\n"
+            "\t\tLatency under load. Worker 0 sends <fps> probes with a sequence\n"
+            "\t\tnumber and timestamp on their own flow ID while the other Tx\n"
+            "\t\tworkers send a background load stepping from 10%% to 100%% of -t\n"
+            "\t\t(or line rate), for -d seconds per step (default %.1f). Runs bidi\n"
+            "\t\tlike --rfc2544 and prints the probe latency percentiles of each step.\n"
             "\t-m\tSet the number of packets to batch process with sendmmsg()/recvmmsg().\n"
-            "\t\tDefault is %" PRId16 ".\n"
-            "\t-p[0-4]\tChose the Kernel send/receive method.\n"
+            "\t\tDefault is %" PRId16 ".\n",
+            DEF_BLK_FRM_SZ, DEF_BLK_SZ, DEF_BLK_NR,
+            BENCH_RUN_MS / 1000.0, BENCH_WARM_MS / 1000.0, DEF_THD_NR,
+            DEF_FRM_SZ, DEF_FRM_SZ_MAX, DEF_IF_MAX, LAT_STEP_MS / 1000.0, DEF_MSGVEC_LEN);
+
+    printf ("\t-M\tServe OpenMetrics counters on 127.0.0.1:<port>, or on a Unix\n"
+            "\t\tsocket if the value is a path (contains a \"/\").\n"
+            "\t-n\tStop after this many frames. In Tx mode the frames are split\n"
+            "\t\tbetween the worker threads and exactly this many are sent.\n"
+            "\t--memif\tExchange frames with another EtherateMT on this host through\n"
+            "\t\tshared memory rings instead of an interface, in the style of memif.\n"
+            "\t\tStart the Rx side first with -r --memif <path>, it creates the rings\n"
+            "\t\tand waits on the Unix socket <path> for the Tx side, started with\n"
+            "\t\t--memif <path> and the same -c. The Rx side's -f is the largest\n"
+            "\t\tframe the Tx side can send.\n"
+            "\t--mesh\tFull mesh test between all the -i/-I interfaces (at least two).\n"
+            "\t\tOne Tx worker per ordered pair of interfaces sends to the MAC of\n"
+            "\t\tthe destination interface, -c is the number of Rx workers per\n"
+            "\t\tinterface. -n/-N are split over the Tx workers. The summary shows\n"
+            "\t\tthe frames received and the loss of each pair, -v shows the Rx\n"
+            "\t\trate of each pair every second.\n"
+            "\t-N\tStop after this many bytes (rounded up to whole frames in Tx mode).\n"
+            "\t\tThe in-flight frames are drained and the final totals printed when\n"
+            "\t\tany limit is reached. Ctrl+C does the same, press it twice to exit\n"
+            "\t\twithout draining.\n");
+
+    printf ("\t-o\tStats output format, one of text, json or csv. Default is text.\n"
+            "\t\tjson prints one JSON object per second, csv prints one row per\n"
+            "\t\tthread per second plus a \"total\" row. Both include per-thread stats.\n"
+            "\t-O\tWrite the json/csv stats records to this file instead of stdout.\n"
+            "\t-p[0-7]\tChose the Kernel send/receive method.\n"
             "\t-p0\tThis is the default send/receive mode, a single packet per send()/read() syscall.\n"
             "\t-p1\tSwith to PACKET_MMAP mode using PACKET_TX/RX_RING v2 to batch process a ring of packets.\n"
             "\t-p2\tSwitch to sendmsg()/recvmsg() syscalls per packet.\n"
             "\t-p3\tSwitch to sendmmsg()/recvmmsg() syscalls to batch process packets.\n"
             "\t-p4\tSwitch to PACKET_MMAP mode with PACKET_TX/RX_RING v3 to batch process a ring of packets.\n"
+            "\t-p5\tTx only, the Kernel sends copies of the frame through the driver's\n"
+            "\t\tXDP_TX path with BPF_PROG_TEST_RUN live frames mode (Linux 5.18+).\n"
+            "\t\tFrames the driver fails to send are still counted as sent.\n"
+            "\t-p6\tUse DPDK, if built with it (see INSTALL). The args after \"--\" go\n"
+            "\t\tto the EAL and every port it finds is used instead of -i/-I, e.g.\n"
+            "\t\t-p6 -c 2 -- -l 0 --vdev=net_ring0\n"
+            "\t-p7\tEach worker attaches a queue to the -i TAP interface, created with\n"
+            "\t\t\"ip tuntap add <name> mode tap multi_queue\", and writes (Tx) or\n"
+            "\t\treads (Rx) frames with a vnet header, one writev()/readv() per frame.\n"
+            "\t-p auto\tCheck which of -p0 to -p4 the running Kernel supports, run each\n"
+            "\t\tone alone on one worker for %.1f seconds with the chosen mode and\n"
+            "\t\tframe size, then use the fastest. The trials send real frames, in\n"
+            "\t\tRx mode they measure the traffic already arriving.\n"
+            "\t--profile <spec>\n"
+            "\t\tVary the total Tx rate over time instead of -t, one of\n"
+            "\t\tramp:<from fps>,<to fps>,<secs>, step:<secs>,<fps>[,<fps>...],\n"
+            "\t\tsine:<min fps>,<max fps>,<period secs> or a CSV file of\n"
+            "\t\t<secs>,<fps> lines. The rate between points is interpolated and\n"
+            "\t\tthe last one is held, without -d the test stops at the last point.\n"
             "\t-[r|rt]\tThe default mode for a worker thread is transmit (Tx).\n"
+            "\t-Q\tMap worker N to NIC queue N (implies -x). Each worker is pinned to\n"
+            "\t\tthe CPU handling its queue (the XPS map for Tx, the IRQ for Rx),\n"
+            "\t\tand Rx uses PACKET_FANOUT_QM so that worker N receives queue N.\n"
+            "\t-Q set\tAs -Q but keep the -x CPUs and move queue N's IRQs and XPS map\n"
+            "\t\tto worker N's CPU instead. The old settings are not restored.\n"
             "\t-r\tRun the worker threads in receive (Rx) mode.\n"
+            "\t-R\tReflector mode, send every received frame back out of the same\n"
+            "\t\tinterface with the source and destination MACs swapped, as a\n"
+            "\t\tfar-end loopback for another Etherate. Frames are received on a\n"
+            "\t\tPACKET_MMAP v3 ring and copied once into a v2 Tx ring, frames\n"
+            "\t\tlarger than -f are not reflected.\n"
+            "\t-rt\tRun in bidirectional mode, -c is the number of Tx/Rx worker\n"
+            "\t\tpairs. The Rx workers ignore frames sent from this host, so\n"
+            "\t\tthe Rx rate is what came back from the device under test.\n",
+            (PROBE_WARM_MS + PROBE_RUN_MS) / 1000.0);
+
+    printf ("\t--rfc2544 <loss %%>\n"
+            "\t\tRFC 2544 throughput test. For each frame size from 64 to 1518\n"
+            "\t\tbytes (with the FCS) binary search the highest -t rate at which\n"
+            "\t\tat most <loss %%> of the frames sent are lost, then print the\n"
+            "\t\tcurve. Runs bidi (-rt) over two or more -i/-I interfaces connected\n"
+            "\t\tthrough the device under test, or one interface looped back by it.\n"
+            "\t\tEach trial runs for -d seconds (default %.1f) plus %.1f seconds\n"
+            "\t\tfor the frames in flight to arrive.\n"
+            "\t-S\tPublish live per-thread counters and rates to /dev/shm/<name>\n"
+            "\t\tfor external monitors, see shm_stats.h for the layout.\n"
+            "\t-t\tSend at most this many frames per second in total, split between\n"
+            "\t\tthe Tx worker threads. Frames are sent in smaller batches as needed\n"
+            "\t\tto keep to the rate. Default is no limit.\n"
             "\t-v\tEnable verbose output.\n"
-            "\t-x\tLock worker threads to individual CPUs.\n"
+            "\t-x\tLock worker threads to individual CPUs, optionally followed by a\n"
+            "\t\tCPU list (e.g. 2-9,18-25). Without a list isolcpus/nohz_full CPUs on\n"
+            "\t\tthe interface's NUMA node are preferred, and CPUs handling the\n"
+            "\t\tinterface IRQs and SMT siblings are used last. Workers always run on\n"
+            "\t\tthe interface's NUMA node when it is known.\n"
+            "\t-X\tPin main() and the stats thread to this housekeeping CPU list.\n"
+            "\t--xdp\tWith -r or -R, attach an XDP program to each interface which\n"
+            "\t\tcounts the frames in a per-CPU map and drops them (-r) or sends\n"
+            "\t\tthem back with the MACs swapped (-R), instead of running socket\n"
+            "\t\tworkers. Native mode is used if the driver supports it, else\n"
+            "\t\tgeneric mode. Requires Linux 5.18 or later.\n"
             "\n"
             "\t-V|--version Display version\n"
             "\t-h|--help Display this help text\n",
-            DEF_BLK_FRM_SZ, DEF_BLK_SZ, DEF_BLK_NR, DEF_THD_NR,
-            DEF_FRM_SZ, DEF_FRM_SZ_MAX, DEF_MSGVEC_LEN);
+            RFC2544_TRIAL_MS / 1000.0, RFC2544_SETTLE_MS / 1000.0);
 
 }
 
@@ -564,40 +1334,56 @@ void print_usage () {
 
 int16_t rem_int_promisc(struct etherate *eth) {
 
-    printf("Removing interface promiscuous mode\n");
+    int16_t ret = EXIT_SUCCESS;
 
-    strncpy(eth->ifr.ifr_name, (char*)eth->sk_opt.if_name, IFNAMSIZ);
+    // Only undo what set_int_promisc() did, some interfaces may have failed
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
 
+        struct if_opt *if_opt = &eth->sk_opt.if_opt[if_idx];
 
-    int32_t sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
-    if (sock == -1){
-        perror("Can't open socket for promiscuous mode");
-        return EX_SOFTWARE;
-    }
+        if (!if_opt->promisc)
+            continue;
 
+        printf("Removing interface promiscuous mode from %s\n", if_opt->if_name);
 
-    if (ioctl(sock, SIOCGIFFLAGS, &eth->ifr) == -1) {
-        perror("Getting socket flags when removing promiscuous mode failed");
-        if (close(sock) != 0)
-            perror("Can't close socket for promiscuous mode");
-        return EX_SOFTWARE;
-    }
+        strncpy(eth->ifr.ifr_name, (char*)if_opt->if_name, IFNAMSIZ);
+
+
+        int32_t sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+        if (sock == -1){
+            perror("Can't open socket for promiscuous mode");
+            return EX_SOFTWARE;
+        }
+
+
+        if (ioctl(sock, SIOCGIFFLAGS, &eth->ifr) == -1) {
+            perror("Getting socket flags when removing promiscuous mode failed");
+            if (close(sock) != 0)
+                perror("Can't close socket for promiscuous mode");
+            ret = EX_SOFTWARE;
+            continue;
+        }
+
+        eth->ifr.ifr_flags &= ~IFF_PROMISC;
+
+        if (ioctl(sock, SIOCSIFFLAGS, &eth->ifr) == -1) {
+            perror("Setting socket flags when removing promiscuous mode failed");
+            if (close(sock) != 0)
+                perror("Can't close socket for promiscuous mode");
+            ret = EX_SOFTWARE;
+            continue;
+        }
+
+        if_opt->promisc = 0;
 
-    eth->ifr.ifr_flags &= ~IFF_PROMISC;
 
-    if (ioctl(sock, SIOCSIFFLAGS, &eth->ifr) == -1) {
-        perror("Setting socket flags when removing promiscuous mode failed");
         if (close(sock) != 0)
             perror("Can't close socket for promiscuous mode");
-        return EX_SOFTWARE;
-    }
 
+    }
 
-    if (close(sock) != 0)
-        perror("Can't close socket for promiscuous mode");
 
-
-    return EXIT_SUCCESS;
+    return ret;
 
 }
 
@@ -605,34 +1391,42 @@ int16_t rem_int_promisc(struct etherate *eth) {
 
 int16_t set_int_promisc(struct etherate *eth) {
 
-    printf("Setting interface promiscuous mode\n");
-    strncpy(eth->ifr.ifr_name, (char*)eth->sk_opt.if_name, IFNAMSIZ);
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
 
-    int32_t sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
-    if (sock == -1){
-        perror("Can't open socket for promiscuous mode");
-        return EX_SOFTWARE;
-    }
+        struct if_opt *if_opt = &eth->sk_opt.if_opt[if_idx];
 
-    if (ioctl(sock, SIOCGIFFLAGS, &eth->ifr) == -1) {
-        perror("Getting socket flags failed when setting promiscuous mode");
-        if (close(sock) != 0)
-            perror("Can't close socket for promiscuous mode");
-        return EX_SOFTWARE;
-    }
+        printf("Setting interface promiscuous mode on %s\n", if_opt->if_name);
+        strncpy(eth->ifr.ifr_name, (char*)if_opt->if_name, IFNAMSIZ);
+
+        int32_t sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+        if (sock == -1){
+            perror("Can't open socket for promiscuous mode");
+            return EX_SOFTWARE;
+        }
+
+        if (ioctl(sock, SIOCGIFFLAGS, &eth->ifr) == -1) {
+            perror("Getting socket flags failed when setting promiscuous mode");
+            if (close(sock) != 0)
+                perror("Can't close socket for promiscuous mode");
+            return EX_SOFTWARE;
+        }
+
+        eth->ifr.ifr_flags |= IFF_PROMISC;
+
+        if (ioctl(sock, SIOCSIFFLAGS, &eth->ifr) == -1){
+            perror("Setting socket flags failed when setting promiscuous mode");
+            if (close(sock) != 0)
+                perror("Can't close socket for promiscuous mode");
+            return EX_SOFTWARE;
+        }
+
+        if_opt->promisc = 1;
 
-    eth->ifr.ifr_flags |= IFF_PROMISC;
 
-    if (ioctl(sock, SIOCSIFFLAGS, &eth->ifr) == -1){
-        perror("Setting socket flags failed when setting promiscuous mode");
         if (close(sock) != 0)
             perror("Can't close socket for promiscuous mode");
-        return EX_SOFTWARE;
-    }
-
 
-    if (close(sock) != 0)
-        perror("Can't close socket for promiscuous mode");
+    }
 
 
     return EXIT_SUCCESS;
@@ -641,41 +1435,25 @@ int16_t set_int_promisc(struct etherate *eth) {
 
 
 
-void signal_handler(int signal) {
+void signal_dump(int signal) {
 
-    struct etherate *eth = eth_p;
+    // Only set a flag, the stats thread writes the file
+    (void)signal;
+    eth_p->stat_opt.hist_dump = 1;
 
-    printf("Quitting...\n");
+}
 
-    // Cancel the stats thread and join it
-    int32_t pcancel = pthread_cancel(eth->app_opt.thd[eth->app_opt.thd_nr]);
-    if (pcancel != 0) {
-        printf(
-            "Can't cancel stats thread %" PRIu32 ", returned %" PRId32 "\n",
-            eth->thd_opt[eth->app_opt.thd_nr].thd_id, pcancel
-        );
-    }
 
-    void *thd_ret = NULL;
-    pthread_join(eth->app_opt.thd[eth->app_opt.thd_nr], &thd_ret);
 
-    // Cancel worker threads and join them
-    for(uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+void signal_handler(int sig) {
 
-        pcancel = pthread_cancel(eth->app_opt.thd[thread]);
-        if (pcancel != 0)
-            printf(
-                "Can't cancel worker thread %" PRIu32
-                ", returned %" PRId32 "\n",
-                eth->thd_opt[thread].thd_id, pcancel
-            );
+    (void)sig;
 
-        thd_ret = NULL;
-        pthread_join(eth->app_opt.thd[thread], &thd_ret);
+    // The workers drain and the final report is printed by main(),
+    // a second SIGINT exits immediately
+    eth_p->app_opt.stop = 1;
+    signal(SIGINT, SIG_DFL);
 
-    }
-
-    etherate_cleanup(eth);
-    exit(signal);
+    printf("Quitting...\n");
 
 }
\ No newline at end of file
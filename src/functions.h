@@ -28,6 +28,9 @@
 #ifndef _FUNCTIONS_H_
 #define _FUNCTIONS_H_
 
+// Add an interface to sk_opt.if_opt
+int16_t add_if(struct etherate *eth, int32_t if_index, uint8_t *if_name);
+
 // Process CLI args
 uint8_t cli_args(int argc, char *argv[], struct etherate *eth);
 
@@ -37,25 +40,43 @@ void etherate_cleanup(struct etherate *eth);
 // Populate settings with default values
 void etherate_setup(struct etherate *eth);
 
+// Parse the -F fanout mode and flags
+int16_t fanout_parse(char *arg, struct etherate *eth);
+
+// Load the eBPF program that steers PACKET_FANOUT_EBPF by flow ID
+int16_t fanout_prog_load(struct etherate *eth);
+
 // Return interface index from name
 int32_t get_if_index_by_name(uint8_t if_name[IF_NAMESIZE]);
 
 // List available AF_PACKET interfaces and their interface index
 void get_if_list();
 
+// Read the MAC address of each interface into sk_opt.if_opt
+int16_t get_if_macs(struct etherate *eth);
+
 // Copy interface name from interface index number into char*
 void get_if_name_by_index(int32_t if_index, uint8_t* if_name);
 
+// Return the link speed of an interface in Mbps, 0 if unknown
+uint32_t get_if_speed(uint8_t *if_name);
+
+// Return CLOCK_MONOTONIC time in nanoseconds
+uint64_t get_time_ns();
+
 // Print CLI args and usage
 void print_usage();
 
-// Remove the interface from promiscuous mode
+// Remove promiscuous mode from the interfaces set_int_promisc() changed
 int16_t rem_int_promisc(struct etherate *eth);
 
-// Set the interface an interface in promiscuous mode
+// Put each interface in promiscuous mode
 int16_t set_int_promisc(struct etherate *eth);
 
-// Signal handler to clean up threads
-void signal_handler(int signal);
+// SIGUSR1 handler to request a dump of the rate history
+void signal_dump(int signal);
+
+// SIGINT handler to stop the worker threads
+void signal_handler(int sig);
 
 #endif // _FUNCTIONS_H_
\ No newline at end of file
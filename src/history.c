@@ -0,0 +1,279 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "history.h"
+
+
+
+void hist_add(struct etherate *eth, uint64_t rx_bytes, uint64_t rx_frms,
+              uint64_t tx_bytes, uint64_t tx_frms, uint64_t errors,
+              uint64_t drops, uint64_t freezes) {
+
+    struct hist_sample sample;
+
+    sample.time       = (uint64_t)time(NULL);
+    sample.samples    = 1;
+    sample.rx_bps     = (double)(rx_bytes * 8);
+    sample.rx_fps     = (double)rx_frms;
+    sample.rx_fps_max = (double)rx_frms;
+    sample.rx_fps_min = (double)rx_frms;
+    sample.tx_bps     = (double)(tx_bytes * 8);
+    sample.tx_fps     = (double)tx_frms;
+    sample.tx_fps_max = (double)tx_frms;
+    sample.tx_fps_min = (double)tx_frms;
+    sample.errors     = errors;
+    sample.drops      = drops;
+    sample.freezes    = freezes;
+
+    hist_push(eth->stat_opt.hist, 0, &sample);
+
+}
+
+
+
+void hist_close(struct etherate *eth) {
+
+    struct stat_opt *stat_opt = &eth->stat_opt;
+
+    if (stat_opt->hist == NULL)
+        return;
+
+    if (hist_dump(stat_opt->hist, stat_opt->hist_csv) == EXIT_SUCCESS)
+        printf("Rate history written to %s\n", stat_opt->hist_csv);
+
+    if (munmap(stat_opt->hist, stat_opt->hist_sz) != 0)
+        perror("Can't unmap history file");
+
+    stat_opt->hist = NULL;
+
+}
+
+
+
+int32_t hist_dump(struct hist_hdr *hist, const char *path) {
+
+    FILE *csv = fopen(path, "w");
+    if (csv == NULL) {
+        perror("Can't open history CSV file");
+        return EXIT_FAILURE;
+    }
+
+    fprintf(csv, "period,time,samples,rx_bps,rx_fps,rx_fps_min,rx_fps_max,"
+            "tx_bps,tx_fps,tx_fps_min,tx_fps_max,errors,drops,freezes\n");
+
+    // Coarsest ring first so that the output is roughly in time order
+    for (int8_t r = (int8_t)hist->ring_nr - 1; r >= 0; r -= 1) {
+
+        struct hist_ring   *ring    = &hist->ring[r];
+        struct hist_sample *samples = hist_ring_samples(hist, (uint8_t)r);
+        uint64_t           count    = (ring->head < ring->len ? ring->head : ring->len);
+
+        for (uint64_t i = ring->head - count; i < ring->head; i += 1) {
+
+            struct hist_sample *s = &samples[i % ring->len];
+
+            fprintf(csv,
+                    "%" PRIu32 ",%" PRIu64 ",%" PRIu64 ",%.0f,%.0f,%.0f,%.0f,"
+                    "%.0f,%.0f,%.0f,%.0f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                    ring->period, s->time, s->samples,
+                    s->rx_bps, s->rx_fps, s->rx_fps_min, s->rx_fps_max,
+                    s->tx_bps, s->tx_fps, s->tx_fps_min, s->tx_fps_max,
+                    s->errors, s->drops, s->freezes);
+
+        }
+
+    }
+
+    if (fclose(csv) != 0) {
+        perror("Error closing history CSV file");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+int32_t hist_init(struct etherate *eth) {
+
+    struct stat_opt *stat_opt = &eth->stat_opt;
+    const uint32_t  lens[HIST_RES_NR]    = { HIST_SEC_NR, HIST_MIN_NR, HIST_HOUR_NR };
+    const uint32_t  periods[HIST_RES_NR] = { 1, 60, 3600 };
+
+    stat_opt->hist_sz = sizeof(struct hist_hdr) +
+                        (sizeof(struct hist_sample) *
+                         (HIST_SEC_NR + HIST_MIN_NR + HIST_HOUR_NR));
+
+    if (snprintf(stat_opt->hist_csv, sizeof(stat_opt->hist_csv), "%s.csv",
+                 stat_opt->hist_path) >= (int)sizeof(stat_opt->hist_csv)) {
+        printf("Oops! History file path is too long: %s\n", stat_opt->hist_path);
+        return EXIT_FAILURE;
+    }
+
+
+    // If a previous run crashed its history is still in the file, save it
+    // before the file is reused
+    int32_t fd = open(stat_opt->hist_path, O_RDONLY);
+    if (fd != -1) {
+
+        struct hist_hdr *prev = mmap(NULL, stat_opt->hist_sz, PROT_READ,
+                                     MAP_SHARED, fd, 0);
+
+        if (prev != MAP_FAILED) {
+
+            struct stat st;
+            if (fstat(fd, &st) == 0 && (size_t)st.st_size == stat_opt->hist_sz &&
+                prev->magic == HIST_MAGIC && prev->version == HIST_VERSION &&
+                prev->sample_sz == sizeof(struct hist_sample) &&
+                prev->ring_nr == HIST_RES_NR) {
+
+                char prev_csv[sizeof(stat_opt->hist_csv) + 5];
+                snprintf(prev_csv, sizeof(prev_csv), "%s.prev.csv", stat_opt->hist_path);
+
+                if (hist_dump(prev, prev_csv) == EXIT_SUCCESS)
+                    printf("Recovered previous rate history to %s\n", prev_csv);
+
+            }
+
+            munmap(prev, stat_opt->hist_sz);
+
+        }
+
+        close(fd);
+
+    }
+
+
+    fd = open(stat_opt->hist_path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("Can't create history file");
+        return EXIT_FAILURE;
+    }
+
+    if (ftruncate(fd, (off_t)stat_opt->hist_sz) == -1) {
+        perror("Can't size history file");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    stat_opt->hist = mmap(NULL, stat_opt->hist_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0);
+
+    if (close(fd) != 0)
+        perror("Can't close history file");
+
+    if (stat_opt->hist == MAP_FAILED) {
+        perror("Can't mmap history file");
+        stat_opt->hist = NULL;
+        return EXIT_FAILURE;
+    }
+
+    // ftruncate() zero fills so only the fixed fields need setting
+    stat_opt->hist->magic     = HIST_MAGIC;
+    stat_opt->hist->version   = HIST_VERSION;
+    stat_opt->hist->sample_sz = sizeof(struct hist_sample);
+    stat_opt->hist->ring_nr   = HIST_RES_NR;
+
+    for (uint8_t r = 0; r < HIST_RES_NR; r += 1) {
+        stat_opt->hist->ring[r].period = periods[r];
+        stat_opt->hist->ring[r].len    = lens[r];
+    }
+
+    printf("Keeping rate history in %s\n", stat_opt->hist_path);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+void hist_merge(struct hist_sample *acc, struct hist_sample *sample) {
+
+    if (acc->samples == 0) {
+        *acc = *sample;
+        return;
+    }
+
+    double n_acc = (double)acc->samples;
+    double n_smp = (double)sample->samples;
+    double n     = n_acc + n_smp;
+
+    acc->rx_bps = ((acc->rx_bps * n_acc) + (sample->rx_bps * n_smp)) / n;
+    acc->rx_fps = ((acc->rx_fps * n_acc) + (sample->rx_fps * n_smp)) / n;
+    acc->tx_bps = ((acc->tx_bps * n_acc) + (sample->tx_bps * n_smp)) / n;
+    acc->tx_fps = ((acc->tx_fps * n_acc) + (sample->tx_fps * n_smp)) / n;
+
+    if (sample->rx_fps_max > acc->rx_fps_max) acc->rx_fps_max = sample->rx_fps_max;
+    if (sample->rx_fps_min < acc->rx_fps_min) acc->rx_fps_min = sample->rx_fps_min;
+    if (sample->tx_fps_max > acc->tx_fps_max) acc->tx_fps_max = sample->tx_fps_max;
+    if (sample->tx_fps_min < acc->tx_fps_min) acc->tx_fps_min = sample->tx_fps_min;
+
+    acc->errors  += sample->errors;
+    acc->drops   += sample->drops;
+    acc->freezes += sample->freezes;
+    acc->samples += sample->samples;
+    acc->time     = sample->time;
+
+}
+
+
+
+void hist_push(struct hist_hdr *hist, uint8_t r, struct hist_sample *sample) {
+
+    struct hist_ring *ring = &hist->ring[r];
+
+    hist_ring_samples(hist, r)[ring->head % ring->len] = *sample;
+    ring->head += 1;
+
+    if ((uint32_t)r + 1 >= hist->ring_nr)
+        return;
+
+    // Once the next ring's rollup covers its period push it too
+    struct hist_ring *next = &hist->ring[r + 1];
+    hist_merge(&next->acc, sample);
+
+    if (next->acc.samples >= next->period) {
+        struct hist_sample rollup = next->acc;
+        memset(&next->acc, 0, sizeof(next->acc));
+        hist_push(hist, r + 1, &rollup);
+    }
+
+}
+
+
+
+struct hist_sample *hist_ring_samples(struct hist_hdr *hist, uint8_t r) {
+
+    struct hist_sample *samples = (struct hist_sample*)(hist + 1);
+
+    for (uint8_t i = 0; i < r; i += 1)
+        samples += hist->ring[i].len;
+
+    return samples;
+
+}
\ No newline at end of file
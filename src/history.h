@@ -0,0 +1,101 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+/*
+ * Fixed size multi-resolution history of the aggregate rates, so that
+ * long soak tests keep a full rate history in bounded memory. The file is
+ * a struct hist_hdr followed by the samples of each ring in turn, ring 0
+ * holds 1 second samples, each following ring holds rollups of the ring
+ * before it.
+ */
+
+#define HIST_MAGIC   0x45544849  // "ETHI"
+#define HIST_VERSION 1
+#define HIST_RES_NR  3
+
+#define HIST_SEC_NR  3600        // 1 second samples for the last hour
+#define HIST_MIN_NR  10080       // 1 minute rollups for the last week
+#define HIST_HOUR_NR 8760        // 1 hour rollups for the last year
+
+struct hist_sample {
+    uint64_t time;               // Unix time at the end of the sample period
+    uint64_t samples;            // Number of 1 second intervals rolled up
+    double   rx_bps;             // Mean rates over the sample period
+    double   rx_fps;
+    double   rx_fps_max;
+    double   rx_fps_min;
+    double   tx_bps;
+    double   tx_fps;
+    double   tx_fps_max;
+    double   tx_fps_min;
+    uint64_t errors;             // Totals over the sample period
+    uint64_t drops;
+    uint64_t freezes;
+};
+
+struct hist_ring {
+    uint32_t period;             // Seconds per sample
+    uint32_t len;                // Number of samples in the ring
+    uint64_t head;               // Total samples ever written to the ring
+    struct   hist_sample acc;    // Rollup in progress for this ring
+};
+
+struct hist_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sample_sz;          // sizeof(struct hist_sample)
+    uint32_t ring_nr;            // HIST_RES_NR
+    struct   hist_ring ring[HIST_RES_NR];
+};
+
+// Add the aggregate rates of the last stats interval to the history
+void hist_add(struct etherate *eth, uint64_t rx_bytes, uint64_t rx_frms,
+              uint64_t tx_bytes, uint64_t tx_frms, uint64_t errors,
+              uint64_t drops, uint64_t freezes);
+
+// Unmap the history file after dumping it
+void hist_close(struct etherate *eth);
+
+// Write every sample in the history as CSV, oldest and coarsest first
+int32_t hist_dump(struct hist_hdr *hist, const char *path);
+
+// Create and map the history file, recovering a previous run's history
+int32_t hist_init(struct etherate *eth);
+
+// Merge sample into a rollup
+void hist_merge(struct hist_sample *acc, struct hist_sample *sample);
+
+// Write sample into ring r and roll it up into the next ring
+void hist_push(struct hist_hdr *hist, uint8_t r, struct hist_sample *sample);
+
+// Return a pointer to the samples of ring r
+struct hist_sample *hist_ring_samples(struct hist_hdr *hist, uint8_t r);
+
+#endif // _HISTORY_H_
\ No newline at end of file
@@ -0,0 +1,447 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "latency.h"
+
+static uint64_t lat_bg_frms(struct etherate *eth) {
+
+    uint64_t frms = 0;
+
+    // Worker 0 sends the probes
+    for (uint16_t thread = 1; thread < eth->app_opt.tx_nr; thread += 1)
+        frms += eth->thd_opt[thread].tx_frms;
+
+    return frms;
+
+}
+
+
+
+static inline uint32_t lat_bkt(uint64_t ns) {
+
+    if (ns < (1 << LAT_BKT_BITS))
+        return ns;
+
+    uint32_t exp = 63 - __builtin_clzll(ns);
+
+    if (exp > LAT_BKT_EXP)
+        return LAT_BKT_NR - 1;
+
+    // The power of two, then the next LAT_BKT_BITS bits below the top bit
+    return ((exp - LAT_BKT_BITS + 1) << LAT_BKT_BITS) |
+           ((ns >> (exp - LAT_BKT_BITS)) & ((1 << LAT_BKT_BITS) - 1));
+
+}
+
+
+
+static uint64_t lat_bkt_ns(uint32_t bkt) {
+
+    uint32_t grp = bkt >> LAT_BKT_BITS;
+
+    if (grp == 0)
+        return bkt;
+
+    uint32_t shift = grp - 1;
+    uint64_t low = ((1ULL << LAT_BKT_BITS) + (bkt & ((1 << LAT_BKT_BITS) - 1))) << shift;
+
+    return low + ((1ULL << shift) / 2);
+
+}
+
+
+
+static int32_t lat_init(struct etherate *eth) {
+
+    uint16_t rx_nr = eth->app_opt.thd_nr - eth->app_opt.tx_nr;
+
+    // 100% is -t if set, otherwise the line rate of the Tx interfaces
+    eth->app_opt.lat_ref = eth->app_opt.tx_rate;
+    if (eth->app_opt.lat_ref == 0)
+        eth->app_opt.lat_ref = rfc2544_line(eth, eth->frm_opt.frame_sz + ETH_FCS_LEN);
+
+    if (eth->app_opt.lat_ref == 0) {
+        printf("Oops! The interface speed is unknown, set the 100%% background load "
+               "in frames per second with -t.\n");
+        return EX_SOFTWARE;
+    }
+
+    // The workers' rates are set by lat_thd_setup() and lat_run(), and -d
+    // is the duration of each step instead of the whole test
+    eth->app_opt.lat_step_ms = (eth->app_opt.dur_lim ? eth->app_opt.dur_lim * 1000 : LAT_STEP_MS);
+    eth->app_opt.lat_step    = LAT_SKIP;
+    eth->app_opt.dur_lim     = 0;
+    eth->app_opt.tx_rate     = 0;
+
+    eth->app_opt.lat_hists = calloc(rx_nr * LAT_STEP_NR, sizeof(struct lat_hist));
+    eth->app_opt.lat_res   = calloc(LAT_STEP_NR, sizeof(struct lat_res));
+
+    if (eth->app_opt.lat_hists == NULL || eth->app_opt.lat_res == NULL) {
+        perror("Can't allocate latency histograms");
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t hist = 0; hist < rx_nr * LAT_STEP_NR; hist += 1)
+        eth->app_opt.lat_hists[hist].min = UINT64_MAX;
+
+    printf("Probing at %" PRIu64 " fps on flow 0x%08" PRIx32 ", the background load "
+           "steps from 10%% to 100%% of %" PRIu64 " fps, %.1f seconds per step.\n",
+           eth->app_opt.lat_rate, (uint32_t)LAT_MAGIC << 16, eth->app_opt.lat_ref,
+           eth->app_opt.lat_step_ms / 1000.0);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static uint64_t lat_pct(struct lat_hist *hist, double pct) {
+
+    uint64_t want = (uint64_t)ceil(hist->frms * pct / 100);
+    uint64_t seen = 0;
+
+    for (uint32_t bkt = 0; bkt < LAT_BKT_NR; bkt += 1) {
+
+        seen += hist->bkt[bkt];
+
+        if (seen >= want && seen) {
+            uint64_t ns = lat_bkt_ns(bkt);
+            // The exact lowest and highest values are known
+            if (ns < hist->min) return hist->min;
+            if (ns > hist->max) return hist->max;
+            return ns;
+        }
+
+    }
+
+    return hist->max;
+
+}
+
+
+
+static void lat_print(struct etherate *eth) {
+
+    uint16_t rx_nr = eth->app_opt.thd_nr - eth->app_opt.tx_nr;
+
+    printf("\nLatency under load, %" PRIu64 " probes per second:\n", eth->app_opt.lat_rate);
+    printf("%5s %9s %10s %10s %7s %6s %9s %9s %9s %9s %9s %9s\n",
+           "Load", "Bg Mfps", "Probes Tx", "Probes Rx", "Loss %", "Reord",
+           "Min us", "p50 us", "p90 us", "p99 us", "p99.9 us", "Max us");
+
+    struct lat_hist *sum = calloc(1, sizeof(struct lat_hist));
+    if (sum == NULL) {
+        perror("Can't allocate latency histogram");
+        return;
+    }
+
+    for (uint32_t step = 0; step < LAT_STEP_NR; step += 1) {
+
+        struct lat_res *res = &eth->app_opt.lat_res[step];
+
+        // Steps after an interruption didn't run
+        if (res->bg_ns == 0)
+            break;
+
+        // Merge the step's histograms of all the Rx workers
+        memset(sum, 0, sizeof(struct lat_hist));
+        sum->min = UINT64_MAX;
+
+        for (uint16_t rx_idx = 0; rx_idx < rx_nr; rx_idx += 1) {
+
+            struct lat_hist *hist = &eth->app_opt.lat_hists[rx_idx * LAT_STEP_NR + step];
+
+            for (uint32_t bkt = 0; bkt < LAT_BKT_NR; bkt += 1)
+                sum->bkt[bkt] += hist->bkt[bkt];
+
+            sum->frms  += hist->frms;
+            sum->reord += hist->reord;
+            if (hist->frms && hist->min < sum->min) sum->min = hist->min;
+            if (hist->frms && hist->max > sum->max) sum->max = hist->max;
+
+        }
+
+        double loss = (res->sent > sum->frms ?
+                       (double)(res->sent - sum->frms) * 100 / res->sent : 0);
+
+        printf("%4" PRIu32 "%% %9.3f %10" PRIu64 " %10" PRIu64 " %7.3f %6" PRIu64 " ",
+               (step + 1) * 100 / LAT_STEP_NR,
+               (double)res->bg_frms * 1000 / res->bg_ns, res->sent, sum->frms, loss, sum->reord);
+
+        if (sum->frms == 0) {
+            printf("%9s %9s %9s %9s %9s %9s\n", "-", "-", "-", "-", "-", "-");
+            continue;
+        }
+
+        printf("%9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+               sum->min / 1000.0, lat_pct(sum, 50) / 1000.0, lat_pct(sum, 90) / 1000.0,
+               lat_pct(sum, 99) / 1000.0, lat_pct(sum, 99.9) / 1000.0, sum->max / 1000.0);
+
+    }
+
+    free(sum);
+
+}
+
+
+
+static void lat_run(struct etherate *eth) {
+
+    uint64_t settle_ns = LAT_SETTLE_MS * 1000000ULL;
+    uint64_t step_ns = eth->app_opt.lat_step_ms * 1000000ULL;
+
+    for (uint32_t step = 0; step < LAT_STEP_NR; step += 1) {
+
+        struct lat_res *res = &eth->app_opt.lat_res[step];
+
+        res->rate = eth->app_opt.lat_ref * (step + 1) / LAT_STEP_NR;
+
+        printf("Background load %" PRIu32 "%% (%" PRIu64 " fps).\n",
+               (step + 1) * 100 / LAT_STEP_NR, res->rate);
+
+        // Don't count the probes queued behind the last load
+        __atomic_store_n(&eth->app_opt.lat_step, LAT_SKIP, __ATOMIC_RELAXED);
+        pace_set(&eth->thd_opt[1], eth->app_opt.tx_nr - 1, res->rate);
+
+        if (lat_wait(eth, get_time_ns() + settle_ns) != EXIT_SUCCESS)
+            break;
+
+        uint64_t bg_frms = lat_bg_frms(eth);
+        uint64_t start = get_time_ns();
+
+        __atomic_store_n(&eth->app_opt.lat_step, step, __ATOMIC_RELAXED);
+
+        int32_t ret = lat_wait(eth, start + step_ns);
+
+        res->bg_frms = lat_bg_frms(eth) - bg_frms;
+        res->bg_ns   = get_time_ns() - start;
+
+        if (ret != EXIT_SUCCESS)
+            break;
+
+    }
+
+    __atomic_store_n(&eth->app_opt.lat_step, LAT_SKIP, __ATOMIC_RELAXED);
+
+    thd_stop_workers(eth);
+
+}
+
+
+
+static inline void lat_rx(struct thd_opt *thd_opt, const uint8_t *frame, uint32_t len,
+                          uint64_t rx_ns) {
+
+    uint32_t flow_id;
+    uint32_t step;
+    uint64_t seq;
+    uint64_t tx_ns;
+
+    if (len < LAT_HDR_LEN)
+        return;
+
+    memcpy(&flow_id, frame + FLOW_ID_OFF, sizeof(flow_id));
+    if ((ntohl(flow_id) >> 16) != LAT_MAGIC)
+        return;
+
+    memcpy(&step, frame + LAT_STEP_OFF, sizeof(step));
+    if (step >= LAT_STEP_NR)
+        return;
+
+    memcpy(&seq, frame + LAT_SEQ_OFF, sizeof(seq));
+    memcpy(&tx_ns, frame + LAT_TS_OFF, sizeof(tx_ns));
+
+    if (rx_ns == 0)
+        rx_ns = lat_time_ns();
+
+    struct   lat_hist *hist = &thd_opt->lat_rx[step];
+    uint64_t ns = (rx_ns > tx_ns ? rx_ns - tx_ns : 0);
+
+    if (seq < thd_opt->lat_seq)
+        hist->reord += 1;
+    else
+        thd_opt->lat_seq = seq;
+
+    hist->bkt[lat_bkt(ns)] += 1;
+    hist->frms += 1;
+    if (ns < hist->min) hist->min = ns;
+    if (ns > hist->max) hist->max = ns;
+
+}
+
+
+
+static int32_t lat_setup(struct etherate *eth) {
+
+    if (eth->app_opt.sk_mode != SKT_TX || eth->app_opt.mesh || eth->app_opt.xdp ||
+        eth->app_opt.memif_path != NULL || eth->app_opt.bench_path != NULL ||
+        eth->app_opt.rfc2544_loss >= 0) {
+        printf("Oops! --latency runs its own Tx and Rx workers, it can't be used with\n"
+               "-r, -rt, -R, --bench, --memif, --mesh, --rfc2544 or --xdp.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.frm_lim || eth->app_opt.byte_lim) {
+        printf("Oops! --latency can't be used with -n or -N, -d sets the duration of "
+               "each step.\n");
+        return EX_SOFTWARE;
+    }
+
+    // The probe worker always uses send(), worker 0 can't be tried with -p auto
+    if (eth->app_opt.sk_type == SKT_XDP_LIVE || eth->app_opt.sk_type == SKT_DPDK ||
+        eth->app_opt.sk_type == SKT_TAP || eth->app_opt.sk_type == SKT_AUTO) {
+        printf("Oops! --latency can't be used with -p5, -p6, -p7 or -p auto.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->frm_opt.frame_sz < LAT_HDR_LEN) {
+        printf("Oops! --latency needs frames of at least %zu bytes.\n", LAT_HDR_LEN);
+        return EX_SOFTWARE;
+    }
+
+    // The frames go from one interface to the next, as with --rfc2544
+    if (!eth->frm_opt.custom_frame && get_if_macs(eth) != EXIT_SUCCESS)
+        return EX_SOFTWARE;
+
+    // The probe worker and at least one background worker per interface
+    if (eth->app_opt.thd_nr < eth->sk_opt.if_nr + 1) {
+        eth->app_opt.thd_nr = eth->sk_opt.if_nr + 1;
+        printf("Using %" PRIu16 " worker threads, one for the probes and one per "
+               "interface for the background load.\n", eth->app_opt.thd_nr);
+    }
+
+    eth->app_opt.sk_mode = SKT_BIDI;
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static void lat_thd_setup(struct etherate *eth, uint16_t thread) {
+
+    struct thd_opt *thd_opt = &eth->thd_opt[thread];
+
+    if (thread == 0) {
+        thd_opt->flow_id  = (uint32_t)LAT_MAGIC << 16;
+        thd_opt->lat_res  = eth->app_opt.lat_res;
+        thd_opt->lat_step = &eth->app_opt.lat_step;
+        thd_opt->sk_type  = SKT_PACKET;
+        thd_opt->tx_rate  = eth->app_opt.lat_rate;
+    } else if (thread < eth->app_opt.tx_nr) {
+        // Idle until lat_run() sets the first step
+        thd_opt->tx_rate  = PACE_IDLE;
+    } else {
+        thd_opt->lat_rx   = &eth->app_opt.lat_hists[(thread - eth->app_opt.tx_nr) * LAT_STEP_NR];
+    }
+
+    if (thread < eth->app_opt.tx_nr && !eth->frm_opt.custom_frame)
+        rfc2544_addr(eth, thread);
+
+}
+
+
+
+static inline uint64_t lat_time_ns(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+
+}
+
+
+
+static void lat_tx(struct thd_opt *thd_opt) {
+
+    uint32_t flow_id = htonl(thd_opt->flow_id);
+    uint64_t seq = 0;
+    int32_t  tx_bytes;
+
+    memcpy(thd_opt->tx_buffer + FLOW_ID_OFF, &flow_id, sizeof(flow_id));
+
+    thd_opt->started = 1;
+
+    while(!thd_stopping(thd_opt)) {
+
+        if (pace_tx(thd_opt, 1) == 0)
+            continue;
+
+        // Stamp the probe just before it is sent
+        uint32_t step = __atomic_load_n(thd_opt->lat_step, __ATOMIC_RELAXED);
+        uint64_t tx_ns = lat_time_ns();
+
+        memcpy(thd_opt->tx_buffer + LAT_STEP_OFF, &step, sizeof(step));
+        memcpy(thd_opt->tx_buffer + LAT_SEQ_OFF, &seq, sizeof(seq));
+        memcpy(thd_opt->tx_buffer + LAT_TS_OFF, &tx_ns, sizeof(tx_ns));
+
+        tx_bytes = send(thd_opt->sock, thd_opt->tx_buffer, thd_opt->frame_sz, 0);
+
+        if (tx_bytes == -1) {
+            if (errno != EAGAIN && errno != EINTR)
+                thd_opt->sk_err += 1;
+        } else {
+            thd_opt->tx_bytes += tx_bytes;
+            thd_opt->tx_frms += 1;
+            seq += 1;
+            if (step != LAT_SKIP)
+                thd_opt->lat_res[step].sent += 1;
+        }
+
+    }
+
+}
+
+
+
+static int32_t lat_wait(struct etherate *eth, uint64_t until) {
+
+    const struct timespec interval = {
+        .tv_sec  = 0,
+        .tv_nsec = DEF_MON_INTERVAL * 1000000L
+    };
+
+    while (get_time_ns() < until) {
+
+        if (eth->app_opt.stop)
+            return EXIT_FAILURE;
+
+        for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+            if (eth->thd_opt[thread].quit) {
+                printf("Oops! A worker thread stopped during the latency test.\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        nanosleep(&interval, NULL);
+
+    }
+
+    return EXIT_SUCCESS;
+
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+/*
+ * Latency under load (--latency <probe fps>). The workers run in bidi mode
+ * like --rfc2544. Tx worker 0 sends a low rate probe stream with send(),
+ * each probe carrying the probe flow ID, the load step, a sequence number
+ * and the time it was sent. The other Tx workers send the background load
+ * with the chosen -p method, which steps from 10% to 100% of the -t rate
+ * (or of line rate without -t). After each step change the probes are
+ * ignored for LAT_SETTLE_MS, then for -d seconds the Rx workers add each
+ * probe's latency to a histogram of that step.
+ *
+ * The latency is measured on this host's CLOCK_REALTIME, from just before
+ * send() to the Kernel Rx timestamp for the PACKET_MMAP methods or to when
+ * the frame is read for the others. Each histogram bucket is at most 1/32
+ * of its value wide, so the percentiles are within about 3%.
+ */
+
+#define LAT_BKT_BITS   5        // log2 of the buckets per power of two
+#define LAT_BKT_EXP    40       // Latencies from 2^40 ns (about 18 minutes) go in the last bucket
+#define LAT_BKT_NR     ((LAT_BKT_EXP - LAT_BKT_BITS + 2) << LAT_BKT_BITS)
+#define LAT_HDR_LEN    (LAT_TS_OFF + sizeof(uint64_t)) // Smallest probe frame
+#define LAT_MAGIC      0x4c54   // "LT", the top 16 bits of the probe flow ID
+#define LAT_SEQ_OFF    (LAT_STEP_OFF + sizeof(uint32_t))
+#define LAT_SETTLE_MS  1000     // Probes ignored after each load change
+#define LAT_SKIP       UINT32_MAX // Step value of probes which are not counted
+#define LAT_STEP_MS    10000    // Measured part of each step, -d overrides it
+#define LAT_STEP_NR    10       // Steps of 10% load
+#define LAT_STEP_OFF   (FLOW_ID_OFF + sizeof(uint32_t))
+#define LAT_TS_OFF     (LAT_SEQ_OFF + sizeof(uint64_t))
+
+// Probe latencies of one load step received by one Rx worker
+struct lat_hist {
+    uint64_t bkt[LAT_BKT_NR];
+    uint64_t frms;
+    uint64_t max;
+    uint64_t min;
+    uint64_t reord;            // Probes with a lower sequence number than the last one
+};
+
+// Per load step results
+struct lat_res {
+    uint64_t bg_frms;          // Background frames sent during the measured part
+    uint64_t bg_ns;
+    uint64_t rate;             // Background rate asked for
+    uint64_t sent;             // Probes sent, written by the probe worker
+};
+
+// Return the background frames sent so far
+static uint64_t lat_bg_frms(struct etherate *eth);
+
+// Return the histogram bucket of a latency in ns
+static inline uint32_t lat_bkt(uint64_t ns);
+
+// Return the latency in ns in the middle of a bucket
+static uint64_t lat_bkt_ns(uint32_t bkt);
+
+// Set the background rate, allocate the histograms and switch off -d and -t
+static int32_t lat_init(struct etherate *eth);
+
+// Return the latency in ns below which pct percent of the probes are
+static uint64_t lat_pct(struct lat_hist *hist, double pct);
+
+// Print the latency percentiles of each load step
+static void lat_print(struct etherate *eth);
+
+// Step the background load, then stop the workers
+static void lat_run(struct etherate *eth);
+
+// Add a received probe to the histogram of its step, rx_ns 0 to read the clock
+static inline void lat_rx(struct thd_opt *thd_opt, const uint8_t *frame, uint32_t len,
+                          uint64_t rx_ns);
+
+// Check the options can be used for the test and switch to bidi mode
+static int32_t lat_setup(struct etherate *eth);
+
+// Set the probe, background or Rx role of a worker
+static void lat_thd_setup(struct etherate *eth, uint16_t thread);
+
+// Return CLOCK_REALTIME in nanoseconds, the clock of the Kernel Rx timestamps
+static inline uint64_t lat_time_ns(void);
+
+// Send the probe stream
+static void lat_tx(struct thd_opt *thd_opt);
+
+// Sleep until a time in ns, EXIT_FAILURE if interrupted or a worker failed first
+static int32_t lat_wait(struct etherate *eth, uint64_t until);
+
+#endif // _LATENCY_H_
\ No newline at end of file
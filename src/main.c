@@ -26,14 +26,35 @@
 
 
 #include "main.h"
+#include "affinity.h"
+#include "history.h"
+#include "latency.h"
+#include "memif.h"
+#include "mesh.h"
+#include "pace.h"
+#include "print_stats.h"
+#include "probe.h"
+#include "profile.h"
+#include "rfc2544.h"
+#include "bench.h"             // After probe.h for struct probe_res
+#include "shm_stats.h"
 #include "threads.h"
 
+// etherate_cleanup() releases the DPDK ports and EAL
+#ifdef ETHERATE_DPDK
+#include "dpdk.h"
+#else
+#include "dpdk_bypass.h"
+#endif
+
 #include "functions.c"
 #include "sock_op.c"
 
+#include "memif.c"
 #include "packet.c"
 #include "packet_msg.c"
 #include "packet_mmsg.c"
+#include "tap.c"
 
 // Only inlcude these files if the required Kernel version is detected,
 // otherwise the code won't compile:
@@ -45,11 +66,36 @@
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,2,0)
 #include "tpacket_v3.c"
+#include "reflect.c"
 #else
 #include "tpacket_v3_bypass.c"
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,18,0)
+#include "xdp.c"
+#else
+#include "xdp_bypass.c"
+#endif
+
+// Only built with DPDK when asked to, see INSTALL
+#ifdef ETHERATE_DPDK
+#include "dpdk.c"
+#else
+#include "dpdk_bypass.c"
+#endif
+
+#include "history.c"
+#include "shm_stats.c"
 #include "print_stats.c"
+#include "metrics.c"
+#include "mesh.c"
+#include "latency.c"
+#include "pace.c"
+#include "profile.c"
+#include "affinity.c"
+#include "bench.c"
+#include "probe.c"
+#include "rfc2544.c"
 #include "threads.c"
 
 
@@ -69,9 +115,12 @@ int main(int argc, char *argv[]) {
     // Global pointer to eth object used by signal_handler()
     eth_p = &eth;
 
-    // Declare sigint handler to cancel the worker and stats threads
+    // Declare sigint handler to stop the worker threads
     signal (SIGINT, signal_handler);
 
+    // Declare SIGUSR1 handler to dump the rate history
+    signal (SIGUSR1, signal_dump);
+
     // Set application defaults    
     etherate_setup(&eth);
 
@@ -87,25 +136,169 @@ int main(int argc, char *argv[]) {
         return EXIT_SUCCESS;
     }
 
+    // The DPDK ports are found by the EAL instead of -i/-I
+    if (eth.app_opt.sk_type == SKT_DPDK) {
+        int32_t dpdk_ret = dpdk_eal_init(&eth);
+        if (dpdk_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return dpdk_ret;
+        }
+    }
+
+    // The frames go through a shared memory region instead of an interface
+    if (eth.app_opt.memif_path != NULL) {
+        int32_t memif_ret = memif_setup(&eth);
+        if (memif_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return memif_ret;
+        }
+    }
+
     // Ensure an interface has been chosen
-    if (eth.sk_opt.if_index == -1) {
+    if (eth.sk_opt.if_nr == 0) {
         printf("Oops! No interface chosen.\n");
         return EX_SOFTWARE;
     }
 
+    // One worker per interface which only attaches the XDP program
+    if (eth.app_opt.xdp) {
+        int32_t xdp_ret = xdp_setup(&eth);
+        if (xdp_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return xdp_ret;
+        }
+    }
+
+    // One Tx worker per pair of interfaces, -c is then the Rx workers per interface
+    if (eth.app_opt.mesh) {
+        int32_t mesh_ret = mesh_init(&eth);
+        if (mesh_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return mesh_ret;
+        }
+    }
+
+    // The throughput test runs its own Tx and Rx workers in bidi mode
+    if (eth.app_opt.rfc2544_loss >= 0) {
+        int32_t rfc2544_ret = rfc2544_setup(&eth);
+        if (rfc2544_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return rfc2544_ret;
+        }
+    }
+
+    // So does the latency test, with one extra Tx worker for the probes
+    if (eth.app_opt.lat_rate) {
+        int32_t lat_ret = lat_setup(&eth);
+        if (lat_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return lat_ret;
+        }
+    }
+
+    // Every interface needs at least one worker
+    if (eth.app_opt.thd_nr < eth.sk_opt.if_nr) {
+        eth.app_opt.thd_nr = eth.sk_opt.if_nr;
+        printf("Using %" PRIu16 " worker threads, one per interface.\n", eth.app_opt.thd_nr);
+    }
+
+    // Each bidi worker is a pair of Tx and Rx workers, the Tx workers first
+    if (eth.app_opt.sk_mode == SKT_BIDI && !eth.app_opt.mesh) {
+        eth.app_opt.tx_nr = eth.app_opt.thd_nr;
+        eth.app_opt.thd_nr *= 2;
+        printf("Using %" PRIu16 " Tx and %" PRIu16 " Rx worker threads.\n",
+               eth.app_opt.tx_nr, eth.app_opt.tx_nr);
+    }
+
+    for (uint16_t thread = 0; thread < eth.app_opt.thd_nr; thread += 1) {
+        struct if_opt *if_opt = &eth.sk_opt.if_opt[thd_if_idx(&eth, thread)];
+        if_opt->thd_nr += 1;
+        if (eth.app_opt.tx_nr ? thread >= eth.app_opt.tx_nr
+                              : eth.app_opt.sk_mode != SKT_TX)
+            if_opt->rx_nr += 1;
+    }
+
+    // Worker N serves queue N of the one interface, in one direction
+    if (eth.app_opt.q_map != QMAP_OFF && eth.sk_opt.if_nr > 1) {
+        printf("Oops! -Q can only be used with a single interface.\n");
+        etherate_cleanup(&eth);
+        return EX_SOFTWARE;
+    }
+    if (eth.app_opt.q_map != QMAP_OFF && eth.app_opt.sk_mode == SKT_BIDI) {
+        printf("Oops! -Q can't be used in bidirectional mode.\n");
+        etherate_cleanup(&eth);
+        return EX_SOFTWARE;
+    }
+
+    // Live frames mode has no way to receive
+    if (eth.app_opt.sk_type == SKT_XDP_LIVE && eth.app_opt.sk_mode != SKT_TX) {
+        printf("Oops! -p5 can only be used in Tx mode.\n");
+        etherate_cleanup(&eth);
+        return EX_SOFTWARE;
+    }
+
+    // The benchmark sweeps the engines and frame sizes itself
+    if (eth.app_opt.bench_path != NULL) {
+        int32_t bench_ret = bench_setup(&eth);
+        if (bench_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return bench_ret;
+        }
+    }
+
+    // Microbursts are sent by the pacer of each Tx worker
+    if (eth.app_opt.burst_nr) {
+        int32_t burst_ret = pace_burst_init(&eth);
+        if (burst_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return burst_ret;
+        }
+    }
+
+    // The monitor moves the Tx rate along the profile
+    if (eth.app_opt.prof_spec != NULL) {
+        int32_t prof_ret = prof_setup(&eth);
+        if (prof_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return prof_ret;
+        }
+    }
+
     if (eth.app_opt.verbose) printf("Verbose output enabled.\n");
 
+    // Load the program that steers frames between the fanout sockets
+    if (eth.app_opt.fanout_type == PACKET_FANOUT_EBPF &&
+        fanout_prog_load(&eth) != EXIT_SUCCESS) {
+        etherate_cleanup(&eth);
+        return EXIT_FAILURE;
+    }
 
-    // Put the chosen interface into promisc mode
-    int32_t promisc_ret = set_int_promisc(&eth);
-    if (promisc_ret != EXIT_SUCCESS)
-        return promisc_ret;
+
+    // Put the chosen interfaces into promisc mode, DPDK does its own ports
+    // and memif has none
+    if (eth.app_opt.sk_type != SKT_DPDK && eth.app_opt.sk_type != SKT_MEMIF) {
+        int32_t promisc_ret = set_int_promisc(&eth);
+        if (promisc_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return promisc_ret;
+        }
+    }
 
 
     printf("Frame size set to %" PRIu16 " bytes.\n", eth.frm_opt.frame_sz);
 
 
-    if (eth.app_opt.sk_type == SKT_PACKET_MMAP2) {
+    // The XDP program replaces the sockets, the reflector always receives
+    // on a v3 ring and sends from a v2 ring
+    if (eth.app_opt.bench_path != NULL) {
+        printf("Benchmarking the send/receive methods.\n");
+    } else if (eth.app_opt.xdp) {
+        eth.app_opt.sk_type = SKT_PACKET;
+        printf("Using an XDP program with per-CPU counters.\n");
+    } else if (eth.app_opt.sk_mode == SKT_REFLECT) {
+        eth.app_opt.sk_type = SKT_PACKET_MMAP3;
+        printf("Using raw sockets with PACKET_MMAP RX_RING v3 and TX_RING v2.\n");
+    } else if (eth.app_opt.sk_type == SKT_PACKET_MMAP2) {
         printf("Using raw socket with PACKET_MMAP and TX/RX_RING v2.\n");
     } else if (eth.app_opt.sk_type == SKT_PACKET) {
         printf("Using raw packet socket with send()/read().\n");
@@ -115,20 +308,43 @@ int main(int argc, char *argv[]) {
         printf("Using raw packet socket with sendmmsg()/recvmmsg().\n");
     } else if (eth.app_opt.sk_type == SKT_PACKET_MMAP3) {
         printf("Using raw socket with PACKET_MMAP and TX/RX_RING v3.\n");
+    } else if (eth.app_opt.sk_type == SKT_XDP_LIVE) {
+        printf("Using XDP live frames mode with BPF_PROG_TEST_RUN.\n");
+    } else if (eth.app_opt.sk_type == SKT_DPDK) {
+        printf("Using DPDK poll mode drivers with rx_burst()/tx_burst().\n");
+    } else if (eth.app_opt.sk_type == SKT_TAP) {
+        printf("Using TAP queues with vnet headers and readv()/writev().\n");
+    } else if (eth.app_opt.sk_type == SKT_MEMIF) {
+        printf("Using shared memory rings with eventfd doorbells.\n");
     }
 
     if (eth.app_opt.sk_mode == SKT_RX) {
         printf("Running in Rx mode.\n");
     } else if (eth.app_opt.sk_mode == SKT_TX) {
         printf("Running in Tx mode.\n");
+    } else if (eth.app_opt.rfc2544_loss >= 0) {
+        printf("Running the RFC 2544 throughput test in bidirectional mode.\n");
+    } else if (eth.app_opt.lat_rate) {
+        printf("Running the latency under load test in bidirectional mode.\n");
+    } else if (eth.app_opt.mesh) {
+        printf("Running in full mesh mode.\n");
     } else if (eth.app_opt.sk_mode == SKT_BIDI) {
         printf("Running in bidirectional mode.\n");
+    } else if (eth.app_opt.sk_mode == SKT_REFLECT) {
+        printf("Running in reflector mode.\n");
     }
 
     
     if (eth.app_opt.verbose)
         printf("Main thread pid is %" PRId32 ".\n", getpid());
 
+
+    // Find the CPUs local to the interface for the worker threads
+    if (cpu_place_init(&eth) != EXIT_SUCCESS) {
+        etherate_cleanup(&eth);
+        return EXIT_FAILURE;
+    }
+
     
     // Fill the test frame buffer with random data
     if (getrandom(eth.frm_opt.tx_buffer, eth.frm_opt.frame_sz, 0)
@@ -139,21 +355,106 @@ int main(int argc, char *argv[]) {
     }
 
 
+    // Create the shared memory rings (Rx) or map the Rx side's rings (Tx)
+    if (eth.app_opt.sk_type == SKT_MEMIF) {
+        int32_t memif_ret = memif_connect(&eth);
+        if (memif_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return memif_ret;
+        }
+    }
+
     // Create a copy of the program settings for each worker thread.
     eth.thd_opt = calloc(sizeof(struct thd_opt), eth.app_opt.thd_nr);
 
     thd_alloc(&eth);
+
+    // Run the benchmark instead of a test
+    if (eth.app_opt.bench_path != NULL) {
+        int32_t bench_ret = bench_run(&eth);
+        etherate_cleanup(&eth);
+        return bench_ret;
+    }
+
+    // Set the background load and allocate the probe latency histograms
+    if (eth.app_opt.lat_rate) {
+        int32_t lat_ret = lat_init(&eth);
+        if (lat_ret != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return lat_ret;
+        }
+    }
+
+    // Try each engine on worker 0 and keep the fastest
+    if (eth.app_opt.sk_type == SKT_AUTO) {
+        if (probe_engine(&eth) != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Set up a mempool and queue pair for each worker and start the ports
+    if (eth.app_opt.sk_type == SKT_DPDK) {
+        if (dpdk_port_init(&eth) != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Run the throughput search instead of a test
+    if (eth.app_opt.rfc2544_loss >= 0) {
+        int32_t rfc2544_ret = rfc2544_run(&eth);
+        etherate_cleanup(&eth);
+        return rfc2544_ret;
+    }
+
+    // Create the rate history file
+    if (eth.stat_opt.hist_path != NULL) {
+        if (hist_init(&eth) != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Create the /dev/shm live stats segment
+    if (eth.stat_opt.shm_name != NULL) {
+        if (shm_stats_init(&eth) != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return EXIT_FAILURE;
+        }
+    }
+
     // Spawn the stats printing thread
     if (thd_init_stats(&eth) != EXIT_SUCCESS)
         return EXIT_FAILURE;
 
+    // Spawn the OpenMetrics exporter thread
+    if (eth.stat_opt.metrics_addr != NULL) {
+        if (metrics_init(&eth) != EXIT_SUCCESS ||
+            thd_init_metrics(&eth) != EXIT_SUCCESS) {
+            etherate_cleanup(&eth);
+            return EXIT_FAILURE;
+        }
+    }
+
     // Spawn each worker thread
     if (thd_spawn_workers(&eth) != EXIT_SUCCESS)
         return EXIT_FAILURE;
 
-    // Wait for worker and stats threads to finish, then clean up
+    // Wait for a stop condition, or step through the background loads, then
+    // wait for the workers to drain
+    if (eth.app_opt.lat_rate)
+        lat_run(&eth);
+    else
+        thd_monitor(&eth);
     thd_join_workers(&eth);
+
+    // Report the final totals, then clean up
     thd_join_stats(&eth);
+    thd_join_metrics(&eth);
+    print_stats_summary(&eth);
+    if (eth.app_opt.lat_rate)
+        lat_print(&eth);
     etherate_cleanup(&eth);
 
 }
\ No newline at end of file
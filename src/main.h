@@ -29,28 +29,45 @@
 #define _ETHERATE_MT_H_
 
 #define _GNU_SOURCE           // Required for pthread_attr_setaffinity_np()
+#include <dirent.h>           // opendir(), readdir()
 #include <errno.h>            // errno
+#include <fcntl.h>            // open(), O_CREAT, O_RDWR
 #include <net/ethernet.h>     // ETH_P_ALL
 #include <net/if.h>           // IF_NAMESIZE, struct ifreq
 #include <linux/if_packet.h>  // struct packet_mreq, sockaddr_ll, tpacket_req, tpacket2_hdr, tpacket3_hdr, tpacket_req3
+#include <linux/bpf.h>        // union bpf_attr, BPF_PROG_LOAD, struct bpf_insn
+#include <linux/filter.h>     // struct sock_filter, struct sock_fprog, SKF_LL_OFF
+#include <linux/if_link.h>    // XDP_FLAGS_DRV_MODE, XDP_FLAGS_SKB_MODE
+#include <linux/if_tun.h>     // IFF_TAP, IFF_MULTI_QUEUE, IFF_VNET_HDR, TUNSETIFF
+#include <linux/virtio_net.h> // struct virtio_net_hdr
 #include <ifaddrs.h>          // freeifaddrs(), getifaddrs()
 #include <arpa/inet.h>        // htons()
 #include <inttypes.h>         // PRIuN
 #include <sys/ioctl.h>        // ioctl()
-#include <math.h>             // floor()
-#include <sys/mman.h>         // mmap()
+#include <math.h>             // ceil(), cos(), floor(), sqrt()
+#include <sys/eventfd.h>      // eventfd()
+#include <sys/mman.h>         // memfd_create(), mmap()
 #include <linux/net_tstamp.h> // struct hwtstamp_config
+#include <linux/perf_event.h> // struct perf_event_attr, PERF_COUNT_HW_CPU_CYCLES
 #include <poll.h>             // poll()
 #include <pthread.h>          // pthread_*()
+#include <sched.h>            // CPU_SET(), cpu_set_t, sched_getaffinity()
 #include <sys/socket.h>       // socket()
+#include <sys/stat.h>         // fstat(), struct stat
 #include <linux/sockios.h>    // SIOCSHWTSTAMP
 #include <signal.h>           // signal()
+#include <stddef.h>           // offsetof()
 #include <stdlib.h>           // calloc(), exit(), EXIT_FAILURE, EXIT_SUCCESS, rand(), RAND_MAX, strtoul()
 #include <stdio.h>            // FILE, fclose(), fopen(), fscanf(), perror(), printf()
 #include <string.h>           // memcpy(), memset(), strncpy()
 #include <sys/random.h>       // getrandom()
+#include <sys/resource.h>     // getrusage()
 #include <sys/syscall.h>      // SYS_gettid
 #include <sys/sysinfo.h>      // get_nprocs()
+#include <time.h>             // time()
+#include <sys/uio.h>          // readv(), writev()
+#include <sys/utsname.h>      // uname()
+#include <sys/un.h>           // struct sockaddr_un
 #include "sysexits.h"         // EX_NOPERM, EX_PROTOCOL, EX_SOFTWARE
 #include <unistd.h>           // getpagesize(), getpid(), getuid(), read(), sleep()
 #include <linux/version.h>    // KERNEL_VERSION(), LINUX_VERSION_CODE
@@ -71,11 +88,25 @@
 #define DEF_FRM_SZ_MAX 10000          // Max frame size with headers
 #define DEF_MSGVEC_LEN 256            // Default msgvec_vlen for sendmmsg()/recvmmsg()
 #define DEF_THD_NR     1              // Default number of worker threads
+#define DEF_IF_MAX     16             // Max number of interfaces given with -i/-I
+#define DEF_POLL_TIMEO 100            // Max ms a worker blocks in a syscall before checking if it should stop
+#define DEF_DRAIN_TIMEO 2000          // Max ms to wait for in-flight Tx ring frames, or read queued Rx frames, when stopping
+#define DEF_MON_INTERVAL 10           // ms between checks of the stop conditions
+#define DEF_SETTLE_TIMEO 500          // ms to keep receiving after all Tx workers finished
+#define DEF_SKEW_WARN  0.5            // Warn when the Rx fanout skew (coefficient of variation) is above this
+#define DEF_SKEW_MIN   1000           // Minimum Rx fps in an interval before warning about skew
+#define FLOW_ID_OFF    14             // Offset of the 32 bit flow ID in each Tx frame, after the Ethernet header
 
 // Flags for socket mode:
 #define SKT_RX    0                   // Run in Rx mode
 #define SKT_TX    1                   // Run in Tx mode
 #define SKT_BIDI  2                   // Run in bidirectional mode (Tx and Rx)
+#define SKT_REFLECT 3                 // Send each received frame back with the MACs swapped
+
+// Flags for NIC queue mapping:
+#define QMAP_OFF  0                   // Don't map workers to NIC queues
+#define QMAP_IRQ  1                   // Pin worker N to the CPU of queue N's IRQ/XPS map
+#define QMAP_SET  2                   // Move queue N's IRQ and XPS map to worker N's CPU
 
 // Flags for socket type:
 #define SKT_PACKET        0           // Use read()/sendto()
@@ -83,22 +114,92 @@
 #define SKT_SENDMSG       2           // Use sendmsg()/recvmsg()
 #define SKT_SENDMMSG      3           // Use sendmmsg()/recvmmsg()
 #define SKT_PACKET_MMAP3  4           // Use PACKET_MMAP v3 Tx/Rx rings
+#define SKT_XDP_LIVE      5           // Use BPF_PROG_TEST_RUN XDP live frames (Tx only)
+#define SKT_DPDK          6           // Use a DPDK poll mode driver (-DETHERATE_DPDK builds)
+#define SKT_TAP           7           // Use a queue of a multi-queue TAP interface
+#define SKT_MEMIF         8           // Use a shared memory ring to another EtherateMT (--memif)
+#define SKT_AUTO          255         // Choose one of the above by probing (-p auto)
 #define DEF_SKT_TYPE      SKT_PACKET  // Default mode
 
+// Flags for stats output format:
+#define STATS_FMT_TEXT    0           // Human readable aggregate stats
+#define STATS_FMT_JSON    1           // One JSON object per interval (JSON Lines)
+#define STATS_FMT_CSV     2           // One CSV row per thread per interval
+
+
+
+// DPDK mempool and Rx/Tx queue pair of a worker (-p6)
+struct dpdk_q {
+    struct   rte_mempool *pool;
+    uint16_t queue;
+};
+
+// Shared memory ring of a worker and its eventfds (--memif)
+struct memif_q {
+    uint8_t  *bufs;            // Buffer of slot 0 of this ring
+    uint32_t buf_sz;
+    int32_t  evt_rx;           // Written by Tx when the Rx side waits
+    int32_t  evt_tx;           // Written by Rx when the Tx side waits
+    struct   memif_ring *ring;
+    uint32_t ring_sz;
+};
+
 
 
 // Application behaviour options:
 struct app_opt {
+    char           *bench_path; // Run the engine benchmark and write the JSON results here
+    uint64_t       byte_lim;   // Stop after this many bytes, 0 for no limit
+    double         burst_duty; // Duty cycle of the --burst bursts at line rate in %, 0 if burst_gap is set
+    uint64_t       burst_gap;  // Idle ns after each --burst burst
+    uint32_t       burst_nr;   // Frames per burst for --burst, 0 for no bursts
+    uint8_t        dpdk_eal;   // The DPDK EAL has been initialised
+    struct dpdk_q  *dpdk_qs;   // Per worker DPDK mempool and queue for -p6
+    uint64_t       dur_lim;    // Stop after this many seconds, 0 for no limit
+    int            eal_argc;   // Args after "--" for the DPDK EAL, with the program name
+    char           **eal_argv;
     uint8_t        err_len;
     char           *err_str;
-    int32_t        fanout_grp; // CPU fanout group for AF_PACKET sockets
+    uint16_t       fanout_flags; // PACKET_FANOUT_FLAG_* to join the fanout group with
+    int32_t        fanout_prog; // eBPF program for PACKET_FANOUT_EBPF or -1
+    uint16_t       fanout_type; // PACKET_FANOUT_* mode chosen with -F
+    cpu_set_t      hk_cpus;    // Housekeeping CPUs for main() and the stats thread, empty if unset
+    uint64_t       frm_lim;    // Stop after this many frames, 0 for no limit
+    struct lat_hist *lat_hists; // Per Rx worker and load step probe latencies for --latency
+    uint64_t       lat_rate;   // Probe frames per second for --latency, 0 if not run
+    uint64_t       lat_ref;    // Background frames per second at 100% load
+    struct lat_res *lat_res;   // Per load step results
+    uint32_t       lat_step;   // Load step stamped into the probes, LAT_SKIP between steps
+    uint32_t       lat_step_ms; // Measured part of each load step
+    void           *memif;     // Mapped shared memory region for --memif
+    char           *memif_path; // Unix socket to exchange the region on
+    struct memif_q *memif_qs;  // Per worker ring and eventfds for --memif
+    uint64_t       memif_sz;   // Size of the mapped region
+    uint8_t        mesh;       // Every interface sends to every other interface
+    struct mesh_ctr *mesh_ctrs; // Per Rx worker counters for mesh mode
+    int32_t        numa_node;  // NUMA node shared by all interfaces or -1 if unknown or mixed
+    struct prof    *prof;      // Parsed --profile, NULL if the Tx rate is flat
+    char           *prof_spec; // Formula or CSV file of the --profile Tx rate
+    uint8_t        q_map;      // Map workers to NIC queues, QMAP_*
+    int32_t        *q_rx_irq;  // IRQ of each Rx queue or -1 if unknown
+    uint16_t       q_rx_nr;    // Number of Rx queues
+    int32_t        *q_tx_irq;  // IRQ of each Tx queue or -1 if unknown
+    uint16_t       q_tx_nr;    // Number of Tx queues
+    double         rfc2544_loss; // Loss % allowed by the --rfc2544 throughput test, negative if not run
     uint8_t        sk_mode;    // Tx/Rx/Bidi
     uint8_t        sk_type;    // PACKET_MMAP, send(), sendmmsg() etc.
+    volatile sig_atomic_t stop; // Set by SIGINT to stop the workers
     pthread_t      *thd;
-    uint8_t        thd_affin;  ///// Add CLI arg, try to avoid split NUMA node?
+    uint8_t        thd_affin;  // Pin each worker thread to a single CPU
     pthread_attr_t *thd_attr;  // pthread_attr_t
+    cpu_set_t      thd_cpus;   // CPUs listed with -x, then the CPUs the worker threads may run on
+    int32_t        *thd_cpu_list; // Worker CPUs for -x in the order they are used
+    uint16_t       thd_cpu_nr; // Number of entries in thd_cpu_list
     uint16_t       thd_nr;     // Number of worker threads to run
+    uint16_t       tx_nr;      // In bidi/mesh mode workers 0 to tx_nr-1 only Tx and the rest only Rx
+    uint64_t       tx_rate;    // Total Tx frames per second over all Tx workers, 0 for no limit
     uint8_t        verbose;    // Verbose debugging toggle
+    uint8_t        xdp;        // Drop (-r) or reflect (-R) frames with an XDP program
 };
 
 // Frame and ring buffer options:
@@ -112,10 +213,25 @@ struct frm_opt {
     uint8_t  *tx_buffer;   // Point to frame copied into ring
 };
 
+// Per-interface options, worker N uses interface N % if_nr:
+struct if_opt {
+    uint64_t  burst_gap;       // Idle ns after each burst of the Tx workers on this interface
+    int32_t   fanout_grp;      // Fanout group for the AF_PACKET sockets on this interface
+    uint16_t  fanout_turn;     // Next worker to join the fanout group with PACKET_FANOUT_QM
+    int32_t   if_index;
+    uint8_t   if_name[IF_NAMESIZE];
+    uint8_t   mac[ETH_ALEN];   // Interface MAC address, the mesh mode destination
+    cpu_set_t node_cpus;       // CPUs of numa_node the workers may use
+    int32_t   numa_node;       // NUMA node of the interface or -1 if unknown
+    uint8_t   promisc;         // Promiscuous mode was set on this interface
+    uint16_t  rx_nr;           // Number of Rx worker threads on this interface
+    uint16_t  thd_nr;          // Number of worker threads on this interface
+};
+
 // Socket specific options:
 struct sk_opt {
-    int32_t  if_index;
-    uint8_t  if_name[IF_NAMESIZE];
+    struct   if_opt if_opt[DEF_IF_MAX];
+    uint16_t if_nr;            // Number of interfaces in if_opt
     uint32_t msgvec_vlen;
 };
 
@@ -126,18 +242,48 @@ struct thd_opt {
     uint32_t block_frm_sz;
     uint32_t block_nr;
     uint32_t block_sz;
+    uint64_t burst_gap;       // Idle ns after each burst
+    uint32_t burst_left;      // Frames left to send in the current burst
+    uint32_t burst_nr;        // Frames per burst, 0 for no bursts (see pace.h)
+    struct   dpdk_q *dpdk_q;  // DPDK mempool and queue of this worker for -p6
     uint8_t  err_len;
     char     *err_str;
+    uint16_t fanout_flags;    // PACKET_FANOUT_FLAG_* to join the fanout group with
     uint32_t fanout_grp;      // CPU fanout group the socket is joined to
+    uint16_t fanout_idx;      // Index of this worker in its interface's fanout group
+    int32_t  fanout_prog;     // eBPF program for PACKET_FANOUT_EBPF or -1
+    uint16_t *fanout_turn;    // Shared counter to join the fanout group in worker order
+    uint16_t fanout_type;     // PACKET_FANOUT_* mode
+    uint32_t flow_id;         // Flow ID stamped into this worker's Tx frames
     uint32_t frame_nr;
     uint16_t frame_sz;
+    uint64_t frm_lim;         // Frames this thread may send, 0 for no limit
+    uint8_t  frm_hdr[ETH_HLEN]; // Ethernet header written over the frame if frm_hdr_set
+    uint8_t  frm_hdr_set;
+    uint8_t  *frm_src;        // Shared frame data, copied into tx_buffer by the worker
+    uint8_t  frm_stamp;       // Stamp flow_id into tx_buffer (not for custom frames)
     uint16_t frm_sz_max;
+    uint16_t if_idx;          // Index of this worker's interface in sk_opt.if_opt
     int32_t  if_index;        // bind() a socket() to IfIndex
     uint8_t  if_name[IF_NAMESIZE];
+    uint8_t  ign_out;         // Don't receive frames sent by this host (PACKET_IGNORE_OUTGOING)
+    struct   lat_res *lat_res; // Per load step probes sent, for the probe worker
+    struct   lat_hist *lat_rx; // Per load step probe latencies of an Rx worker, else NULL
+    uint64_t lat_seq;         // Highest probe sequence number received
+    uint32_t *lat_step;       // Load step to stamp into the probes, NULL if not the probe worker
+    struct   memif_q *memif_q; // Shared memory ring of this worker for --memif
+    uint16_t mesh_nr;         // Number of interfaces in mesh mode
+    uint64_t mesh_other;      // Frames received that aren't mesh frames for this interface
+    struct   mesh_ctr *mesh_rx; // Rx counters per source interface in mesh mode, else NULL
     uint8_t* mmap_buf;        // Buffer used for PACKET_MMAP ring
     uint32_t msgvec_vlen;
+    uint64_t pace_epoch;      // Time in ns pace_sent is counted from
+    uint64_t pace_rate;       // Rate pace_epoch was set for
+    uint64_t pace_sent;       // Frames allowed since pace_epoch
     struct   iovec* ring;     // PACKET_MMAP ring
     uint8_t  quit;            // Signal stats thread to exit
+    uint64_t rfc2544_frms;    // RFC 2544 test frames received
+    uint8_t  rfc2544_rx;      // Count the RFC 2544 test frames in rfc2544_frms
     uint8_t  *rx_buffer;
     uint64_t rx_bytes;        // Total bytes received
     uint64_t rx_frms;         // Total frames received
@@ -147,8 +293,10 @@ struct thd_opt {
     int32_t  sock;            // Socket file descriptor
     uint8_t  started;         // Has Tx or Rx loop started?
     uint8_t  stalling;        // Socket is returning ENOBUFS
+    uint8_t  stop;            // Set to stop the Tx/Rx loop, the worker drains then returns
     uint32_t thd_id;          // Thread ID of "this" thread
-    uint16_t thd_nr;          // If >1, join a FANOUT group
+    uint16_t thd_idx;         // Index of this worker, 0 to thd_nr-1
+    uint16_t thd_nr;          // Workers on this interface, if >1 join a FANOUT group
     void     *thd_ret;        // Thread exit status
     int32_t  tpacket_ver;     // TPACKET_V2 || TPACKET_V3
     void     *tpacket_req3;   // TPACKET V3
@@ -159,7 +307,77 @@ struct thd_opt {
     uint8_t  *tx_buffer;      // Tx frame buffer
     uint64_t tx_bytes;        // Total bytes sent
     uint64_t tx_frms;         // Total packets sent
+    struct   thd_opt *tx_opt; // Settings of a reflector worker's Tx ring socket
+    uint64_t tx_rate;         // Frames per second this worker may send, 0 for no limit (see pace.h)
     uint8_t  verbose;         // Enable verbose output
+    uint32_t xdp_act;         // XDP_DROP or XDP_TX in XDP mode, else 0
+    uint32_t xdp_cpus;        // Number of possible CPUs, the per-CPU map values
+    struct   xdp_ctr *xdp_ctrs; // Buffer for the per-CPU map values
+    int32_t  xdp_link;        // BPF link attaching the XDP program to the interface
+    int32_t  xdp_map;         // Per-CPU frame and byte counter map
+    int32_t  xdp_prog;        // XDP program
+};
+
+// Per-thread counters as sampled by the stats thread
+struct thd_stats {
+    uint32_t thd_id;          // Copied so that readers never touch thd_opt
+    uint64_t rx_bytes;
+    uint64_t rx_drops;        // Accumulated from clear-on-read PACKET_STATISTICS
+    uint64_t rx_frms;
+    uint64_t rx_qfrz;         // Accumulated from clear-on-read PACKET_STATISTICS
+    uint64_t rx_roll;         // Frames this socket rolled over to another, from PACKET_ROLLOVER_STATS
+    uint64_t rx_roll_fail;    // Frames dropped because no socket in the group had room
+    uint64_t rx_roll_huge;    // Rollovers while this socket's queue was nearly full (a huge flow)
+    uint64_t sk_err;
+    uint64_t tx_bytes;
+    uint64_t tx_frms;
+};
+
+// Running min/max/mean/variance of a per-interval rate
+struct stat_sum {
+    double   max;
+    double   mean;
+    double   min;
+    double   m2;              // Sum of squared differences from the mean
+    uint64_t samples;
+};
+
+// Copy of the counters published by the stats thread each interval,
+// readers retry until they get a copy during which seq didn't change
+struct stat_snap {
+    uint64_t         duration;
+    uint32_t         seq;      // Odd while the stats thread is writing
+    struct thd_stats *thd;     // Per-thread counters, [thd_nr] is the aggregate
+    uint64_t         time;     // Unix time of the last update
+};
+
+// Stats output options and the state needed for the end of run summary
+struct stat_opt {
+    uint8_t          done;         // Set once the workers have stopped and drained
+    uint64_t         duration;     // Number of intervals reported so far
+    uint8_t          fmt;          // STATS_FMT_TEXT/JSON/CSV
+    struct hist_hdr  *hist;        // Mapped rate history file
+    char             hist_csv[256]; // Path the rate history is dumped to
+    volatile sig_atomic_t hist_dump; // Set by SIGUSR1 to dump the rate history
+    char             *hist_path;   // Path of the rate history file
+    size_t           hist_sz;
+    struct mesh_ctr  *mesh_now;    // Mesh Rx counters per src/dst pair, [src * if_nr + dst]
+    struct mesh_ctr  *mesh_prev;   // Mesh Rx counters from the previous interval
+    char             *metrics_addr; // OpenMetrics TCP port or Unix socket path
+    int32_t          metrics_sock; // OpenMetrics listening socket
+    pthread_t        metrics_thd;  // OpenMetrics exporter thread
+    FILE             *out;         // Stream for per-interval records
+    void             *shm_buf;     // Mapped /dev/shm live stats segment
+    char             *shm_name;    // Name of the stats segment in /dev/shm
+    char             shm_path[128];
+    size_t           shm_sz;
+    struct thd_stats *now;         // Per-thread counters, [thd_nr] is the aggregate
+    struct thd_stats *prev;        // Counters from the previous interval
+    struct stat_sum  rx_fps;
+    struct stat_sum  rx_gbps;
+    struct stat_snap snap;         // Lock-free copy for the exporters
+    struct stat_sum  tx_fps;
+    struct stat_sum  tx_gbps;
 };
 
 struct etherate {
@@ -167,6 +385,7 @@ struct etherate {
     struct   frm_opt frm_opt;
     struct   ifreq ifr;
     struct   sk_opt sk_opt;
+    struct   stat_opt stat_opt;
     struct   thd_opt *thd_opt;
 };
 
@@ -0,0 +1,628 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "memif.h"
+
+int32_t memif_attach(struct etherate *eth) {
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, eth->app_opt.memif_path, sizeof(addr.sun_path) - 1);
+
+    int32_t sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        perror("Can't create memif socket");
+        return EXIT_FAILURE;
+    }
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror("Can't connect to the memif Rx side, it must be started first");
+        close(sock);
+        return EXIT_FAILURE;
+    }
+
+
+    struct memif_msg msg;
+    struct iovec     iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+    union {
+        char           buf[CMSG_SPACE(sizeof(int) * (1 + 2 * MEMIF_RING_MAX))];
+        struct cmsghdr align;
+    } ctl;
+    struct msghdr    mh;
+
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov        = &iov;
+    mh.msg_iovlen     = 1;
+    mh.msg_control    = ctl.buf;
+    mh.msg_controllen = sizeof(ctl.buf);
+
+    ssize_t len = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+    close(sock);
+
+    if (len == -1) {
+        perror("Can't receive the memif region");
+        return EXIT_FAILURE;
+    }
+
+    // Take the fds first so that they are all closed on any error
+    int      fds[1 + 2 * MEMIF_RING_MAX];
+    uint32_t fd_nr = 0;
+    struct   cmsghdr *cmsg = CMSG_FIRSTHDR(&mh);
+
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        fd_nr = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(fds, CMSG_DATA(cmsg), fd_nr * sizeof(int));
+    }
+
+    int32_t ret = EXIT_SUCCESS;
+
+    if (len != sizeof(msg) || (mh.msg_flags & MSG_CTRUNC) ||
+        msg.magic != MEMIF_MAGIC || msg.version != MEMIF_VERSION ||
+        msg.fd_nr != fd_nr || fd_nr != 1 + 2 * msg.ring_nr) {
+        printf("Oops! Unexpected reply from the memif Rx side on %s.\n",
+               eth->app_opt.memif_path);
+        ret = EX_PROTOCOL;
+    } else if (msg.ring_nr != eth->app_opt.thd_nr) {
+        printf("Oops! The memif Rx side has %" PRIu32 " rings, use -c %" PRIu32 ".\n",
+               msg.ring_nr, msg.ring_nr);
+        ret = EX_SOFTWARE;
+    }
+
+    if (ret != EXIT_SUCCESS) {
+        for (uint32_t fd = 0; fd < fd_nr; fd += 1)
+            close(fds[fd]);
+        return ret;
+    }
+
+
+    eth->app_opt.memif_qs = calloc(eth->app_opt.thd_nr, sizeof(struct memif_q));
+    if (eth->app_opt.memif_qs == NULL) {
+        perror("Can't allocate memif queues");
+        for (uint32_t fd = 0; fd < fd_nr; fd += 1)
+            close(fds[fd]);
+        return EXIT_FAILURE;
+    }
+
+    for (uint16_t ring = 0; ring < eth->app_opt.thd_nr; ring += 1) {
+        eth->app_opt.memif_qs[ring].evt_rx = fds[1 + 2 * ring];
+        eth->app_opt.memif_qs[ring].evt_tx = fds[2 + 2 * ring];
+    }
+
+
+    struct stat st;
+    if (fstat(fds[0], &st) == -1 || (uint64_t)st.st_size < msg.region_sz) {
+        printf("Oops! The memif region is smaller than the Rx side said.\n");
+        close(fds[0]);
+        return EX_PROTOCOL;
+    }
+
+    eth->app_opt.memif = mmap(NULL, msg.region_sz, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fds[0], 0);
+    close(fds[0]);
+
+    if (eth->app_opt.memif == MAP_FAILED) {
+        perror("Can't map the memif region");
+        eth->app_opt.memif = NULL;
+        return EXIT_FAILURE;
+    }
+
+    eth->app_opt.memif_sz = msg.region_sz;
+
+    return memif_queues(eth);
+
+}
+
+
+
+void memif_cleanup(struct etherate *eth) {
+
+    if (eth->app_opt.memif_qs != NULL) {
+        for (uint16_t ring = 0; ring < eth->app_opt.thd_nr; ring += 1) {
+            if (eth->app_opt.memif_qs[ring].evt_rx > 0)
+                close(eth->app_opt.memif_qs[ring].evt_rx);
+            if (eth->app_opt.memif_qs[ring].evt_tx > 0)
+                close(eth->app_opt.memif_qs[ring].evt_tx);
+        }
+        free(eth->app_opt.memif_qs);
+        eth->app_opt.memif_qs = NULL;
+    }
+
+    if (eth->app_opt.memif != NULL) {
+        if (munmap(eth->app_opt.memif, eth->app_opt.memif_sz) != 0)
+            perror("Can't unmap the memif region");
+        eth->app_opt.memif = NULL;
+    }
+
+}
+
+
+
+int32_t memif_connect(struct etherate *eth) {
+
+    int32_t ret = (eth->app_opt.sk_mode == SKT_RX ? memif_listen(eth)
+                                                  : memif_attach(eth));
+
+    if (ret == EXIT_SUCCESS) {
+        struct memif_hdr *hdr = eth->app_opt.memif;
+        printf("Using %" PRIu32 " shared memory rings of %" PRIu32 " slots of %"
+               PRIu32 " bytes.\n", hdr->ring_nr, hdr->ring_sz, hdr->buf_sz);
+    }
+
+    return ret;
+
+}
+
+
+
+void *memif_init(void* thd_opt_p) {
+
+    struct thd_opt *thd_opt = thd_opt_p;
+    
+    // Save the thread tid
+    pid_t thread_id;
+    thread_id = syscall(SYS_gettid);
+    thd_opt->thd_id = thread_id;
+
+    // Set the thread cancel type and register the cleanup handler
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    pthread_cleanup_push(thd_cleanup, thd_opt_p);
+
+
+    if (thd_opt->verbose) {
+        if (thd_opt->affinity >= 0) {
+            printf(
+                "Worker thread %" PRIu32 " started, bound to CPU %" PRId32 "\n",
+                thd_opt->thd_id, thd_opt->affinity
+            );
+        } else {
+            printf("Worker thread %" PRIu32 " started\n", thd_opt->thd_id);
+        }
+    }
+
+    if (thd_alloc_bufs(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+    if (thd_opt->sk_mode == SKT_RX) {
+        memif_rx(thd_opt);
+    } else if (thd_opt->sk_mode == SKT_TX) {
+        memif_tx(thd_opt);
+    }
+
+
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
+    pthread_cleanup_pop(0);
+    return NULL;
+
+}
+
+
+
+void memif_kick(int32_t evt) {
+
+    uint64_t one = 1;
+
+    // A full counter (EAGAIN) means a wake up is already pending
+    if (write(evt, &one, sizeof(one)) == -1 && errno != EAGAIN)
+        perror("Can't write to memif eventfd");
+
+}
+
+
+
+int32_t memif_listen(struct etherate *eth) {
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (strlen(eth->app_opt.memif_path) >= sizeof(addr.sun_path)) {
+        printf("Oops! memif socket path is too long: %s\n", eth->app_opt.memif_path);
+        return EXIT_FAILURE;
+    }
+    strncpy(addr.sun_path, eth->app_opt.memif_path, sizeof(addr.sun_path) - 1);
+
+
+    // One ring per worker, each buffer holds the largest frame this side accepts
+    uint32_t ring_nr   = eth->app_opt.thd_nr;
+    uint32_t buf_sz    = (eth->frm_opt.frame_sz + MEMIF_ALIGN - 1) & ~(MEMIF_ALIGN - 1);
+    uint32_t ring_step = (sizeof(struct memif_ring) + MEMIF_RING_SZ * sizeof(struct memif_desc)
+                          + MEMIF_ALIGN - 1) & ~(MEMIF_ALIGN - 1);
+    uint64_t buf_off   = MEMIF_ALIGN + (uint64_t)ring_nr * ring_step;
+    uint64_t region_sz = buf_off + (uint64_t)ring_nr * MEMIF_RING_SZ * buf_sz;
+
+    int32_t memfd = memfd_create("etherate_memif", MFD_CLOEXEC);
+    if (memfd == -1) {
+        perror("Can't create the memif region");
+        return EXIT_FAILURE;
+    }
+
+    if (ftruncate(memfd, region_sz) == -1) {
+        perror("Can't size the memif region");
+        close(memfd);
+        return EXIT_FAILURE;
+    }
+
+    eth->app_opt.memif = mmap(NULL, region_sz, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, memfd, 0);
+
+    if (eth->app_opt.memif == MAP_FAILED) {
+        perror("Can't map the memif region");
+        eth->app_opt.memif = NULL;
+        close(memfd);
+        return EXIT_FAILURE;
+    }
+
+    eth->app_opt.memif_sz = region_sz;
+
+    // The region starts zeroed, so every ring starts empty
+    struct memif_hdr *hdr = eth->app_opt.memif;
+    hdr->magic     = MEMIF_MAGIC;
+    hdr->version   = MEMIF_VERSION;
+    hdr->ring_nr   = ring_nr;
+    hdr->ring_sz   = MEMIF_RING_SZ;
+    hdr->ring_off  = MEMIF_ALIGN;
+    hdr->ring_step = ring_step;
+    hdr->buf_sz    = buf_sz;
+    hdr->buf_off   = buf_off;
+    hdr->region_sz = region_sz;
+
+
+    int fds[1 + 2 * MEMIF_RING_MAX];
+    fds[0] = memfd;
+
+    eth->app_opt.memif_qs = calloc(ring_nr, sizeof(struct memif_q));
+    if (eth->app_opt.memif_qs == NULL) {
+        perror("Can't allocate memif queues");
+        close(memfd);
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t ring = 0; ring < ring_nr; ring += 1) {
+
+        struct memif_q *q = &eth->app_opt.memif_qs[ring];
+
+        q->evt_rx = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        q->evt_tx = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (q->evt_rx == -1 || q->evt_tx == -1) {
+            perror("Can't create memif eventfd");
+            close(memfd);
+            return EXIT_FAILURE;
+        }
+
+        fds[1 + 2 * ring] = q->evt_rx;
+        fds[2 + 2 * ring] = q->evt_tx;
+
+    }
+
+    if (memif_queues(eth) != EXIT_SUCCESS) {
+        close(memfd);
+        return EXIT_FAILURE;
+    }
+
+
+    int32_t sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        perror("Can't create memif socket");
+        close(memfd);
+        return EXIT_FAILURE;
+    }
+
+    // Remove a stale socket left by a previous run
+    unlink(eth->app_opt.memif_path);
+
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(sock, 1) == -1) {
+        perror("Can't listen on memif socket");
+        close(sock);
+        close(memfd);
+        return EXIT_FAILURE;
+    }
+
+    printf("Waiting for the memif Tx side to connect to %s\n", eth->app_opt.memif_path);
+
+
+    // Poll so that Ctrl+C is noticed while waiting
+    struct  pollfd pfd = { .fd = sock, .events = POLLIN };
+    int32_t conn = -1;
+
+    while (!eth->app_opt.stop) {
+        if (poll(&pfd, 1, DEF_POLL_TIMEO) > 0) {
+            conn = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+            break;
+        }
+    }
+
+    close(sock);
+    unlink(eth->app_opt.memif_path);
+
+    if (conn == -1) {
+        if (!eth->app_opt.stop)
+            perror("Can't accept memif connection");
+        close(memfd);
+        return EXIT_FAILURE;
+    }
+
+
+    struct memif_msg msg = {
+        .magic     = MEMIF_MAGIC,
+        .version   = MEMIF_VERSION,
+        .ring_nr   = ring_nr,
+        .fd_nr     = 1 + 2 * ring_nr,
+        .region_sz = region_sz,
+    };
+    struct iovec iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+    union {
+        char           buf[CMSG_SPACE(sizeof(int) * (1 + 2 * MEMIF_RING_MAX))];
+        struct cmsghdr align;
+    } ctl;
+    struct msghdr mh;
+
+    memset(&ctl, 0, sizeof(ctl));
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov        = &iov;
+    mh.msg_iovlen     = 1;
+    mh.msg_control    = ctl.buf;
+    mh.msg_controllen = CMSG_SPACE(sizeof(int) * msg.fd_nr);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * msg.fd_nr);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * msg.fd_nr);
+
+    int32_t ret = EXIT_SUCCESS;
+    if (sendmsg(conn, &mh, MSG_NOSIGNAL) != sizeof(msg)) {
+        perror("Can't send the memif region");
+        ret = EXIT_FAILURE;
+    }
+
+    close(conn);
+    close(memfd);
+
+    return ret;
+
+}
+
+
+
+int32_t memif_queues(struct etherate *eth) {
+
+    struct memif_hdr *hdr = eth->app_opt.memif;
+    uint64_t         ring_end;
+    uint64_t         buf_end;
+
+    // The Tx side checks everything it will index with, the Rx side
+    // could be another program or version
+    ring_end = (uint64_t)hdr->ring_off + (uint64_t)hdr->ring_nr * hdr->ring_step;
+    buf_end  = hdr->buf_off + (uint64_t)hdr->ring_nr * hdr->ring_sz * hdr->buf_sz;
+
+    if (hdr->magic != MEMIF_MAGIC || hdr->version != MEMIF_VERSION ||
+        hdr->ring_nr != eth->app_opt.thd_nr ||
+        hdr->ring_sz == 0 || hdr->ring_sz > 65536 ||
+        (hdr->ring_sz & (hdr->ring_sz - 1)) != 0 ||
+        hdr->buf_sz > 65536 ||
+        hdr->ring_off < sizeof(struct memif_hdr) || hdr->ring_off % MEMIF_ALIGN ||
+        hdr->ring_step % MEMIF_ALIGN ||
+        hdr->ring_step < sizeof(struct memif_ring) + hdr->ring_sz * sizeof(struct memif_desc) ||
+        hdr->buf_off < ring_end || buf_end > eth->app_opt.memif_sz ||
+        hdr->region_sz != eth->app_opt.memif_sz) {
+        printf("Oops! The memif region header is invalid.\n");
+        return EX_PROTOCOL;
+    }
+
+    if (hdr->buf_sz < eth->frm_opt.frame_sz) {
+        printf("Oops! The memif buffers are %" PRIu32 " bytes, use -f %" PRIu16
+               " or more on the Rx side.\n", hdr->buf_sz, eth->frm_opt.frame_sz);
+        return EX_SOFTWARE;
+    }
+
+    for (uint32_t ring = 0; ring < hdr->ring_nr; ring += 1) {
+
+        struct memif_q *q = &eth->app_opt.memif_qs[ring];
+
+        q->bufs    = (uint8_t*)eth->app_opt.memif + hdr->buf_off
+                     + (uint64_t)ring * hdr->ring_sz * hdr->buf_sz;
+        q->buf_sz  = hdr->buf_sz;
+        q->ring    = (struct memif_ring*)((uint8_t*)eth->app_opt.memif + hdr->ring_off
+                     + (uint64_t)ring * hdr->ring_step);
+        q->ring_sz = hdr->ring_sz;
+
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+void memif_rx(struct thd_opt *thd_opt) {
+
+    struct   memif_q *q = thd_opt->memif_q;
+    struct   memif_ring *ring = q->ring;
+    uint32_t mask = q->ring_sz - 1;
+    uint32_t tail = ring->tail;
+    uint32_t head;
+    uint32_t len;
+
+    thd_opt->started = 1;
+
+    while(!thd_stopping(thd_opt)) {
+
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            memif_wait(&ring->rx_wait, &ring->head, head, q->evt_rx);
+            continue;
+        }
+
+        // Only the lengths are read, the frames stay in place
+        for (uint32_t burst = 0; burst < MEMIF_BURST && tail != head; burst += 1) {
+            len = ring->desc[tail & mask].length;
+            thd_opt->rx_bytes += (len > q->buf_sz ? q->buf_sz : len);
+            thd_opt->rx_frms += 1;
+            tail += 1;
+        }
+
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        // Pairs with the fence in memif_wait(), either the Tx side sees the
+        // new tail or this side sees its wait flag
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->tx_wait, __ATOMIC_RELAXED))
+            memif_kick(q->evt_tx);
+
+    }
+
+    // Count any frames already in the ring
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    while (tail != head) {
+        len = ring->desc[tail & mask].length;
+        thd_opt->rx_bytes += (len > q->buf_sz ? q->buf_sz : len);
+        thd_opt->rx_frms += 1;
+        tail += 1;
+    }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+}
+
+
+
+int32_t memif_setup(struct etherate *eth) {
+
+    if (eth->sk_opt.if_nr != 0) {
+        printf("Oops! --memif doesn't use an interface, remove -i/-I.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.sk_type != DEF_SKT_TYPE) {
+        printf("Oops! --memif can't be used with -p.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.mesh || eth->app_opt.xdp || eth->app_opt.q_map != QMAP_OFF ||
+        eth->app_opt.sk_mode == SKT_BIDI || eth->app_opt.sk_mode == SKT_REFLECT) {
+        printf("Oops! --memif can't be used with --mesh, --xdp, -Q, -R or -rt.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.thd_nr > MEMIF_RING_MAX) {
+        printf("Oops! --memif can't use more than %" PRId32 " worker threads.\n",
+               MEMIF_RING_MAX);
+        return EX_SOFTWARE;
+    }
+
+    eth->app_opt.sk_type = SKT_MEMIF;
+
+    uint8_t if_name[IF_NAMESIZE] = "memif";
+
+    return add_if(eth, 0, if_name);
+
+}
+
+
+
+void memif_tx(struct thd_opt *thd_opt) {
+
+    struct   memif_q *q = thd_opt->memif_q;
+    struct   memif_ring *ring = q->ring;
+    uint32_t mask = q->ring_sz - 1;
+    uint32_t head = ring->head;
+    uint32_t tail;
+    uint32_t burst;
+
+    thd_opt->started = 1;
+
+    while(!thd_stopping(thd_opt)) {
+
+        tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        burst = q->ring_sz - (head - tail);
+        if (burst == 0) {
+            memif_wait(&ring->tx_wait, &ring->tail, tail, q->evt_tx);
+            continue;
+        }
+
+        if (burst > MEMIF_BURST)
+            burst = MEMIF_BURST;
+        if (thd_opt->frm_lim && burst > thd_opt->frm_lim - thd_opt->tx_frms)
+            burst = thd_opt->frm_lim - thd_opt->tx_frms;
+
+        // Only fill the slots due under -t
+        burst = pace_tx(thd_opt, burst);
+        if (burst == 0)
+            continue;
+
+        for (uint32_t frm = 0; frm < burst; frm += 1) {
+            uint32_t slot = (head + frm) & mask;
+            memcpy(q->bufs + (uint64_t)slot * q->buf_sz, thd_opt->tx_buffer, thd_opt->frame_sz);
+            ring->desc[slot].length = thd_opt->frame_sz;
+        }
+
+        head += burst;
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+        // Pairs with the fence in memif_wait(), either the Rx side sees the
+        // new head or this side sees its wait flag
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->rx_wait, __ATOMIC_RELAXED))
+            memif_kick(q->evt_rx);
+
+        thd_opt->tx_bytes += (uint64_t)burst * thd_opt->frame_sz;
+        thd_opt->tx_frms += burst;
+        if (thd_opt->tx_frms == thd_opt->frm_lim)
+            break;
+
+    }
+
+}
+
+
+
+void memif_wait(uint32_t *wait, uint32_t *idx, uint32_t seen, int32_t evt) {
+
+    struct   pollfd pfd = { .fd = evt, .events = POLLIN };
+    uint64_t cnt;
+
+    __atomic_store_n(wait, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // Check again after setting the flag or a kick could be missed
+    if (__atomic_load_n(idx, __ATOMIC_RELAXED) == seen)
+        poll(&pfd, 1, DEF_POLL_TIMEO);
+
+    __atomic_store_n(wait, 0, __ATOMIC_RELAXED);
+
+    // Clear the eventfd, it is non-blocking
+    if (read(evt, &cnt, sizeof(cnt)) == -1 && errno != EAGAIN)
+        perror("Can't read memif eventfd");
+
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _MEMIF_H_
+#define _MEMIF_H_
+
+/*
+ * Shared memory engine (--memif <path>), two EtherateMT processes on the
+ * same host exchange frames through rings in a shared memory region, in
+ * the style of memif, with no Kernel in the data path.
+ *
+ * The Rx side is the master, it creates the region with memfd_create() and
+ * one pair of eventfds per ring, listens on the Unix socket <path> and
+ * passes them with SCM_RIGHTS to the Tx side when it connects. Worker N of
+ * each side uses ring N so both sides must use the same -c.
+ *
+ * The region is a struct memif_hdr, then ring_nr rings ring_step bytes
+ * apart starting at ring_off, each a struct memif_ring followed by ring_sz
+ * struct memif_desc, then ring_nr * ring_sz buffers of buf_sz bytes starting
+ * at buf_off. Slot S of ring N always uses buffer N * ring_sz + S, only the
+ * frame length is passed in the descriptor. All fields are native endian.
+ *
+ * head is only written by the Tx side and tail by the Rx side, both count
+ * up forever and wrap at 2^32. A side that finds its ring empty (Rx) or
+ * full (Tx) sets its wait flag, checks the ring again and then sleeps on
+ * its eventfd, the other side writes to that eventfd when it sees the flag.
+ */
+
+#define MEMIF_ALIGN     64          // Cache line, the rings and buffers start on one
+#define MEMIF_BURST     64          // Frames per head/tail update
+#define MEMIF_MAGIC     0x454d4946  // "EMIF"
+#define MEMIF_RING_MAX  126         // The region and two eventfds per ring fit in SCM_MAX_FD
+#define MEMIF_RING_SZ   1024        // Descriptors per ring, a power of 2
+#define MEMIF_VERSION   1
+
+struct memif_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_nr;            // Number of rings, one per worker
+    uint32_t ring_sz;            // Descriptors per ring
+    uint32_t ring_off;           // Offset of the first ring
+    uint32_t ring_step;          // Bytes from the start of one ring to the next
+    uint32_t buf_sz;             // Bytes per buffer, the largest frame
+    uint32_t pad;
+    uint64_t buf_off;            // Offset of the first buffer
+    uint64_t region_sz;          // Size of the whole region
+};
+
+struct memif_desc {
+    uint32_t length;             // Frame length in the slot's buffer
+    uint32_t flags;              // Unused, 0
+};
+
+// head and tail are on their own cache lines so that each is only written
+// by one side
+struct memif_ring {
+    uint32_t head;               // Next slot the Tx side fills
+    uint32_t rx_wait;            // Rx side is sleeping on the Rx eventfd
+    uint8_t  pad0[MEMIF_ALIGN - 8];
+    uint32_t tail;               // Next slot the Rx side reads
+    uint32_t tx_wait;            // Tx side is sleeping on the Tx eventfd
+    uint8_t  pad1[MEMIF_ALIGN - 8];
+    struct   memif_desc desc[];
+};
+
+// Sent by the Rx side with the memfd then each ring's Rx and Tx eventfds
+struct memif_msg {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_nr;
+    uint32_t fd_nr;              // 1 + 2 * ring_nr
+    uint64_t region_sz;
+};
+
+// Tx side, connect to the Rx side and map the region it sends
+int32_t memif_attach(struct etherate *eth);
+
+// Close the eventfds and unmap the region
+void memif_cleanup(struct etherate *eth);
+
+// Create (Rx) or map (Tx) the shared region before the workers start
+int32_t memif_connect(struct etherate *eth);
+
+// Worker thread entry function
+void *memif_init(void* thd_opt_p);
+
+// Ring the other side's eventfd
+void memif_kick(int32_t evt);
+
+// Rx side, create the region and wait for the Tx side to connect
+int32_t memif_listen(struct etherate *eth);
+
+// Point each worker's queue at its ring and buffers in the mapped region
+int32_t memif_queues(struct etherate *eth);
+
+// Rx thread loop reading the frame lengths from the ring
+void memif_rx(struct thd_opt *thd_opt);
+
+// Check the options and add the memif pseudo interface
+int32_t memif_setup(struct etherate *eth);
+
+// Tx thread loop copying the frame into the ring
+void memif_tx(struct thd_opt *thd_opt);
+
+// Sleep on evt until the ring index at idx moves from seen or the timeout
+void memif_wait(uint32_t *wait, uint32_t *idx, uint32_t seen, int32_t evt);
+
+#endif // _MEMIF_H_
\ No newline at end of file
@@ -0,0 +1,292 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "mesh.h"
+
+
+
+static int32_t mesh_init(struct etherate *eth) {
+
+    uint16_t if_nr = eth->sk_opt.if_nr;
+
+    if (if_nr < 2) {
+        printf("Oops! --mesh needs at least two interfaces.\n");
+        return EX_SOFTWARE;
+    }
+
+    // The src/dst pair is carried in 8 bits each of the flow ID
+    if (if_nr > 0xff) {
+        printf("Oops! --mesh supports at most 255 interfaces.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->frm_opt.custom_frame ||
+        eth->frm_opt.frame_sz < FLOW_ID_OFF + sizeof(uint32_t)) {
+        printf("Oops! --mesh can't be used with -C or frames smaller than "
+               "%zu bytes.\n", FLOW_ID_OFF + sizeof(uint32_t));
+        return EX_SOFTWARE;
+    }
+
+
+    // Each interface sends to the MAC of the others, so that a switch or
+    // bridge between them forwards rather than floods the test traffic
+    if (get_if_macs(eth) != EXIT_SUCCESS)
+        return EX_SOFTWARE;
+
+
+    // One Tx worker per ordered pair, then -c Rx workers per interface
+    uint16_t rx_per_if = eth->app_opt.thd_nr;
+    uint16_t rx_nr     = if_nr * rx_per_if;
+
+    eth->app_opt.tx_nr      = if_nr * (if_nr - 1);
+    eth->app_opt.sk_mode    = SKT_BIDI;
+    eth->app_opt.thd_nr     = eth->app_opt.tx_nr + rx_nr;
+
+    printf("Mesh of %" PRIu16 " interfaces, %" PRIu16 " Tx workers (one per pair) "
+           "and %" PRIu16 " Rx workers per interface.\n",
+           if_nr, eth->app_opt.tx_nr, rx_per_if);
+
+
+    // Each Rx worker has its own counters on separate cache lines
+    size_t ctr_sz = ((if_nr * sizeof(struct mesh_ctr) + 63) / 64) * 64;
+
+    eth->app_opt.mesh_ctrs = aligned_alloc(64, ctr_sz * rx_nr);
+    eth->stat_opt.mesh_now = calloc(if_nr * if_nr, sizeof(struct mesh_ctr));
+    eth->stat_opt.mesh_prev = calloc(if_nr * if_nr, sizeof(struct mesh_ctr));
+
+    if (eth->app_opt.mesh_ctrs == NULL || eth->stat_opt.mesh_now == NULL ||
+        eth->stat_opt.mesh_prev == NULL) {
+        printf("Failed to calloc() mesh counters!\n");
+        return EXIT_FAILURE;
+    }
+
+    memset(eth->app_opt.mesh_ctrs, 0, ctr_sz * rx_nr);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static void mesh_pair(struct etherate *eth, uint16_t thread, uint16_t *src, uint16_t *dst) {
+
+    // Tx workers 0 to N-2 send from interface 0, N-1 to 2N-3 from 1 etc.
+    uint16_t others = eth->sk_opt.if_nr - 1;
+
+    *src = thread / others;
+    *dst = thread % others;
+    if (*dst >= *src)
+        *dst += 1;
+
+}
+
+
+
+static void mesh_print(struct etherate *eth, uint8_t summary) {
+
+    struct   stat_opt *stat_opt = &eth->stat_opt;
+    uint16_t if_nr = eth->sk_opt.if_nr;
+    uint64_t other = 0;
+
+    for (uint16_t thread = eth->app_opt.tx_nr; thread < eth->app_opt.thd_nr; thread += 1)
+        other += eth->thd_opt[thread].mesh_other;
+
+
+    if (!summary) {
+
+        // Rx fps for this interval, rows are the sender, columns the receiver
+        printf("\tMesh Rx fps");
+        for (uint16_t dst = 0; dst < if_nr; dst += 1)
+            printf("\t%s", eth->sk_opt.if_opt[dst].if_name);
+        printf("\n");
+
+        for (uint16_t src = 0; src < if_nr; src += 1) {
+            printf("\t%s", eth->sk_opt.if_opt[src].if_name);
+            for (uint16_t dst = 0; dst < if_nr; dst += 1) {
+                uint16_t pair = src * if_nr + dst;
+                if (src == dst)
+                    printf("\t-");
+                else
+                    printf("\t%" PRIu64, stat_opt->mesh_now[pair].frms -
+                                         stat_opt->mesh_prev[pair].frms);
+            }
+            printf("\n");
+        }
+
+        return;
+
+    }
+
+
+    // Tx/Rx/loss per pair over the run, rows are the sender, columns the receiver
+    if (stat_opt->fmt == STATS_FMT_JSON) {
+        fprintf(stat_opt->out, "{\"mesh\":{\"pairs\":[");
+    } else {
+        printf("Mesh Rx frames (loss)");
+        for (uint16_t dst = 0; dst < if_nr; dst += 1)
+            printf("\t%s\t", eth->sk_opt.if_opt[dst].if_name);
+        printf("\n");
+    }
+
+    for (uint16_t src = 0; src < if_nr; src += 1) {
+
+        if (stat_opt->fmt != STATS_FMT_JSON)
+            printf("%s\t", eth->sk_opt.if_opt[src].if_name);
+
+        for (uint16_t dst = 0; dst < if_nr; dst += 1) {
+
+            if (src == dst) {
+                if (stat_opt->fmt != STATS_FMT_JSON)
+                    printf("\t-\t");
+                continue;
+            }
+
+            // The inverse of mesh_pair()
+            uint16_t thread  = src * (if_nr - 1) + dst - (dst > src);
+            uint64_t tx_frms = stat_opt->now[thread].tx_frms;
+            struct   mesh_ctr *rx = &stat_opt->mesh_now[src * if_nr + dst];
+            double   loss    = 0;
+
+            if (tx_frms > rx->frms)
+                loss = ((double)(tx_frms - rx->frms) / tx_frms) * 100;
+
+            if (stat_opt->fmt == STATS_FMT_JSON) {
+                fprintf(stat_opt->out,
+                        "%s{\"src\":\"%s\",\"dst\":\"%s\",\"tx_frames\":%" PRIu64 ","
+                        "\"rx_frames\":%" PRIu64 ",\"rx_bytes\":%" PRIu64 ",\"loss\":%.4f}",
+                        (thread > 0 ? "," : ""), eth->sk_opt.if_opt[src].if_name,
+                        eth->sk_opt.if_opt[dst].if_name, tx_frms, rx->frms, rx->bytes, loss);
+            } else {
+                printf("\t%" PRIu64 " (%.2f%%)", rx->frms, loss);
+            }
+
+        }
+
+        if (stat_opt->fmt != STATS_FMT_JSON)
+            printf("\n");
+
+    }
+
+    if (stat_opt->fmt == STATS_FMT_JSON) {
+        fprintf(stat_opt->out, "],\"other\":%" PRIu64 "}}\n", other);
+        fflush(stat_opt->out);
+    } else if (other > 0) {
+        printf("Received %" PRIu64 " frames that weren't mesh frames for their interface\n", other);
+    }
+
+}
+
+
+
+static inline void mesh_rx(struct thd_opt *thd_opt, const uint8_t *frame, uint32_t len) {
+
+    uint32_t flow_id;
+
+    if (len < FLOW_ID_OFF + sizeof(flow_id)) {
+        thd_opt->mesh_other += 1;
+        return;
+    }
+
+    memcpy(&flow_id, frame + FLOW_ID_OFF, sizeof(flow_id));
+    flow_id = ntohl(flow_id);
+
+    uint16_t src = (flow_id >> 8) & 0xff;
+
+    // Other traffic on the link, or a mesh frame flooded to the wrong interface
+    if ((flow_id >> 16) != MESH_MAGIC || src >= thd_opt->mesh_nr ||
+        (flow_id & 0xff) != thd_opt->if_idx) {
+        thd_opt->mesh_other += 1;
+        return;
+    }
+
+    thd_opt->mesh_rx[src].frms  += 1;
+    thd_opt->mesh_rx[src].bytes += len;
+
+}
+
+
+
+static void mesh_sample(struct etherate *eth) {
+
+    struct   stat_opt *stat_opt = &eth->stat_opt;
+    uint16_t if_nr = eth->sk_opt.if_nr;
+
+    memcpy(stat_opt->mesh_prev, stat_opt->mesh_now, sizeof(struct mesh_ctr) * if_nr * if_nr);
+    memset(stat_opt->mesh_now, 0, sizeof(struct mesh_ctr) * if_nr * if_nr);
+
+    for (uint16_t thread = eth->app_opt.tx_nr; thread < eth->app_opt.thd_nr; thread += 1) {
+
+        struct   thd_opt *thd_opt = &eth->thd_opt[thread];
+        uint16_t dst = thd_opt->if_idx;
+
+        // This worker hasn't been set up yet
+        if (thd_opt->mesh_rx == NULL)
+            continue;
+
+        for (uint16_t src = 0; src < if_nr; src += 1) {
+            stat_opt->mesh_now[src * if_nr + dst].frms  += thd_opt->mesh_rx[src].frms;
+            stat_opt->mesh_now[src * if_nr + dst].bytes += thd_opt->mesh_rx[src].bytes;
+        }
+
+    }
+
+}
+
+
+
+static void mesh_thd_setup(struct etherate *eth, uint16_t thread) {
+
+    struct   thd_opt *thd_opt = &eth->thd_opt[thread];
+    uint16_t if_nr = eth->sk_opt.if_nr;
+
+    thd_opt->mesh_nr = if_nr;
+
+    if (thread < eth->app_opt.tx_nr) {
+
+        uint16_t src;
+        uint16_t dst;
+        uint16_t ethertype = htons(MESH_ETHERTYPE);
+        mesh_pair(eth, thread, &src, &dst);
+
+        memcpy(thd_opt->frm_hdr, eth->sk_opt.if_opt[dst].mac, ETH_ALEN);
+        memcpy(thd_opt->frm_hdr + ETH_ALEN, eth->sk_opt.if_opt[src].mac, ETH_ALEN);
+        memcpy(thd_opt->frm_hdr + (ETH_ALEN * 2), &ethertype, sizeof(ethertype));
+
+        thd_opt->flow_id     = ((uint32_t)MESH_MAGIC << 16) | (src << 8) | dst;
+        thd_opt->frm_hdr_set = 1;
+
+    } else {
+
+        uint16_t rx_idx = thread - eth->app_opt.tx_nr;
+        size_t   ctr_nr = ((if_nr * sizeof(struct mesh_ctr) + 63) / 64) * 64 /
+                          sizeof(struct mesh_ctr);
+
+        thd_opt->mesh_rx = &eth->app_opt.mesh_ctrs[rx_idx * ctr_nr];
+
+    }
+
+}
\ No newline at end of file
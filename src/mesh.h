@@ -0,0 +1,65 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _MESH_H_
+#define _MESH_H_
+
+/*
+ * Full mesh mode: with N interfaces one Tx worker per ordered src/dst pair
+ * sends to the destination interface's MAC address, stamping the pair into
+ * the flow ID, and the Rx workers on each interface count the frames from
+ * each source. Each Rx worker has its own counters indexed directly by the
+ * source interface, so the hot loop never hashes or shares a cache line.
+ */
+
+#define MESH_ETHERTYPE 0x88b5    // IEEE 802 local experimental EtherType
+#define MESH_MAGIC     0x4d45    // "ME", the top 16 bits of a mesh flow ID
+
+struct mesh_ctr {
+    uint64_t frms;
+    uint64_t bytes;
+};
+
+// Validate mesh mode, set the number of workers and allocate the counters
+static int32_t mesh_init(struct etherate *eth);
+
+// Return the source and destination interfaces of a mesh Tx worker
+static void mesh_pair(struct etherate *eth, uint16_t thread, uint16_t *src, uint16_t *dst);
+
+// Print the per-pair Rx rates for this interval, or the Tx/Rx/loss matrix at the end
+static void mesh_print(struct etherate *eth, uint8_t summary);
+
+// Count a received frame against its source interface
+static inline void mesh_rx(struct thd_opt *thd_opt, const uint8_t *frame, uint32_t len);
+
+// Sum the Rx workers' counters into the src/dst matrix
+static void mesh_sample(struct etherate *eth);
+
+// Set the frame header and flow ID, or the Rx counters, of a worker in mesh mode
+static void mesh_thd_setup(struct etherate *eth, uint16_t thread);
+
+#endif // _MESH_H_
\ No newline at end of file
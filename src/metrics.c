@@ -0,0 +1,291 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "metrics.h"
+
+
+
+int32_t metrics_init(struct etherate *eth) {
+
+    char *addr = eth->stat_opt.metrics_addr;
+
+    // A value containing a "/" is a Unix socket path, otherwise a TCP port
+    if (strchr(addr, '/') != NULL) {
+
+        struct sockaddr_un un_addr;
+        memset(&un_addr, 0, sizeof(un_addr));
+        un_addr.sun_family = AF_UNIX;
+
+        if (strlen(addr) >= sizeof(un_addr.sun_path)) {
+            printf("Oops! Metrics socket path is too long: %s\n", addr);
+            return EXIT_FAILURE;
+        }
+        strncpy(un_addr.sun_path, addr, sizeof(un_addr.sun_path) - 1);
+
+        eth->stat_opt.metrics_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (eth->stat_opt.metrics_sock == -1) {
+            perror("Can't create metrics socket");
+            return EXIT_FAILURE;
+        }
+
+        // Remove a stale socket left by a previous run
+        unlink(addr);
+
+        if (bind(eth->stat_opt.metrics_sock, (struct sockaddr *)&un_addr,
+                 sizeof(un_addr)) == -1) {
+            perror("Can't bind metrics socket");
+            return EXIT_FAILURE;
+        }
+
+        printf("Serving OpenMetrics on unix:%s\n", addr);
+
+    } else {
+
+        struct sockaddr_in in_addr;
+        memset(&in_addr, 0, sizeof(in_addr));
+        in_addr.sin_family      = AF_INET;
+        in_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        in_addr.sin_port        = htons((uint16_t)strtoul(addr, NULL, 0));
+
+        eth->stat_opt.metrics_sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (eth->stat_opt.metrics_sock == -1) {
+            perror("Can't create metrics socket");
+            return EXIT_FAILURE;
+        }
+
+        int32_t reuse = 1;
+        if (setsockopt(eth->stat_opt.metrics_sock, SOL_SOCKET, SO_REUSEADDR,
+                       &reuse, sizeof(reuse)) == -1) {
+            perror("Can't set SO_REUSEADDR on metrics socket");
+        }
+
+        if (bind(eth->stat_opt.metrics_sock, (struct sockaddr *)&in_addr,
+                 sizeof(in_addr)) == -1) {
+            perror("Can't bind metrics socket");
+            return EXIT_FAILURE;
+        }
+
+        printf("Serving OpenMetrics on http://127.0.0.1:%s/metrics\n", addr);
+
+    }
+
+    if (listen(eth->stat_opt.metrics_sock, 8) == -1) {
+        perror("Can't listen on metrics socket");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+void *metrics_serve(void *etherate_p) {
+
+    struct etherate *eth = etherate_p;
+    struct stat_snap snap;
+    char   req[1024];
+    uint8_t starved = 0; // accept() is failing for lack of descriptors or memory
+
+    // Private copy of the counters, the workers' thd_opt is never read here
+    snap.thd = calloc(sizeof(struct thd_stats), (eth->app_opt.thd_nr + 1));
+    if (snap.thd == NULL) {
+        printf("Failed to calloc() metrics snapshot!\n");
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+    pthread_cleanup_push(free, snap.thd);
+
+    while(!eth->app_opt.stop && !__atomic_load_n(&eth->stat_opt.done, __ATOMIC_RELAXED)) {
+
+        int32_t client = accept(eth->stat_opt.metrics_sock, NULL, NULL);
+
+        if (client == -1) {
+
+            // The socket has been closed, nothing more can be served
+            if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK) {
+                perror("Can't accept metrics connections, stopping the exporter");
+                break;
+            }
+
+            // Back off until descriptors or memory are freed, warn once
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                if (!starved)
+                    perror("Can't accept metrics connection");
+                starved = 1;
+                nanosleep(&(struct timespec){ .tv_sec  = 0,
+                                              .tv_nsec = DEF_POLL_TIMEO * 1000000L }, NULL);
+                continue;
+            }
+
+            // Aborted connections and signals are retried straight away
+            if (errno != EINTR && errno != ECONNABORTED)
+                perror("Can't accept metrics connection");
+
+            continue;
+
+        }
+
+        starved = 0;
+
+        // Don't let a slow client block the exporter
+        struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        // Any request is answered with the metrics, read and discard it
+        if (read(client, req, sizeof(req)) <= 0) {
+            close(client);
+            continue;
+        }
+
+        stats_snap_read(eth, &snap);
+
+        char   *body     = NULL;
+        size_t body_len  = 0;
+        FILE   *body_str = open_memstream(&body, &body_len);
+        if (body_str == NULL) {
+            perror("Can't open metrics buffer");
+            close(client);
+            continue;
+        }
+        metrics_write(eth, body_str, &snap);
+        fclose(body_str);
+
+        dprintf(client,
+                "HTTP/1.0 200 OK\r\n"
+                "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                "Content-Length: %zu\r\n"
+                "Connection: close\r\n\r\n", body_len);
+
+        size_t sent = 0;
+        while (sent < body_len) {
+            ssize_t ret = write(client, body + sent, body_len - sent);
+            if (ret <= 0) break;
+            sent += (size_t)ret;
+        }
+
+        free(body);
+        close(client);
+
+    }
+
+    pthread_cleanup_pop(1);
+    return NULL;
+
+}
+
+
+
+void metrics_write(struct etherate *eth, FILE *body, struct stat_snap *snap) {
+
+    // Every counter in struct thd_stats is exported per-thread and in aggregate
+    static const struct {
+        const char *name;
+        const char *help;
+        size_t     offset;
+    } counters[] = {
+        { "rx_bytes",          "Bytes received",
+          offsetof(struct thd_stats, rx_bytes) },
+        { "rx_frames",         "Frames received",
+          offsetof(struct thd_stats, rx_frms) },
+        { "rx_drops",          "Frames dropped by the kernel before reaching the Rx ring",
+          offsetof(struct thd_stats, rx_drops) },
+        { "rx_queue_freezes",  "TPACKET_V3 Rx queue freezes",
+          offsetof(struct thd_stats, rx_qfrz) },
+        { "rx_rollovers",      "Frames rolled over to another fanout socket",
+          offsetof(struct thd_stats, rx_roll) },
+        { "rx_rollovers_failed", "Frames dropped because no fanout socket had room",
+          offsetof(struct thd_stats, rx_roll_fail) },
+        { "rx_rollovers_huge", "Rollovers while the socket's queue was nearly full",
+          offsetof(struct thd_stats, rx_roll_huge) },
+        { "socket_errors",     "Send/receive syscall errors",
+          offsetof(struct thd_stats, sk_err) },
+        { "tx_bytes",          "Bytes sent",
+          offsetof(struct thd_stats, tx_bytes) },
+        { "tx_frames",         "Frames sent",
+          offsetof(struct thd_stats, tx_frms) },
+    };
+
+    uint16_t thd_nr = eth->app_opt.thd_nr;
+
+    // One info label lists all the interfaces, e.g. "eth0,eth1"
+    char if_names[DEF_IF_MAX * IF_NAMESIZE] = {0};
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+        if (if_idx > 0)
+            strcat(if_names, ",");
+        strcat(if_names, (char*)eth->sk_opt.if_opt[if_idx].if_name);
+    }
+
+    fprintf(body,
+            "# TYPE etherate_info gauge\n"
+            "# HELP etherate_info EtherateMT build and run settings.\n"
+            "etherate_info{version=\"%s\",interface=\"%s\",sk_mode=\"%" PRIu8 "\","
+            "sk_type=\"%" PRIu8 "\",threads=\"%" PRIu16 "\"} 1\n",
+            app_version, if_names, eth->app_opt.sk_mode,
+            eth->app_opt.sk_type, thd_nr);
+
+    fprintf(body,
+            "# TYPE etherate_interval gauge\n"
+            "# HELP etherate_interval Number of stats intervals completed.\n"
+            "etherate_interval %" PRIu64 "\n"
+            "# TYPE etherate_last_update_seconds gauge\n"
+            "# UNIT etherate_last_update_seconds seconds\n"
+            "# HELP etherate_last_update_seconds Unix time the counters were last sampled.\n"
+            "etherate_last_update_seconds %" PRIu64 "\n",
+            snap->duration, snap->time);
+
+    for (uint8_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i += 1) {
+
+        uint64_t val;
+        memcpy(&val, (uint8_t*)&snap->thd[thd_nr] + counters[i].offset, sizeof(val));
+
+        fprintf(body,
+                "# TYPE etherate_%s counter\n"
+                "# HELP etherate_%s %s, all worker threads.\n"
+                "etherate_%s_total %" PRIu64 "\n",
+                counters[i].name, counters[i].name, counters[i].help,
+                counters[i].name, val);
+
+        fprintf(body,
+                "# TYPE etherate_thread_%s counter\n"
+                "# HELP etherate_thread_%s %s, per worker thread.\n",
+                counters[i].name, counters[i].name, counters[i].help);
+
+        for (uint16_t thread = 0; thread < thd_nr; thread += 1) {
+            memcpy(&val, (uint8_t*)&snap->thd[thread] + counters[i].offset, sizeof(val));
+            fprintf(body,
+                    "etherate_thread_%s_total{thread=\"%" PRIu16 "\",tid=\"%" PRIu32 "\","
+                    "interface=\"%s\"} %" PRIu64 "\n",
+                    counters[i].name, thread, snap->thd[thread].thd_id,
+                    eth->sk_opt.if_opt[thd_if_idx(eth, thread)].if_name, val);
+        }
+
+    }
+
+    fprintf(body, "# EOF\n");
+
+}
\ No newline at end of file
@@ -0,0 +1,287 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "pace.h"
+
+static uint32_t pace_burst(struct thd_opt *thd_opt, uint32_t want) {
+
+    if (thd_opt->burst_left == 0) {
+
+        uint64_t until = get_time_ns() + thd_opt->burst_gap;
+
+        // pace_wait() returns at least every DEF_POLL_TIMEO to check for a stop
+        while (get_time_ns() < until) {
+            if (thd_stopping(thd_opt))
+                return 0;
+            pace_wait(until);
+        }
+
+        thd_opt->burst_left = thd_opt->burst_nr;
+
+    }
+
+    uint32_t credit = (want < thd_opt->burst_left ? want : thd_opt->burst_left);
+    thd_opt->burst_left -= credit;
+
+    return credit;
+
+}
+
+
+
+static int32_t pace_burst_init(struct etherate *eth) {
+
+    if (eth->app_opt.sk_mode != SKT_TX && eth->app_opt.sk_mode != SKT_BIDI) {
+        printf("Oops! --burst can only be used in Tx or bidirectional mode.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.tx_rate || eth->app_opt.lat_rate || eth->app_opt.xdp ||
+        eth->app_opt.rfc2544_loss >= 0 || eth->app_opt.bench_path != NULL) {
+        printf("Oops! --burst can't be used with -t, --bench, --latency, "
+               "--rfc2544 or --xdp.\n");
+        return EX_SOFTWARE;
+    }
+
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+
+        struct if_opt *if_opt = &eth->sk_opt.if_opt[if_idx];
+
+        if (eth->app_opt.burst_duty == 0) {
+            if_opt->burst_gap = eth->app_opt.burst_gap;
+        } else {
+
+            uint32_t speed = 0;
+            if (eth->app_opt.sk_type != SKT_DPDK && eth->app_opt.sk_type != SKT_MEMIF)
+                speed = get_if_speed(if_opt->if_name);
+
+            if (speed == 0) {
+                printf("Oops! The link speed of %s isn't known, give the --burst "
+                       "gap in us instead of a duty cycle.\n", if_opt->if_name);
+                return EX_SOFTWARE;
+            }
+
+            // On the wire each frame also has an FCS, preamble and inter-frame gap
+            double burst_ns = (double)eth->app_opt.burst_nr *
+                              (eth->frm_opt.frame_sz + ETH_FCS_LEN + 20) * 8 *
+                              1000 / speed;
+
+            if_opt->burst_gap = (uint64_t)(burst_ns * (100 - eth->app_opt.burst_duty) /
+                                           eth->app_opt.burst_duty);
+
+        }
+
+        printf("Sending bursts of %" PRIu32 " frames with a %.3f us gap on %s.\n",
+               eth->app_opt.burst_nr, if_opt->burst_gap / 1000.0, if_opt->if_name);
+
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static int32_t pace_burst_parse(char *arg, struct etherate *eth) {
+
+    char *end;
+
+    errno = 0;
+    unsigned long long burst_nr = strtoull(arg, &end, 0);
+
+    if (errno || end == arg || *end != ',' || burst_nr == 0 || burst_nr > UINT32_MAX)
+        return EXIT_FAILURE;
+
+    char  *gap_str = end + 1;
+    double gap = strtod(gap_str, &end);
+
+    if (end == gap_str || gap < 0)
+        return EXIT_FAILURE;
+
+    if (*end == '%' && *(end + 1) == '\0') {
+        if (gap == 0 || gap > 100)
+            return EXIT_FAILURE;
+        eth->app_opt.burst_duty = gap;
+        eth->app_opt.burst_gap  = 0;
+    } else if (*end == '\0') {
+        eth->app_opt.burst_duty = 0;
+        eth->app_opt.burst_gap  = (uint64_t)(gap * 1000);
+    } else {
+        return EXIT_FAILURE;
+    }
+
+    eth->app_opt.burst_nr = burst_nr;
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static uint32_t pace_credit(struct thd_opt *thd_opt, uint64_t rate, uint32_t want) {
+
+    uint64_t now = get_time_ns();
+
+    if (rate != thd_opt->pace_rate)
+        pace_rebase(thd_opt, rate, now);
+
+    while (!thd_stopping(thd_opt)) {
+
+        // An idle worker waits for a rate to be set
+        if (rate == PACE_IDLE) {
+            pace_wait(now + DEF_POLL_TIMEO * 1000000ULL);
+            return 0;
+        }
+
+        // The first frame is due as soon as the rate is set
+        uint64_t due = (uint64_t)((double)(now - thd_opt->pace_epoch) * rate / 1000000000) + 1;
+
+        if (due > thd_opt->pace_sent) {
+
+            uint64_t credit = due - thd_opt->pace_sent;
+
+            if (credit <= want) {
+                thd_opt->pace_sent = due;
+                return credit;
+            }
+
+            // Catch up a short delay a batch at a time, drop a longer one
+            if (credit - want > (uint64_t)((double)rate * PACE_LAG / 1000000000)) {
+                thd_opt->pace_epoch = now;
+                thd_opt->pace_sent  = want;
+            } else {
+                thd_opt->pace_sent += want;
+            }
+
+            return want;
+
+        }
+
+        pace_wait(thd_opt->pace_epoch +
+                  (uint64_t)((double)thd_opt->pace_sent * 1000000000 / rate));
+
+        // Pick up a new rate while waiting for a slow one
+        uint64_t new_rate = __atomic_load_n(&thd_opt->tx_rate, __ATOMIC_RELAXED);
+        now = get_time_ns();
+
+        if (new_rate == 0)
+            return want;
+
+        if (new_rate != rate) {
+            rate = new_rate;
+            pace_rebase(thd_opt, rate, now);
+        }
+
+    }
+
+    return 0;
+
+}
+
+
+
+static void pace_rebase(struct thd_opt *thd_opt, uint64_t rate, uint64_t now) {
+
+    double owed = 0;
+
+    // Carry over how far behind or ahead of the old rate the worker was, so
+    // that a rate which changes every few ms neither gains nor loses frames.
+    // pace_credit() still drops what is owed after a long stall.
+    if (thd_opt->pace_rate != 0 && thd_opt->pace_rate != PACE_IDLE && rate != PACE_IDLE) {
+        owed = (double)(now - thd_opt->pace_epoch) * thd_opt->pace_rate / 1000000000 -
+               (double)thd_opt->pace_sent;
+    }
+
+    // Count again from a new epoch, before now when frames are owed
+    thd_opt->pace_rate  = rate;
+    thd_opt->pace_sent  = (owed < 0 ? (uint64_t)ceil(-owed) : 0);
+    thd_opt->pace_epoch = now - (uint64_t)((thd_opt->pace_sent + owed) * 1000000000 / rate);
+
+}
+
+
+
+static void pace_set(struct thd_opt *thd_opt, uint16_t thd_nr, uint64_t rate) {
+
+    // The workers pick up the new rate before their next send
+    for (uint16_t thread = 0; thread < thd_nr; thread += 1) {
+        __atomic_store_n(&thd_opt[thread].tx_rate, pace_share(rate, thread, thd_nr),
+                         __ATOMIC_RELAXED);
+    }
+
+}
+
+
+
+static uint64_t pace_share(uint64_t rate, uint16_t tx_idx, uint16_t tx_nr) {
+
+    if (rate == 0 || rate == PACE_IDLE)
+        return rate;
+
+    // Spread any remainder over the first workers, as with -n
+    uint64_t share = (rate / tx_nr) + (tx_idx < (rate % tx_nr));
+
+    return (share == 0 ? PACE_IDLE : share);
+
+}
+
+
+
+static inline uint32_t pace_tx(struct thd_opt *thd_opt, uint32_t want) {
+
+    if (thd_opt->burst_nr)
+        return pace_burst(thd_opt, want);
+
+    uint64_t rate = __atomic_load_n(&thd_opt->tx_rate, __ATOMIC_RELAXED);
+
+    if (rate == 0)
+        return want;
+
+    return pace_credit(thd_opt, rate, want);
+
+}
+
+
+
+static void pace_wait(uint64_t until) {
+
+    uint64_t now = get_time_ns();
+
+    if (until > now + DEF_POLL_TIMEO * 1000000ULL)
+        until = now + DEF_POLL_TIMEO * 1000000ULL;
+
+    // Sleeping is too coarse for the last few us
+    if (until > now + PACE_SPIN) {
+        uint64_t sleep_ns = until - now - PACE_SPIN;
+        nanosleep(&(struct timespec){ .tv_sec  = sleep_ns / 1000000000ULL,
+                                      .tv_nsec = sleep_ns % 1000000000ULL }, NULL);
+    }
+
+    while (get_time_ns() < until)
+        ;
+
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _PACE_H_
+#define _PACE_H_
+
+/*
+ * Tx rate limiter. Each Tx worker has its own rate in frames per second in
+ * thd_opt->tx_rate, written by the main thread at any time and read with a
+ * relaxed atomic load before every send or ring fill, so a new rate takes
+ * effect within one batch without any locking. The worker asks pace_tx()
+ * how many of the frames it has ready it may send now, which waits until
+ * at least one is due.
+ *
+ * The frames due are counted from the time the rate was last changed, so
+ * the rate doesn't drift with the time spent in the send calls, and a rate
+ * change carries over how far behind or ahead the worker was. A worker
+ * which falls behind by up to PACE_LAG catches up a batch at a time, after
+ * a longer stall (a full ring, a blocked send) the missed frames are not
+ * sent as a burst.
+ *
+ * With --burst a Tx worker instead sends burst_nr frames as fast as it can
+ * and then idles for burst_gap ns, timed from when the last send of the
+ * burst returned. pace_tx() never grants more than is left of the burst, so
+ * a burst fits into one sendmmsg() call or ring kick when -m or the ring is
+ * big enough. Each worker bursts on its own, the bursts of several workers
+ * on one interface are not aligned.
+ */
+
+#define PACE_IDLE   UINT64_MAX // tx_rate value for a worker that sends nothing
+#define PACE_LAG    1000000    // ns of missed frames a worker sends to catch up
+#define PACE_SPIN   50000      // ns before a frame is due to stop sleeping and spin
+
+// Return how many of want frames are left in the burst, after the gap if none are
+static uint32_t pace_burst(struct thd_opt *thd_opt, uint32_t want);
+
+// Check the --burst options and work out each interface's gap from the duty cycle
+static int32_t pace_burst_init(struct etherate *eth);
+
+// Parse the --burst value <frames>,<gap us> or <frames>,<duty cycle>%
+static int32_t pace_burst_parse(char *arg, struct etherate *eth);
+
+// Wait for a due frame and return how many of want frames may be sent
+static uint32_t pace_credit(struct thd_opt *thd_opt, uint64_t rate, uint32_t want);
+
+// Switch to a new rate, keeping the frames owed or sent early at the old one
+static void pace_rebase(struct thd_opt *thd_opt, uint64_t rate, uint64_t now);
+
+// Split a total rate in frames per second between thd_nr Tx workers, 0 for no limit
+// and PACE_IDLE to send nothing
+static void pace_set(struct thd_opt *thd_opt, uint16_t thd_nr, uint64_t rate);
+
+// Return the share of a total rate for Tx worker tx_idx of tx_nr
+static uint64_t pace_share(uint64_t rate, uint16_t tx_idx, uint16_t tx_nr);
+
+// Return how many of want frames may be sent now, want if there is no limit
+static inline uint32_t pace_tx(struct thd_opt *thd_opt, uint32_t want);
+
+// Sleep and then spin until the time in ns, or for at most DEF_POLL_TIMEO
+static void pace_wait(uint64_t until);
+
+#endif // _PACE_H_
\ No newline at end of file
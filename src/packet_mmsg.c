@@ -56,6 +56,10 @@ void *mmsg_init(void* thd_opt_p) {
         }
     }
 
+    if (thd_alloc_bufs(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
     if (mmsg_sock(thd_opt) != EXIT_SUCCESS) {
         pthread_exit((void*)EXIT_FAILURE);
     }
@@ -67,6 +71,9 @@ void *mmsg_init(void* thd_opt_p) {
     }
 
 
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
     pthread_cleanup_pop(0);
     return NULL;
 
@@ -79,44 +86,83 @@ void mmsg_rx(struct thd_opt *thd_opt) {
     int32_t rx_frames = 0;
 
     struct mmsghdr mmsg_hdr[thd_opt->msgvec_vlen];
-    struct iovec iov[thd_opt->msgvec_vlen];
+    struct iovec iov[thd_opt->msgvec_vlen][2];
     memset(mmsg_hdr, 0, sizeof(mmsg_hdr));
     memset(iov, 0, sizeof(iov));
 
+    // In mesh and latency mode the start of each frame is kept apart so that
+    // every frame's flow ID (and probe timestamp) can be read, the rest of
+    // the frames share rx_buffer
+    uint8_t  mesh_hdr[thd_opt->msgvec_vlen][LAT_HDR_LEN];
+    uint8_t  mesh_iov = (thd_opt->mesh_rx != NULL || thd_opt->lat_rx != NULL ||
+                         thd_opt->rfc2544_rx);
+    uint32_t mesh_len = (thd_opt->lat_rx != NULL ? LAT_HDR_LEN : FLOW_ID_OFF + sizeof(uint32_t));
+
     thd_opt->started = 1;
 
     for (uint32_t i = 0; i < thd_opt->msgvec_vlen; i += 1) {
-        iov[i].iov_base = thd_opt->rx_buffer;
-        iov[i].iov_len = thd_opt->frame_sz;
-        mmsg_hdr[i].msg_hdr.msg_iov = &iov[i];
-        mmsg_hdr[i].msg_hdr.msg_iovlen = 1;
+        if (mesh_iov) {
+            iov[i][0].iov_base = mesh_hdr[i];
+            iov[i][0].iov_len = mesh_len;
+            iov[i][1].iov_base = thd_opt->rx_buffer;
+            iov[i][1].iov_len = thd_opt->frame_sz - mesh_len;
+        } else {
+            iov[i][0].iov_base = thd_opt->rx_buffer;
+            iov[i][0].iov_len = thd_opt->frame_sz;
+        }
+        mmsg_hdr[i].msg_hdr.msg_iov = iov[i];
+        mmsg_hdr[i].msg_hdr.msg_iovlen = (mesh_iov ? 2 : 1);
         mmsg_hdr[i].msg_hdr.msg_name = NULL;
         mmsg_hdr[i].msg_hdr.msg_control = NULL;
         mmsg_hdr[i].msg_hdr.msg_controllen = 0;
     }
 
+    // Once stopped, keep reading without blocking until the socket is empty,
+    // or for at most DEF_DRAIN_TIMEO under steady inbound traffic
+    int32_t  flags = 0;
+    uint64_t drain_end = 0;
+
+    // Don't hold a probe back until the rest of the vector has arrived
+    int32_t wait_one = (thd_opt->lat_rx != NULL ? MSG_WAITFORONE : 0);
+
     while(1) {
 
+        if (!flags && thd_stopping(thd_opt)) {
+            flags = MSG_DONTWAIT;
+            drain_end = get_time_ns() + (DEF_DRAIN_TIMEO * 1000000ULL);
+        } else if (flags && get_time_ns() >= drain_end) {
+            break;
+        }
+
         /*
-         recvmmsg() returns the number of frames sent or -1 on error.
+         recvmmsg() returns the number of frames received or -1 on error.
          If some frames have been received in the vector and then an
-         error occurs, recvmmsg returns -1. For the received frames
-         msg_len is updated.
+         error occurs, recvmmsg returns the number received and the error
+         is returned by the next call. Only the first rx_frames entries
+         have msg_len updated.
         */
         rx_frames = recvmmsg(
-            thd_opt->sock, mmsg_hdr, thd_opt->msgvec_vlen, 0, NULL
+            thd_opt->sock, mmsg_hdr, thd_opt->msgvec_vlen, flags | wait_one, NULL
         );
-        
+
         if (rx_frames == -1) {
-            thd_opt->sk_err += 1;
+            if (errno != EAGAIN && errno != EINTR)
+                thd_opt->sk_err += 1;
+            if (flags)
+                break;
+            continue;
         }
 
-        for (uint32_t i = 0; i < thd_opt->msgvec_vlen; i+= 1) {
-            if (mmsg_hdr[i].msg_len > 0) {
-                thd_opt->rx_bytes += mmsg_hdr[i].msg_len;
-                thd_opt->rx_frms += 1;
-            }
+        for (int32_t i = 0; i < rx_frames; i+= 1) {
+            thd_opt->rx_bytes += mmsg_hdr[i].msg_len;
+            if (thd_opt->mesh_rx != NULL)
+                mesh_rx(thd_opt, mesh_hdr[i], mmsg_hdr[i].msg_len);
+            if (thd_opt->lat_rx != NULL)
+                lat_rx(thd_opt, mesh_hdr[i], mmsg_hdr[i].msg_len, 0);
+            if (thd_opt->rfc2544_rx)
+                rfc2544_rx(thd_opt, mesh_hdr[i], mmsg_hdr[i].msg_len);
         }
+        thd_opt->rx_frms += rx_frames;
 
     }
 
@@ -167,6 +213,19 @@ int32_t mmsg_sock(struct thd_opt *thd_opt) {
     }
 
 
+    // Don't block indefinitely so that stop requests are noticed
+    if (sock_op(S_O_TIMEO, thd_opt) == -1) {
+        tperror(thd_opt, "Can't set socket Tx/Rx timeout");
+        return EXIT_FAILURE;
+    }
+
+    // Only count frames which arrived on the wire
+    if (thd_opt->ign_out && sock_op(S_O_IGN_OUT, thd_opt) == -1) {
+        tperror(thd_opt, "Can't ignore outgoing frames on socket");
+        return EXIT_FAILURE;
+    }
+
+
     // Join this socket to the fanout group
     if (thd_opt->thd_nr > 1) {
 
@@ -217,7 +276,18 @@ void mmsg_tx(struct thd_opt *thd_opt) {
     }
 
 
-    while (1) {
+    uint32_t vlen = thd_opt->msgvec_vlen;
+
+    while (!thd_stopping(thd_opt)) {
+
+        // Don't send past this thread's share of the frame limit
+        if (thd_opt->frm_lim && thd_opt->frm_lim - thd_opt->tx_frms < vlen)
+            vlen = thd_opt->frm_lim - thd_opt->tx_frms;
+
+        // Only send the frames due under -t
+        uint32_t batch = pace_tx(thd_opt, vlen);
+        if (batch == 0)
+            continue;
 
         /*
          When using sendmmsg() to send a batch of frames, unlike PACKET_MMAP,
@@ -229,17 +299,19 @@ void mmsg_tx(struct thd_opt *thd_opt) {
          0 frames were sent.
         */
 
-        tx_frames = sendmmsg(thd_opt->sock, mmsg_hdr, thd_opt->msgvec_vlen, 0);
+        tx_frames = sendmmsg(thd_opt->sock, mmsg_hdr, batch, 0);
 
         if (tx_frames == -1) {
-            thd_opt->sk_err += 1;
+            if (errno != EAGAIN && errno != EINTR)
+                thd_opt->sk_err += 1;
         } else {
-            ///// TODO
-            ///// No need to check frame size if all frames are the same size?
-            for (uint32_t i = 0; i < thd_opt->msgvec_vlen; i+= 1) {
+            // Only the first tx_frames entries were sent
+            for (int32_t i = 0; i < tx_frames; i+= 1) {
                 thd_opt->tx_bytes += mmsg_hdr[i].msg_len;
             }
             thd_opt->tx_frms += tx_frames;
+            if (thd_opt->tx_frms == thd_opt->frm_lim)
+                break;
         }
 
     }
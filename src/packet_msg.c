@@ -56,6 +56,10 @@ void *msg_init(void* thd_opt_p) {
         }
     }
 
+    if (thd_alloc_bufs(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
     if (msg_sock(thd_opt) != EXIT_SUCCESS) {
         pthread_exit((void*)EXIT_FAILURE);
     }
@@ -67,6 +71,9 @@ void *msg_init(void* thd_opt_p) {
     }
 
 
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
     pthread_cleanup_pop(0);
     return NULL;
 
@@ -95,19 +102,42 @@ void msg_rx(struct thd_opt *thd_opt) {
     thd_opt->started = 1;
 
 
-    while(1) {
+    while(!thd_stopping(thd_opt)) {
 
         rx_bytes = recvmsg(thd_opt->sock, &msg_hdr, 0);
         
         if (rx_bytes == -1) {
-            thd_opt->sk_err += 1;
+            if (errno != EAGAIN && errno != EINTR)
+                thd_opt->sk_err += 1;
         } else {
             thd_opt->rx_bytes += rx_bytes;
             thd_opt->rx_frms += 1;            
+            if (thd_opt->mesh_rx != NULL)
+                mesh_rx(thd_opt, thd_opt->rx_buffer, rx_bytes);
+            if (thd_opt->lat_rx != NULL)
+                lat_rx(thd_opt, thd_opt->rx_buffer, rx_bytes, 0);
+            if (thd_opt->rfc2544_rx)
+                rfc2544_rx(thd_opt, thd_opt->rx_buffer, rx_bytes);
         }
 
     }
 
+    // Count any frames already queued on the socket, for a limited time as
+    // it never empties under steady inbound traffic
+    uint64_t drain_end = get_time_ns() + (DEF_DRAIN_TIMEO * 1000000ULL);
+
+    while(get_time_ns() < drain_end &&
+          (rx_bytes = recvmsg(thd_opt->sock, &msg_hdr, MSG_DONTWAIT)) != -1) {
+        thd_opt->rx_bytes += rx_bytes;
+        thd_opt->rx_frms += 1;
+        if (thd_opt->mesh_rx != NULL)
+            mesh_rx(thd_opt, thd_opt->rx_buffer, rx_bytes);
+        if (thd_opt->lat_rx != NULL)
+            lat_rx(thd_opt, thd_opt->rx_buffer, rx_bytes, 0);
+        if (thd_opt->rfc2544_rx)
+            rfc2544_rx(thd_opt, thd_opt->rx_buffer, rx_bytes);
+    }
+
 }
 
 
@@ -154,6 +184,19 @@ int32_t msg_sock(struct thd_opt *thd_opt) {
     }
 
 
+    // Don't block indefinitely so that stop requests are noticed
+    if (sock_op(S_O_TIMEO, thd_opt) == -1) {
+        tperror(thd_opt, "Can't set socket Tx/Rx timeout");
+        return EXIT_FAILURE;
+    }
+
+    // Only count frames which arrived on the wire
+    if (thd_opt->ign_out && sock_op(S_O_IGN_OUT, thd_opt) == -1) {
+        tperror(thd_opt, "Can't ignore outgoing frames on socket");
+        return EXIT_FAILURE;
+    }
+
+
     // Join this socket to the fanout group
     if (thd_opt->thd_nr > 1) {
 
@@ -192,15 +235,22 @@ void msg_tx(struct thd_opt *thd_opt) {
 
     thd_opt->started = 1;
 
-    while (1) {
+    while (!thd_stopping(thd_opt)) {
+
+        // Wait for the next frame to be due under -t
+        if (pace_tx(thd_opt, 1) == 0)
+            continue;
 
         tx_bytes = sendmsg(thd_opt->sock, &msg_hdr, 0);
 
         if (tx_bytes == -1) {
-            thd_opt->sk_err += 1;
+            if (errno != EAGAIN && errno != EINTR)
+                thd_opt->sk_err += 1;
         } else {
             thd_opt->tx_bytes += tx_bytes;
             thd_opt->tx_frms += 1;
+            if (thd_opt->tx_frms == thd_opt->frm_lim)
+                break;
         }
 
     }
@@ -33,27 +33,20 @@ void *print_stats(void *etherate_p) {
 
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
-    struct   etherate *eth = etherate_p;
-    uint64_t duration      = 0;
-    uint64_t rx_bytes      = 0;
-    uint64_t rx_bytes_now  = 0;
-    uint64_t rx_bytes_prev = 0;
-    uint64_t rx_drops      = 0; // This is clear-on-read, delta since last read
-    uint64_t rx_frms_now   = 0;
-    uint64_t rx_frms_prev  = 0;
-    uint64_t rx_pps        = 0;
-    uint64_t rx_qfrz       = 0; // This is clear-on-read, delta since last read
-    uint64_t sk_err        = 0;
-    uint64_t sk_err_now    = 0;
-    uint64_t sk_err_prev   = 0;
-    uint64_t tx_bytes      = 0;
-    uint64_t tx_bytes_now  = 0;
-    uint64_t tx_bytes_prev = 0;
-    uint64_t tx_frms_now   = 0;
-    uint64_t tx_frms_prev  = 0;
-    uint64_t tx_pps        = 0;
-    double   rx_gbps       = 0;
-    double   tx_gbps       = 0;
+    struct   etherate *eth  = etherate_p;
+    struct   stat_opt *stat_opt = &eth->stat_opt;
+    uint16_t thd_nr         = eth->app_opt.thd_nr;
+    struct   thd_stats *now = &stat_opt->now[thd_nr];
+    struct   thd_stats *prev = &stat_opt->prev[thd_nr];
+    uint64_t rx_bytes       = 0;
+    uint64_t rx_drops       = 0;
+    uint64_t rx_pps         = 0;
+    uint64_t rx_qfrz        = 0;
+    uint64_t sk_err         = 0;
+    uint64_t tx_bytes       = 0;
+    uint64_t tx_pps         = 0;
+    double   rx_gbps        = 0;
+    double   tx_gbps        = 0;
 
     // Wait for one of the Tx/Rx tworker hreads to start, otherwise this thread
     // will be printing all zero's every second
@@ -61,8 +54,10 @@ void *print_stats(void *etherate_p) {
     while (waiting) {
         for(uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread++) {
             if (eth->thd_opt[thread].started == 1) waiting = 0;
-            /////if (eth->thd_opt[thread].quit == 1) pthread_exit((void*)EXIT_SUCCESS);
         }
+        // No worker started before they were all stopped
+        if (__atomic_load_n(&stat_opt->done, __ATOMIC_RELAXED))
+            pthread_exit((void*)EXIT_SUCCESS);
     }
 
 
@@ -70,48 +65,106 @@ void *print_stats(void *etherate_p) {
     sleep(1);
 
 
+    if (stat_opt->fmt == STATS_FMT_CSV) {
+        fprintf(stat_opt->out, "interval,time,thread,tid,rx_bps,rx_fps,tx_bps,"
+                "tx_fps,errors,drops,freezes,rx_share,rx_skew,rollovers,"
+                "rollovers_huge,rollovers_failed,interface\n");
+    }
+
+
     // main loop:
     while(1) {
 
-        rx_bytes_now = 0;
-        rx_drops     = 0;
-        rx_frms_now  = 0;
-        rx_qfrz      = 0;
-        sk_err_now   = 0;
-        tx_bytes_now = 0;
-        tx_frms_now  = 0;
+        stats_sample(eth);
 
+        if (eth->app_opt.mesh)
+            mesh_sample(eth);
 
-        for(uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread++) {
 
-            // Check if the worker threads are still running
-            if (eth->thd_opt[thread].quit == 1) pthread_exit((void*)EXIT_SUCCESS);
+        stats_snap_publish(eth);
 
-            rx_bytes_now += eth->thd_opt[thread].rx_bytes;
-            rx_frms_now  += eth->thd_opt[thread].rx_frms;
-            sk_err_now   += eth->thd_opt[thread].sk_err;
-            tx_bytes_now += eth->thd_opt[thread].tx_bytes;
-            tx_frms_now  += eth->thd_opt[thread].tx_frms;
+        if (stat_opt->shm_buf != NULL)
+            shm_stats_publish(eth);
 
-            if (eth->thd_opt[thread].stalling) {
-                printf("%" PRIu32 ":Socket is stalling!\n", eth->thd_opt[thread].thd_id);
-                eth->thd_opt[thread].stalling = 0;
-            }
 
+        rx_bytes = now->rx_bytes - prev->rx_bytes;
+        rx_drops = now->rx_drops - prev->rx_drops;
+        rx_qfrz  = now->rx_qfrz  - prev->rx_qfrz;
+        rx_pps   = now->rx_frms  - prev->rx_frms;
+        sk_err   = now->sk_err   - prev->sk_err;
+        tx_bytes = now->tx_bytes - prev->tx_bytes;
+        tx_pps   = now->tx_frms  - prev->tx_frms;
+
+        rx_gbps = ((double)(rx_bytes*8)/1000/1000/1000);
+        tx_gbps = ((double)(tx_bytes*8)/1000/1000/1000);
+
+
+        if (stat_opt->fmt == STATS_FMT_JSON) {
+            print_stats_json(eth);
+        } else if (stat_opt->fmt == STATS_FMT_CSV) {
+            print_stats_csv(eth);
+        } else if(eth->app_opt.verbose) {
+            printf("%" PRIu64 ".\tRx: %.2f Gbps (%" PRIu64 " fps) %" PRIu64 " Drops %" PRIu64 " Q-Freeze\tTx: %.2f Gbps (%" PRIu64 " fps)\tErr: %" PRIu64 "\n",
+                   stat_opt->duration, rx_gbps, rx_pps, rx_drops, rx_qfrz, tx_gbps, tx_pps, sk_err);
+        } else {
+            printf("%" PRIu64 ".\tRx: %.2f Gbps (%" PRIu64 " fps)\tTx: %.2f Gbps (%" PRIu64 " fps)\n",
+                   stat_opt->duration, rx_gbps, rx_pps, tx_gbps, tx_pps);
+        }
 
-            // There are no special or different stats available in the Tx direction
-            if(eth->thd_opt[thread].sk_mode == SKT_RX) {
+        if (eth->app_opt.mesh && eth->app_opt.verbose && stat_opt->fmt == STATS_FMT_TEXT)
+            mesh_print(eth, 0);
 
-                // struct tpacket_stats for TPACKET V2
-                if (eth->app_opt.sk_mode == SKT_PACKET_MMAP2) {
 
-                    tpacket_v2_stats(&eth->thd_opt[thread], &rx_drops);
+        // The aggregate hides one fanout socket doing all the work, so show
+        // each worker's share of its interface's Rx frames and flag an imbalance
+        if (stat_opt->fmt == STATS_FMT_TEXT) {
 
-                // struct tpacket_stats_v3 for TPACKET V3
-                } else if (eth->app_opt.sk_mode == SKT_PACKET_MMAP3) {
+            for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
 
-                    tpacket_v3_stats(&eth->thd_opt[thread], &rx_drops, &rx_qfrz);
+                uint64_t if_pps = stats_rx_if(eth, if_idx, stat_opt->now, stat_opt->prev);
 
+                if (eth->sk_opt.if_opt[if_idx].rx_nr < 2 || if_pps == 0)
+                    continue;
+
+                double   skew = stats_rx_skew_if(eth, if_idx, stat_opt->now, stat_opt->prev);
+                uint64_t busiest_pps = 0;
+                uint32_t busiest = 0;
+                uint64_t roll = 0, roll_fail = 0, roll_huge = 0;
+
+                if (eth->app_opt.verbose) {
+                    if (eth->sk_opt.if_nr > 1)
+                        printf("\t%s", eth->sk_opt.if_opt[if_idx].if_name);
+                    printf("\tRx share:");
+                }
+
+                for (uint16_t thread = 0; thread < thd_nr; thread += 1) {
+                    if (eth->thd_opt[thread].if_idx != if_idx ||
+                        eth->thd_opt[thread].sk_mode == SKT_TX)
+                        continue;
+                    uint64_t thd_pps = stat_opt->now[thread].rx_frms - stat_opt->prev[thread].rx_frms;
+                    roll      += stat_opt->now[thread].rx_roll - stat_opt->prev[thread].rx_roll;
+                    roll_fail += stat_opt->now[thread].rx_roll_fail - stat_opt->prev[thread].rx_roll_fail;
+                    roll_huge += stat_opt->now[thread].rx_roll_huge - stat_opt->prev[thread].rx_roll_huge;
+                    if (thd_pps >= busiest_pps) {
+                        busiest_pps = thd_pps;
+                        busiest = eth->thd_opt[thread].thd_id;
+                    }
+                    if (eth->app_opt.verbose)
+                        printf(" %.1f%%", ((double)thd_pps / if_pps) * 100);
+                }
+
+                if (eth->app_opt.verbose) {
+                    printf(", skew %.2f", skew);
+                    if (roll || roll_fail)
+                        printf(", rollover %" PRIu64 " (%" PRIu64 " huge, %" PRIu64 " failed)",
+                               roll, roll_huge, roll_fail);
+                    printf("\n");
+                }
+
+                if (skew > DEF_SKEW_WARN && if_pps >= DEF_SKEW_MIN) {
+                    printf("Warning: Rx fanout on %s is unbalanced (skew %.2f), %" PRIu32 " has %.1f%% of the frames\n",
+                           eth->sk_opt.if_opt[if_idx].if_name, skew, busiest,
+                           ((double)busiest_pps / if_pps) * 100);
                 }
 
             }
@@ -119,38 +172,550 @@ void *print_stats(void *etherate_p) {
         }
 
 
-        rx_bytes = rx_bytes_now - rx_bytes_prev;
-        rx_drops = rx_drops;   //// ????
-        rx_qfrz  = rx_qfrz;    //// ????
-        rx_pps   = rx_frms_now  - rx_frms_prev;
-        sk_err   = sk_err_now - sk_err_prev;
-        tx_bytes = tx_bytes_now - tx_bytes_prev;
-        tx_pps   = tx_frms_now  - tx_frms_prev;
+        if (stat_opt->hist != NULL) {
 
-        rx_gbps = ((double)(rx_bytes*8)/1000/1000/1000);
-        tx_gbps = ((double)(tx_bytes*8)/1000/1000/1000);
+            hist_add(eth, rx_bytes, rx_pps, tx_bytes, tx_pps, sk_err,
+                     rx_drops, rx_qfrz);
 
+            if (stat_opt->hist_dump) {
+                stat_opt->hist_dump = 0;
+                if (hist_dump(stat_opt->hist, stat_opt->hist_csv) == EXIT_SUCCESS)
+                    printf("Rate history written to %s\n", stat_opt->hist_csv);
+            }
 
-        if(eth->app_opt.verbose) {
-            printf("%" PRIu64 ".\tRx: %.2f Gbps (%" PRIu64 " fps) %" PRIu64 " Drops %" PRIu64 " Q-Freeze\tTx: %.2f Gbps (%" PRIu64 " fps)\tErr: %" PRIu64 "\n",
-                   duration, rx_gbps, rx_pps, rx_drops, rx_qfrz, tx_gbps, tx_pps, sk_err);
-        } else {
-            printf("%" PRIu64 ".\tRx: %.2f Gbps (%" PRIu64 " fps)\tTx: %.2f Gbps (%" PRIu64 " fps)\n",
-                   duration, rx_gbps, rx_pps, tx_gbps, tx_pps);
         }
 
 
-        rx_bytes_prev = rx_bytes_now;
-        rx_frms_prev  = rx_frms_now;
-        sk_err_prev   = sk_err_now;
-        tx_bytes_prev = tx_bytes_now;
-        tx_frms_prev  = tx_frms_now;
+        stats_sum_add(&stat_opt->rx_fps, (double)rx_pps);
+        stats_sum_add(&stat_opt->rx_gbps, rx_gbps);
+        stats_sum_add(&stat_opt->tx_fps, (double)tx_pps);
+        stats_sum_add(&stat_opt->tx_gbps, tx_gbps);
+
+        memcpy(stat_opt->prev, stat_opt->now, sizeof(struct thd_stats) * (thd_nr + 1));
 
-        duration += 1;
+        stat_opt->duration += 1;
 
-        sleep(1);
+        // Sleep for one interval, waking early once the workers have drained
+        for (uint8_t tick = 0; tick < 10; tick += 1) {
+            if (__atomic_load_n(&stat_opt->done, __ATOMIC_RELAXED))
+                break;
+            nanosleep(&(struct timespec){ .tv_sec = 0, .tv_nsec = 100000000L }, NULL);
+        }
 
-        ///// On thread quit print min/max/avg in Gbps and pps, also total GBs/TBs transfered?
+        // Take a final sample of the drained counters for the summary, the
+        // partial interval isn't added to the per-second rates
+        if (__atomic_load_n(&stat_opt->done, __ATOMIC_RELAXED)) {
+            stats_sample(eth);
+            if (eth->app_opt.mesh)
+                mesh_sample(eth);
+            stats_snap_publish(eth);
+            if (stat_opt->shm_buf != NULL)
+                shm_stats_publish(eth);
+            pthread_exit((void*)EXIT_SUCCESS);
+        }
 
     } // while(1)
-}
\ No newline at end of file
+}
+
+
+
+void print_stats_csv(struct etherate *eth) {
+
+    struct   stat_opt *stat_opt = &eth->stat_opt;
+    uint64_t now_s = (uint64_t)time(NULL);
+
+    // The last entry is the aggregate of all threads
+    for (uint16_t thread = 0; thread <= eth->app_opt.thd_nr; thread += 1) {
+
+        struct thd_stats *now  = &stat_opt->now[thread];
+        struct thd_stats *prev = &stat_opt->prev[thread];
+
+        if (thread < eth->app_opt.thd_nr) {
+            fprintf(stat_opt->out, "%" PRIu64 ",%" PRIu64 ",%" PRIu16 ",%" PRIu32 ",",
+                    stat_opt->duration, now_s, thread, eth->thd_opt[thread].thd_id);
+        } else {
+            fprintf(stat_opt->out, "%" PRIu64 ",%" PRIu64 ",total,,",
+                    stat_opt->duration, now_s);
+        }
+
+        fprintf(stat_opt->out,
+                "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ","
+                "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",",
+                (now->rx_bytes - prev->rx_bytes) * 8,
+                now->rx_frms - prev->rx_frms,
+                (now->tx_bytes - prev->tx_bytes) * 8,
+                now->tx_frms - prev->tx_frms,
+                now->sk_err - prev->sk_err,
+                now->rx_drops - prev->rx_drops,
+                now->rx_qfrz - prev->rx_qfrz);
+
+        // A worker's share is of its interface's Rx frames, the skew only
+        // applies to the total row
+        if (thread < eth->app_opt.thd_nr) {
+            uint64_t if_pps = stats_rx_if(eth, eth->thd_opt[thread].if_idx,
+                                          stat_opt->now, stat_opt->prev);
+            fprintf(stat_opt->out, "%.4f,,",
+                    if_pps ? (double)(now->rx_frms - prev->rx_frms) / if_pps : 0);
+        } else {
+            fprintf(stat_opt->out, "%.4f,%.4f,", (now->rx_frms - prev->rx_frms) ? 1.0 : 0,
+                    stats_rx_skew(eth, stat_opt->now, stat_opt->prev));
+        }
+
+        fprintf(stat_opt->out, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%s\n",
+                now->rx_roll - prev->rx_roll,
+                now->rx_roll_huge - prev->rx_roll_huge,
+                now->rx_roll_fail - prev->rx_roll_fail,
+                (thread < eth->app_opt.thd_nr ?
+                 (char*)eth->sk_opt.if_opt[eth->thd_opt[thread].if_idx].if_name : ""));
+
+    }
+
+    fflush(stat_opt->out);
+
+}
+
+
+
+void print_stats_json(struct etherate *eth) {
+
+    struct stat_opt *stat_opt = &eth->stat_opt;
+
+    fprintf(stat_opt->out,
+            "{\"interval\":%" PRIu64 ",\"time\":%" PRIu64 ",\"threads\":[",
+            stat_opt->duration, (uint64_t)time(NULL));
+
+    // The last entry is the aggregate of all threads
+    for (uint16_t thread = 0; thread <= eth->app_opt.thd_nr; thread += 1) {
+
+        struct thd_stats *now  = &stat_opt->now[thread];
+        struct thd_stats *prev = &stat_opt->prev[thread];
+
+        if (thread < eth->app_opt.thd_nr) {
+            fprintf(stat_opt->out, "%s{\"thread\":%" PRIu16 ",\"tid\":%" PRIu32 ","
+                    "\"interface\":\"%s\",",
+                    (thread > 0 ? "," : ""), thread, eth->thd_opt[thread].thd_id,
+                    eth->sk_opt.if_opt[eth->thd_opt[thread].if_idx].if_name);
+        } else {
+            fprintf(stat_opt->out, "],\"total\":{");
+        }
+
+        fprintf(stat_opt->out,
+                "\"rx_bps\":%" PRIu64 ",\"rx_fps\":%" PRIu64 ","
+                "\"tx_bps\":%" PRIu64 ",\"tx_fps\":%" PRIu64 ","
+                "\"errors\":%" PRIu64 ",\"drops\":%" PRIu64 ",\"freezes\":%" PRIu64 ","
+                "\"rollovers\":%" PRIu64 ",\"rollovers_huge\":%" PRIu64 ","
+                "\"rollovers_failed\":%" PRIu64 ",",
+                (now->rx_bytes - prev->rx_bytes) * 8,
+                now->rx_frms - prev->rx_frms,
+                (now->tx_bytes - prev->tx_bytes) * 8,
+                now->tx_frms - prev->tx_frms,
+                now->sk_err - prev->sk_err,
+                now->rx_drops - prev->rx_drops,
+                now->rx_qfrz - prev->rx_qfrz,
+                now->rx_roll - prev->rx_roll,
+                now->rx_roll_huge - prev->rx_roll_huge,
+                now->rx_roll_fail - prev->rx_roll_fail);
+
+        if (thread < eth->app_opt.thd_nr) {
+            uint64_t if_pps = stats_rx_if(eth, eth->thd_opt[thread].if_idx,
+                                          stat_opt->now, stat_opt->prev);
+            fprintf(stat_opt->out, "\"rx_share\":%.4f}",
+                    if_pps ? (double)(now->rx_frms - prev->rx_frms) / if_pps : 0);
+        } else {
+            fprintf(stat_opt->out, "\"rx_skew\":%.4f}",
+                    stats_rx_skew(eth, stat_opt->now, stat_opt->prev));
+        }
+
+    }
+
+    fprintf(stat_opt->out, "}\n");
+    fflush(stat_opt->out);
+
+}
+
+
+
+void print_stats_summary(struct etherate *eth) {
+
+    struct stat_opt  *stat_opt = &eth->stat_opt;
+    struct stat_sum  *sums[4]  = { &stat_opt->rx_gbps, &stat_opt->rx_fps,
+                                   &stat_opt->tx_gbps, &stat_opt->tx_fps };
+    const char       *names[4] = { "rx_gbps", "rx_fps", "tx_gbps", "tx_fps" };
+
+    // Nothing was sampled if the workers never started
+    if (stat_opt->now == NULL || stat_opt->duration == 0)
+        return;
+
+    // The totals are the final counters, sampled after the workers drained
+    struct thd_stats *total = &stat_opt->now[eth->app_opt.thd_nr];
+
+
+    if (stat_opt->fmt == STATS_FMT_JSON) {
+
+        fprintf(stat_opt->out, "{\"summary\":{\"duration\":%" PRIu64, stat_opt->duration);
+
+        for (uint8_t i = 0; i < 4; i += 1) {
+            fprintf(stat_opt->out,
+                    ",\"%s\":{\"min\":%.6f,\"max\":%.6f,\"mean\":%.6f,\"stddev\":%.6f}",
+                    names[i], sums[i]->min, sums[i]->max, sums[i]->mean,
+                    stats_sum_stddev(sums[i]));
+        }
+
+        fprintf(stat_opt->out, ",\"threads\":[");
+
+        for (uint16_t thread = 0; thread <= eth->app_opt.thd_nr; thread += 1) {
+
+            struct thd_stats *thd = &stat_opt->now[thread];
+
+            if (thread < eth->app_opt.thd_nr) {
+                fprintf(stat_opt->out, "%s{\"thread\":%" PRIu16 ",\"tid\":%" PRIu32 ",",
+                        (thread > 0 ? "," : ""), thread, eth->thd_opt[thread].thd_id);
+            } else {
+                fprintf(stat_opt->out, "],\"total\":{");
+            }
+
+            fprintf(stat_opt->out,
+                    "\"rx_bytes\":%" PRIu64 ",\"rx_frames\":%" PRIu64 ","
+                    "\"tx_bytes\":%" PRIu64 ",\"tx_frames\":%" PRIu64 ","
+                    "\"errors\":%" PRIu64 ",\"drops\":%" PRIu64 ",\"freezes\":%" PRIu64 "}",
+                    thd->rx_bytes, thd->rx_frms, thd->tx_bytes, thd->tx_frms,
+                    thd->sk_err, thd->rx_drops, thd->rx_qfrz);
+
+        }
+
+        fprintf(stat_opt->out, ",\"interfaces\":[");
+
+        for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+
+            struct thd_stats if_tot;
+            stats_if_total(eth, if_idx, &if_tot);
+
+            fprintf(stat_opt->out,
+                    "%s{\"interface\":\"%s\",\"threads\":%" PRIu16 ","
+                    "\"rx_bytes\":%" PRIu64 ",\"rx_frames\":%" PRIu64 ","
+                    "\"tx_bytes\":%" PRIu64 ",\"tx_frames\":%" PRIu64 ","
+                    "\"errors\":%" PRIu64 ",\"drops\":%" PRIu64 ",\"freezes\":%" PRIu64 ","
+                    "\"rx_skew\":%.4f}",
+                    (if_idx > 0 ? "," : ""), eth->sk_opt.if_opt[if_idx].if_name,
+                    eth->sk_opt.if_opt[if_idx].thd_nr,
+                    if_tot.rx_bytes, if_tot.rx_frms, if_tot.tx_bytes, if_tot.tx_frms,
+                    if_tot.sk_err, if_tot.rx_drops, if_tot.rx_qfrz,
+                    stats_rx_skew_if(eth, if_idx, stat_opt->now, NULL));
+
+        }
+
+        fprintf(stat_opt->out, "],\"rx_skew\":%.4f}}\n",
+                stats_rx_skew(eth, stat_opt->now, NULL));
+        fflush(stat_opt->out);
+
+        if (eth->app_opt.mesh)
+            mesh_print(eth, 1);
+
+        return;
+
+    }
+
+
+    printf("Summary over %" PRIu64 " seconds:\n", stat_opt->duration);
+
+    printf("Rx: min %.2f Gbps (%.0f fps), max %.2f Gbps (%.0f fps), "
+           "mean %.2f Gbps (%.0f fps), stddev %.2f Gbps (%.0f fps)\n",
+           stat_opt->rx_gbps.min, stat_opt->rx_fps.min,
+           stat_opt->rx_gbps.max, stat_opt->rx_fps.max,
+           stat_opt->rx_gbps.mean, stat_opt->rx_fps.mean,
+           stats_sum_stddev(&stat_opt->rx_gbps), stats_sum_stddev(&stat_opt->rx_fps));
+
+    printf("Tx: min %.2f Gbps (%.0f fps), max %.2f Gbps (%.0f fps), "
+           "mean %.2f Gbps (%.0f fps), stddev %.2f Gbps (%.0f fps)\n",
+           stat_opt->tx_gbps.min, stat_opt->tx_fps.min,
+           stat_opt->tx_gbps.max, stat_opt->tx_fps.max,
+           stat_opt->tx_gbps.mean, stat_opt->tx_fps.mean,
+           stats_sum_stddev(&stat_opt->tx_gbps), stats_sum_stddev(&stat_opt->tx_fps));
+
+    // Per-thread totals show if one worker is starved compared to the others
+    if (eth->app_opt.thd_nr > 1) {
+        for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+            struct thd_stats *thd = &stat_opt->now[thread];
+            printf("%" PRIu32 ":Rx %" PRIu64 " frames (%" PRIu64 " bytes), "
+                   "Tx %" PRIu64 " frames (%" PRIu64 " bytes), Err %" PRIu64 "\n",
+                   eth->thd_opt[thread].thd_id, thd->rx_frms, thd->rx_bytes,
+                   thd->tx_frms, thd->tx_bytes, thd->sk_err);
+        }
+
+        // Per-interface totals when the workers are spread over several
+        if (eth->sk_opt.if_nr > 1) {
+            for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+                struct thd_stats if_tot;
+                stats_if_total(eth, if_idx, &if_tot);
+                printf("%s: Rx %" PRIu64 " frames (%" PRIu64 " bytes) %" PRIu64 " Drops, "
+                       "Tx %" PRIu64 " frames (%" PRIu64 " bytes), Err %" PRIu64 "\n",
+                       eth->sk_opt.if_opt[if_idx].if_name, if_tot.rx_frms, if_tot.rx_bytes,
+                       if_tot.rx_drops, if_tot.tx_frms, if_tot.tx_bytes, if_tot.sk_err);
+            }
+        }
+
+        if (total->rx_frms > 0) {
+            printf("Rx skew over the run: %.2f", stats_rx_skew(eth, stat_opt->now, NULL));
+            if (total->rx_roll || total->rx_roll_fail)
+                printf(", rollover %" PRIu64 " (%" PRIu64 " huge, %" PRIu64 " failed)",
+                       total->rx_roll, total->rx_roll_huge, total->rx_roll_fail);
+            printf("\n");
+        }
+    }
+
+    printf("Total: Rx %" PRIu64 " frames (%" PRIu64 " bytes) %" PRIu64 " Drops "
+           "%" PRIu64 " Q-Freeze, Tx %" PRIu64 " frames (%" PRIu64 " bytes), "
+           "Err %" PRIu64 "\n",
+           total->rx_frms, total->rx_bytes, total->rx_drops, total->rx_qfrz,
+           total->tx_frms, total->tx_bytes, total->sk_err);
+
+    if (eth->app_opt.mesh)
+        mesh_print(eth, 1);
+
+}
+
+
+
+void stats_if_total(struct etherate *eth, uint16_t if_idx, struct thd_stats *if_tot) {
+
+    memset(if_tot, 0, sizeof(struct thd_stats));
+
+    for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+
+        struct thd_stats *thd = &eth->stat_opt.now[thread];
+
+        if (eth->thd_opt[thread].if_idx != if_idx)
+            continue;
+
+        if_tot->rx_bytes += thd->rx_bytes;
+        if_tot->rx_drops += thd->rx_drops;
+        if_tot->rx_frms  += thd->rx_frms;
+        if_tot->rx_qfrz  += thd->rx_qfrz;
+        if_tot->sk_err   += thd->sk_err;
+        if_tot->tx_bytes += thd->tx_bytes;
+        if_tot->tx_frms  += thd->tx_frms;
+
+    }
+
+}
+
+
+
+void stats_rollover(struct thd_opt *thd_opt, struct thd_stats *thd_now) {
+
+    struct tpacket_rollover_stats roll_stats;
+    memset(&roll_stats, 0, sizeof(roll_stats));
+
+    // Unlike PACKET_STATISTICS these counters aren't cleared on read
+    socklen_t stats_len = sizeof(roll_stats);
+    if (getsockopt(thd_opt->sock, SOL_PACKET, PACKET_ROLLOVER_STATS, &roll_stats, &stats_len) < 0)
+        return;
+
+    thd_now->rx_roll      = roll_stats.tp_all;
+    thd_now->rx_roll_fail = roll_stats.tp_failed;
+    thd_now->rx_roll_huge = roll_stats.tp_huge;
+
+}
+
+
+
+uint64_t stats_rx_if(struct etherate *eth, uint16_t if_idx, struct thd_stats *now, struct thd_stats *prev) {
+
+    uint64_t rx_frms = 0;
+
+    for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+        if (eth->thd_opt[thread].if_idx == if_idx)
+            rx_frms += now[thread].rx_frms - (prev ? prev[thread].rx_frms : 0);
+    }
+
+    return rx_frms;
+
+}
+
+
+
+double stats_rx_skew(struct etherate *eth, struct thd_stats *now, struct thd_stats *prev) {
+
+    double skew = 0;
+
+    // Report the worst balanced interface
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+        double if_skew = stats_rx_skew_if(eth, if_idx, now, prev);
+        if (if_skew > skew)
+            skew = if_skew;
+    }
+
+    return skew;
+
+}
+
+
+
+double stats_rx_skew_if(struct etherate *eth, uint16_t if_idx, struct thd_stats *now, struct thd_stats *prev) {
+
+    // Only the Rx workers are in the fanout group
+    uint16_t thd_nr = eth->sk_opt.if_opt[if_idx].rx_nr;
+    double   mean   = 0;
+    double   var    = 0;
+
+    if (thd_nr == 0)
+        return 0;
+
+    mean = (double)stats_rx_if(eth, if_idx, now, prev) / thd_nr;
+    if (mean == 0)
+        return 0;
+
+    for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+        if (eth->thd_opt[thread].if_idx != if_idx ||
+            eth->thd_opt[thread].sk_mode == SKT_TX)
+            continue;
+        double diff = (double)(now[thread].rx_frms - (prev ? prev[thread].rx_frms : 0)) - mean;
+        var += diff * diff;
+    }
+
+    // 0 is a perfect balance, sqrt(thd_nr - 1) is every frame on one socket
+    return sqrt(var / thd_nr) / mean;
+
+}
+
+
+
+void stats_sample(struct etherate *eth) {
+
+    struct   stat_opt *stat_opt = &eth->stat_opt;
+    struct   thd_stats *now = &stat_opt->now[eth->app_opt.thd_nr];
+
+    memset(now, 0, sizeof(struct thd_stats));
+
+
+    for(uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread++) {
+
+        struct thd_stats *thd_now = &stat_opt->now[thread];
+
+        // In XDP mode the frames are counted in a BPF map, not by the worker
+        if (eth->thd_opt[thread].xdp_map > 0 && !eth->thd_opt[thread].quit)
+            xdp_sample(&eth->thd_opt[thread]);
+
+        thd_now->thd_id   = eth->thd_opt[thread].thd_id;
+        thd_now->rx_bytes = eth->thd_opt[thread].rx_bytes;
+        thd_now->rx_frms  = eth->thd_opt[thread].rx_frms;
+        thd_now->sk_err   = eth->thd_opt[thread].sk_err;
+        thd_now->tx_bytes = eth->thd_opt[thread].tx_bytes;
+        thd_now->tx_frms  = eth->thd_opt[thread].tx_frms;
+
+        if (eth->thd_opt[thread].stalling) {
+            printf("%" PRIu32 ":Socket is stalling!\n", eth->thd_opt[thread].thd_id);
+            eth->thd_opt[thread].stalling = 0;
+        }
+
+
+        // There are no special or different stats available in the Tx direction,
+        // and a worker which failed has already closed its socket
+        if(eth->thd_opt[thread].sk_mode == SKT_RX && !eth->thd_opt[thread].quit) {
+
+            // struct tpacket_stats for TPACKET V2
+            if (eth->app_opt.sk_type == SKT_PACKET_MMAP2) {
+
+                tpacket_v2_stats(&eth->thd_opt[thread], &thd_now->rx_drops);
+
+            // struct tpacket_stats_v3 for TPACKET V3
+            } else if (eth->app_opt.sk_type == SKT_PACKET_MMAP3) {
+
+                tpacket_v3_stats(&eth->thd_opt[thread], &thd_now->rx_drops, &thd_now->rx_qfrz);
+
+            }
+
+            // Only sockets in a fanout group with rollover enabled have these
+            if (eth->thd_opt[thread].thd_nr > 1 &&
+                (eth->thd_opt[thread].fanout_type == PACKET_FANOUT_ROLLOVER ||
+                 (eth->thd_opt[thread].fanout_flags & PACKET_FANOUT_FLAG_ROLLOVER)))
+                stats_rollover(&eth->thd_opt[thread], thd_now);
+
+        }
+
+        now->rx_bytes += thd_now->rx_bytes;
+        now->rx_drops += thd_now->rx_drops;
+        now->rx_frms  += thd_now->rx_frms;
+        now->rx_qfrz  += thd_now->rx_qfrz;
+        now->rx_roll  += thd_now->rx_roll;
+        now->rx_roll_fail += thd_now->rx_roll_fail;
+        now->rx_roll_huge += thd_now->rx_roll_huge;
+        now->sk_err   += thd_now->sk_err;
+        now->tx_bytes += thd_now->tx_bytes;
+        now->tx_frms  += thd_now->tx_frms;
+
+    }
+
+}
+
+
+
+void stats_snap_publish(struct etherate *eth) {
+
+    struct stat_snap *snap = &eth->stat_opt.snap;
+    uint32_t seq = snap->seq;
+
+    // Only the stats thread writes, so a plain read of seq is fine here
+    __atomic_store_n(&snap->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(snap->thd, eth->stat_opt.now,
+           sizeof(struct thd_stats) * (eth->app_opt.thd_nr + 1));
+    snap->duration = eth->stat_opt.duration;
+    snap->time     = (uint64_t)time(NULL);
+
+    __atomic_store_n(&snap->seq, seq + 2, __ATOMIC_RELEASE);
+
+}
+
+
+
+void stats_snap_read(struct etherate *eth, struct stat_snap *copy) {
+
+    struct stat_snap *snap = &eth->stat_opt.snap;
+    uint32_t seq;
+
+    do {
+
+        seq = __atomic_load_n(&snap->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;
+
+        memcpy(copy->thd, snap->thd,
+               sizeof(struct thd_stats) * (eth->app_opt.thd_nr + 1));
+        copy->duration = snap->duration;
+        copy->time     = snap->time;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    } while ((seq & 1) || seq != __atomic_load_n(&snap->seq, __ATOMIC_RELAXED));
+
+    copy->seq = seq;
+
+}
+
+
+
+void stats_sum_add(struct stat_sum *sum, double val) {
+
+    sum->samples += 1;
+
+    if (sum->samples == 1 || val < sum->min) sum->min = val;
+    if (sum->samples == 1 || val > sum->max) sum->max = val;
+
+    // Welford's method, stable without keeping every sample
+    double delta = val - sum->mean;
+    sum->mean += delta / (double)sum->samples;
+    sum->m2   += delta * (val - sum->mean);
+
+}
+
+
+
+double stats_sum_stddev(struct stat_sum *sum) {
+
+    if (sum->samples == 0)
+        return 0;
+
+    return sqrt(sum->m2 / (double)sum->samples);
+
+}
@@ -31,4 +31,43 @@
 // Aggregate per-thread stats and print every second
 static void *print_stats(void *etherate_p);
 
+// Print one CSV row per thread and one for the aggregate for this interval
+static void print_stats_csv(struct etherate *eth);
+
+// Print one JSON object holding per-thread and aggregate stats for this interval
+static void print_stats_json(struct etherate *eth);
+
+// Print the min/max/mean/stddev rates and totals for the whole run
+static void print_stats_summary(struct etherate *eth);
+
+// Sum the final counters of an interface's workers into if_tot
+static void stats_if_total(struct etherate *eth, uint16_t if_idx, struct thd_stats *if_tot);
+
+// Read the cumulative PACKET_ROLLOVER_STATS of a worker's socket
+static void stats_rollover(struct thd_opt *thd_opt, struct thd_stats *thd_now);
+
+// Return the Rx frames of an interface's workers since prev (or since start if NULL)
+static uint64_t stats_rx_if(struct etherate *eth, uint16_t if_idx, struct thd_stats *now, struct thd_stats *prev);
+
+// Return the highest Rx skew of any interface since prev (or since start if NULL)
+static double stats_rx_skew(struct etherate *eth, struct thd_stats *now, struct thd_stats *prev);
+
+// Return the coefficient of variation of an interface's per-worker Rx frames since prev
+static double stats_rx_skew_if(struct etherate *eth, uint16_t if_idx, struct thd_stats *now, struct thd_stats *prev);
+
+// Read the per-thread counters into stat_opt->now and sum them into the aggregate
+static void stats_sample(struct etherate *eth);
+
+// Publish the current counters to the lock-free snapshot
+static void stats_snap_publish(struct etherate *eth);
+
+// Take a consistent copy of the lock-free snapshot, copy->thd must hold thd_nr+1 entries
+static void stats_snap_read(struct etherate *eth, struct stat_snap *copy);
+
+// Add a per-interval rate to a running min/max/mean/variance
+static void stats_sum_add(struct stat_sum *sum, double val);
+
+// Return the standard deviation of the rates added to sum
+static double stats_sum_stddev(struct stat_sum *sum);
+
 #endif // _PRINT_STATS_H_
\ No newline at end of file
@@ -0,0 +1,337 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "probe.h"
+
+static int32_t probe_engine(struct etherate *eth) {
+
+    // Best first, used to break ties and when Rx sees no traffic. -p5 isn't
+    // tried as it counts the frames the driver drops as sent
+    const uint8_t rank[] = {
+        SKT_PACKET_MMAP3, SKT_PACKET_MMAP2, SKT_SENDMMSG,
+        SKT_SENDMSG, SKT_PACKET
+    };
+
+    uint32_t kernel_ver = probe_kernel_ver();
+    printf("Running Kernel is %" PRIu32 ".%" PRIu32 ".%" PRIu32
+           ", probing the send/receive methods for %.1f seconds each:\n",
+           kernel_ver >> 16, (kernel_ver >> 8) & 0xff, kernel_ver & 0xff,
+           (PROBE_WARM_MS + PROBE_RUN_MS) / 1000.0);
+
+    // Every Tx socket asks for this, without it the trials include the qdisc
+    uint8_t qdisc_bypass = 0;
+    #if defined(PACKET_QDISC_BYPASS)
+    int32_t sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (sock != -1) {
+        int32_t bypass = 1;
+        qdisc_bypass = (setsockopt(sock, SOL_PACKET, PACKET_QDISC_BYPASS,
+                                   &bypass, sizeof(bypass)) == 0);
+        close(sock);
+    }
+    #endif
+    if (eth->app_opt.sk_mode != SKT_RX && !qdisc_bypass)
+        printf("PACKET_QDISC_BYPASS isn't supported, Tx frames go through the qdisc.\n");
+
+    uint8_t  best = SKT_AUTO;
+    uint64_t best_fps = 0;
+    uint8_t  first = SKT_AUTO;
+
+    for (uint8_t idx = 0; idx < sizeof(rank); idx += 1) {
+
+        uint8_t sk_type = rank[idx];
+
+        if (!probe_feature(eth, sk_type)) {
+            printf("  -p%" PRIu8 " %s: not supported\n", sk_type, probe_name(sk_type));
+            continue;
+        }
+
+        struct   probe_res res;
+        uint64_t fps = 0;
+        int32_t  ret = probe_trial(eth, sk_type, 1, PROBE_WARM_MS, PROBE_RUN_MS, &res);
+
+        if (ret == EXIT_SUCCESS)
+            fps = res.frms * 1000000000ULL / res.ns;
+
+        if (eth->app_opt.stop)
+            return EXIT_FAILURE;
+
+        // The fallback must at least open its socket or ring
+        if (first == SKT_AUTO && ret == EXIT_SUCCESS)
+            first = sk_type;
+
+        printf("  -p%" PRIu8 " %s: %" PRIu64 " fps\n", sk_type, probe_name(sk_type), fps);
+
+        if (fps > best_fps) {
+            best = sk_type;
+            best_fps = fps;
+        }
+
+    }
+
+    if (best == SKT_AUTO && first == SKT_AUTO) {
+        printf("Oops! None of the send/receive methods work on %s.\n",
+               eth->sk_opt.if_opt[0].if_name);
+        return EXIT_FAILURE;
+    }
+
+    if (best == SKT_AUTO) {
+        best = first;
+        printf("No frames were received, using -p%" PRIu8 " (%s).\n", best, probe_name(best));
+    } else {
+        printf("Using -p%" PRIu8 " (%s), the fastest.\n", best, probe_name(best));
+    }
+
+    eth->app_opt.sk_type = best;
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static uint8_t probe_feature(struct etherate *eth, uint8_t sk_type) {
+
+    uint32_t kernel_ver = probe_kernel_ver();
+
+    // The multi-message syscalls are looked for rather than the version,
+    // a bad fd gives EBADF if they exist
+    if (sk_type == SKT_SENDMMSG) {
+        if (eth->app_opt.sk_mode != SKT_TX &&
+            recvmmsg(-1, NULL, 0, 0, NULL) == -1 && errno == ENOSYS)
+            return 0;
+        if (sendmmsg(-1, NULL, 0, 0) == -1 && errno == ENOSYS)
+            return 0;
+        return 1;
+    }
+
+    if (sk_type != SKT_PACKET_MMAP2 && sk_type != SKT_PACKET_MMAP3)
+        return 1;
+
+
+    // The ring versions are only in this binary if its headers had them
+    int32_t version;
+    if (sk_type == SKT_PACKET_MMAP2) {
+        #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,17)
+        version = TPACKET_V2;
+        #else
+        return 0;
+        #endif
+    } else {
+        #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,2,0)
+        version = TPACKET_V3;
+        #else
+        return 0;
+        #endif
+        // af_packet.c: packet_set_ring() rejects a v3 Tx ring before 4.11
+        if (eth->app_opt.sk_mode != SKT_RX && kernel_ver != 0 &&
+            kernel_ver < KERNEL_VERSION(4,11,0))
+            return 0;
+    }
+
+    int32_t sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (sock == -1)
+        return 0;
+
+    int32_t ret = setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version));
+    close(sock);
+
+    return (ret == 0);
+
+}
+
+
+
+static uint32_t probe_kernel_ver(void) {
+
+    struct   utsname uts;
+    uint32_t version = 0;
+    uint32_t patch_level = 0;
+    uint32_t sub_level = 0;
+
+    if (uname(&uts) == -1 ||
+        sscanf(uts.release, "%" SCNu32 ".%" SCNu32 ".%" SCNu32,
+               &version, &patch_level, &sub_level) < 2)
+        return 0;
+
+    // KERNEL_VERSION() only has 8 bits for the sub level
+    if (sub_level > 255)
+        sub_level = 255;
+
+    return KERNEL_VERSION(version, patch_level, sub_level);
+
+}
+
+
+
+static const char *probe_name(uint8_t sk_type) {
+
+    switch (sk_type) {
+        case SKT_PACKET:       return "send()/read()";
+        case SKT_PACKET_MMAP2: return "PACKET_MMAP v2 rings";
+        case SKT_SENDMSG:      return "sendmsg()/recvmsg()";
+        case SKT_SENDMMSG:     return "sendmmsg()/recvmmsg()";
+        case SKT_PACKET_MMAP3: return "PACKET_MMAP v3 rings";
+        case SKT_XDP_LIVE:     return "XDP live frames";
+        case SKT_DPDK:         return "DPDK";
+        case SKT_TAP:          return "TAP queues";
+        case SKT_MEMIF:        return "shared memory rings";
+        default:               return "unknown";
+    }
+
+}
+
+
+
+static int32_t probe_trial(struct etherate *eth, uint8_t sk_type, uint16_t thd_nr,
+                           uint32_t warm_ms, uint32_t run_ms, struct probe_res *res) {
+
+    const struct timespec interval = {
+        .tv_sec  = 0,
+        .tv_nsec = DEF_MON_INTERVAL * 1000000L
+    };
+    uint64_t byte_lim = eth->app_opt.byte_lim;
+    uint64_t frm_lim = eth->app_opt.frm_lim;
+    uint8_t  sk_type_was = eth->app_opt.sk_type;
+    uint16_t spawned = 0;
+    int32_t  ret = EXIT_FAILURE;
+
+    memset(res, 0, sizeof(struct probe_res));
+
+    // Counts the cycles of the workers as they are started after it, -1 if
+    // the CPU or hypervisor has no cycle counter
+    struct perf_event_attr pe;
+    memset(&pe, 0, sizeof(pe));
+    pe.type       = PERF_TYPE_HARDWARE;
+    pe.size       = sizeof(pe);
+    pe.config     = PERF_COUNT_HW_CPU_CYCLES;
+    pe.inherit    = 1;
+    pe.exclude_hv = 1;
+    int32_t cycles_fd = syscall(SYS_perf_event_open, &pe, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+
+    struct rusage ru_start;
+    getrusage(RUSAGE_SELF, &ru_start);
+
+    // The trial frames don't count towards the limits
+    eth->app_opt.byte_lim = 0;
+    eth->app_opt.frm_lim  = 0;
+    eth->app_opt.sk_type  = sk_type;
+
+    for (uint16_t thread = 0; thread < thd_nr; thread += 1) {
+
+        pthread_attr_init(&eth->app_opt.thd_attr[thread]);
+        pthread_attr_setdetachstate(&eth->app_opt.thd_attr[thread], PTHREAD_CREATE_JOINABLE);
+
+        if (thd_setup(eth, thread) != EXIT_SUCCESS) {
+            thd_cleanup(&eth->thd_opt[thread]);
+            break;
+        }
+
+        if (thd_init_worker(eth, thread) != EXIT_SUCCESS) {
+            thd_cleanup(&eth->thd_opt[thread]);
+            break;
+        }
+
+        spawned += 1;
+
+    }
+
+    eth->app_opt.byte_lim = byte_lim;
+    eth->app_opt.frm_lim  = frm_lim;
+    eth->app_opt.sk_type  = sk_type_was;
+
+
+    // Worker 0 is a Tx worker in bidi mode
+    uint64_t warm = get_time_ns() + warm_ms * 1000000ULL;
+    uint64_t end = warm + run_ms * 1000000ULL;
+    uint64_t base_bytes = 0;
+    uint64_t base_frms = 0;
+    uint64_t base_ns = 0;
+    uint8_t  failed = (spawned < thd_nr);
+
+    while (!failed && !eth->app_opt.stop && get_time_ns() < end) {
+
+        for (uint16_t thread = 0; thread < spawned; thread += 1) {
+            if (eth->thd_opt[thread].quit)
+                failed = 1;
+        }
+
+        if (!base_ns && get_time_ns() >= warm) {
+            for (uint16_t thread = 0; thread < spawned; thread += 1) {
+                base_bytes += eth->thd_opt[thread].rx_bytes + eth->thd_opt[thread].tx_bytes;
+                base_frms += eth->thd_opt[thread].rx_frms + eth->thd_opt[thread].tx_frms;
+            }
+            base_ns = get_time_ns();
+        }
+
+        nanosleep(&interval, NULL);
+
+    }
+
+    if (!failed && !eth->app_opt.stop && base_ns) {
+        res->ns = get_time_ns() - base_ns;
+        for (uint16_t thread = 0; thread < spawned; thread += 1) {
+            res->bytes += eth->thd_opt[thread].rx_bytes + eth->thd_opt[thread].tx_bytes;
+            res->frms += eth->thd_opt[thread].rx_frms + eth->thd_opt[thread].tx_frms;
+        }
+        res->bytes -= base_bytes;
+        res->frms -= base_frms;
+        ret = EXIT_SUCCESS;
+    }
+
+    for (uint16_t thread = 0; thread < spawned; thread += 1)
+        thd_stop(&eth->thd_opt[thread]);
+
+    for (uint16_t thread = 0; thread < spawned; thread += 1) {
+        struct thd_opt *thd_opt = &eth->thd_opt[thread];
+        pthread_join(eth->app_opt.thd[thread], NULL);
+        res->all_frms += thd_opt->rx_frms + thd_opt->tx_frms;
+        thd_cleanup(thd_opt);
+        memset(thd_opt, 0, sizeof(struct thd_opt));
+    }
+
+
+    // The exited workers' cycles and CPU time have been added to this thread's
+    struct rusage ru_end;
+    getrusage(RUSAGE_SELF, &ru_end);
+    res->cpu_ns = (ru_end.ru_utime.tv_sec - ru_start.ru_utime.tv_sec +
+                   ru_end.ru_stime.tv_sec - ru_start.ru_stime.tv_sec) * 1000000000ULL +
+                  (ru_end.ru_utime.tv_usec - ru_start.ru_utime.tv_usec +
+                   ru_end.ru_stime.tv_usec - ru_start.ru_stime.tv_usec) * 1000LL;
+
+    if (cycles_fd != -1) {
+        if (read(cycles_fd, &res->cycles, sizeof(res->cycles)) != sizeof(res->cycles))
+            res->cycles = 0;
+        close(cycles_fd);
+    }
+
+    // Let worker 0 join the fanout groups first again
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1)
+        eth->sk_opt.if_opt[if_idx].fanout_turn = 0;
+
+    return ret;
+
+}
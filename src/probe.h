@@ -0,0 +1,70 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _PROBE_H_
+#define _PROBE_H_
+
+/*
+ * Engine auto-selection (-p auto). The running Kernel is checked for what
+ * each engine needs, rather than the headers the binary was built with,
+ * then every engine left runs alone on worker 0 for a short trial with the
+ * chosen mode, interface and frame size, and the fastest is used for the
+ * test. In Tx and bidi mode the trials send real frames, in Rx mode they
+ * count the traffic already arriving and without any the engines are
+ * ranked in a fixed order instead.
+ */
+
+#define PROBE_RUN_MS  2000     // Measured part of each trial
+#define PROBE_WARM_MS 500      // Start of each trial which isn't measured
+
+// Result of one trial, the counts are the sum of all its workers
+struct probe_res {
+    uint64_t all_frms;         // Frames over the whole trial, including warm-up
+    uint64_t bytes;            // Bytes during the measured part
+    uint64_t cpu_ns;           // CPU time used over the whole trial
+    uint64_t cycles;           // CPU cycles used over the whole trial, 0 if unknown
+    uint64_t frms;             // Frames during the measured part
+    uint64_t ns;               // Length of the measured part
+};
+
+// Check the Kernel features, run a trial of each usable engine and set sk_type
+static int32_t probe_engine(struct etherate *eth);
+
+// Return 1 if the running Kernel supports the engine in this mode
+static uint8_t probe_feature(struct etherate *eth, uint8_t sk_type);
+
+// Return the running Kernel version as KERNEL_VERSION() or 0 if unknown
+static uint32_t probe_kernel_ver(void);
+
+// Return a short description of an engine
+static const char *probe_name(uint8_t sk_type);
+
+// Run the engine on workers 0 to thd_nr-1, fails if any worker stops early
+static int32_t probe_trial(struct etherate *eth, uint8_t sk_type, uint16_t thd_nr,
+                           uint32_t warm_ms, uint32_t run_ms, struct probe_res *res);
+
+#endif // _PROBE_H_
\ No newline at end of file
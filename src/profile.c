@@ -0,0 +1,307 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "profile.h"
+
+static int32_t prof_add(struct prof *prof, double secs, double rate) {
+
+    if (!isfinite(secs) || !isfinite(rate) || secs < 0 || rate < 0 ||
+        rate >= (double)PACE_IDLE)
+        return EXIT_FAILURE;
+
+    if (prof->pt_nr && secs < prof->pts[prof->pt_nr - 1].secs)
+        return EXIT_FAILURE;
+
+    // Double the array each time it fills up
+    if ((prof->pt_nr & (prof->pt_nr - 1)) == 0) {
+        struct prof_pt *pts = realloc(prof->pts, (prof->pt_nr ? prof->pt_nr * 2 : 1) *
+                                                 sizeof(struct prof_pt));
+        if (pts == NULL) {
+            perror("Can't allocate rate profile");
+            return EXIT_FAILURE;
+        }
+        prof->pts = pts;
+    }
+
+    prof->pts[prof->pt_nr].rate = rate;
+    prof->pts[prof->pt_nr].secs = secs;
+    prof->pt_nr += 1;
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static int32_t prof_load(struct prof *prof, const char *path) {
+
+    char     line[PROF_CSV_LINE];
+    uint32_t line_nr = 0;
+    int32_t  ret = EXIT_SUCCESS;
+
+    FILE *csv = fopen(path, "r");
+    if (csv == NULL) {
+        printf("Oops! Can't open rate profile %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    while (fgets(line, sizeof(line), csv) != NULL) {
+
+        double nums[2];
+        char   *pos = line + strspn(line, " \t");
+
+        line_nr += 1;
+        pos[strcspn(pos, "\r\n")] = '\0';
+
+        if (*pos == '\0' || *pos == '#')
+            continue;
+
+        // The first line may name the columns
+        if (prof_nums(pos, nums, 2) != 2) {
+            if (line_nr == 1)
+                continue;
+            ret = EXIT_FAILURE;
+        } else {
+            ret = prof_add(prof, nums[0], nums[1]);
+        }
+
+        if (ret != EXIT_SUCCESS) {
+            printf("Oops! Line %" PRIu32 " of %s isn't <secs>,<fps> in time order.\n",
+                   line_nr, path);
+            break;
+        }
+
+    }
+
+    fclose(csv);
+
+    if (ret == EXIT_SUCCESS && prof->pt_nr == 0) {
+        printf("Oops! %s has no <secs>,<fps> lines.\n", path);
+        ret = EXIT_FAILURE;
+    }
+
+    // -d 0 means no limit, so a profile ending at 0 seconds would never stop
+    if (ret == EXIT_SUCCESS && prof->pts[prof->pt_nr - 1].secs == 0) {
+        printf("Oops! The rate profile in %s must end after 0 seconds.\n", path);
+        ret = EXIT_FAILURE;
+    }
+
+    return ret;
+
+}
+
+
+
+static int32_t prof_nums(const char *arg, double *nums, int32_t max) {
+
+    const char *pos = arg;
+    char       *end;
+    int32_t    nr = 0;
+
+    while (nr < max) {
+
+        nums[nr] = strtod(pos, &end);
+        if (end == pos)
+            return -1;
+
+        nr += 1;
+
+        if (*end == '\0')
+            return nr;
+        if (*end != ',')
+            return -1;
+
+        pos = end + 1;
+
+    }
+
+    return -1;
+
+}
+
+
+
+static int32_t prof_parse(struct prof *prof, const char *spec) {
+
+    prof->type = PROF_PTS;
+
+    if (strncmp(spec, "ramp:", 5) != 0 && strncmp(spec, "step:", 5) != 0 &&
+        strncmp(spec, "sine:", 5) != 0)
+        return prof_load(prof, spec);
+
+    // A formula has fewer numbers than characters
+    int32_t max = strlen(spec);
+    double  *nums = calloc(max, sizeof(double));
+    int32_t ret = EXIT_FAILURE;
+
+    if (nums == NULL) {
+        perror("Can't allocate rate profile");
+        return EXIT_FAILURE;
+    }
+
+    int32_t nr = prof_nums(spec + 5, nums, max);
+
+    if (strncmp(spec, "ramp:", 5) == 0) {
+
+        if (nr == 3 && nums[2] > 0 && prof_add(prof, 0, nums[0]) == EXIT_SUCCESS)
+            ret = prof_add(prof, nums[2], nums[1]);
+
+    } else if (strncmp(spec, "step:", 5) == 0) {
+
+        if (nr >= 2 && nums[0] > 0) {
+            ret = EXIT_SUCCESS;
+            for (int32_t step = 1; step < nr && ret == EXIT_SUCCESS; step += 1) {
+                ret = prof_add(prof, (step - 1) * nums[0], nums[step]);
+                if (ret == EXIT_SUCCESS)
+                    ret = prof_add(prof, step * nums[0], nums[step]);
+            }
+        }
+
+    } else if (nr == 3 && isfinite(nums[0]) && isfinite(nums[1]) && isfinite(nums[2]) &&
+               nums[0] >= 0 && nums[0] <= nums[1] && nums[1] < (double)PACE_IDLE &&
+               nums[2] > 0) {
+
+        prof->type   = PROF_SINE;
+        prof->min    = nums[0];
+        prof->max    = nums[1];
+        prof->period = nums[2];
+        ret = EXIT_SUCCESS;
+
+    }
+
+    free(nums);
+
+    if (ret != EXIT_SUCCESS)
+        printf("Oops! Invalid rate profile %s.\n", spec);
+
+    return ret;
+
+}
+
+
+
+static uint64_t prof_rate(struct prof *prof, uint64_t ns) {
+
+    double secs = ns / 1000000000.0;
+    double rate;
+
+    // A sine starts at its lowest rate
+    if (prof->type == PROF_SINE) {
+        rate = prof->min + (prof->max - prof->min) *
+               (1 - cos(2 * M_PI * secs / prof->period)) / 2;
+        return (uint64_t)(rate + 0.5);
+    }
+
+    rate = prof->pts[prof->pt_nr - 1].rate;
+
+    if (secs <= prof->pts[0].secs) {
+        rate = prof->pts[0].rate;
+    } else {
+        // Points at the same time are skipped, so b->secs > a->secs
+        for (uint32_t pt = 1; pt < prof->pt_nr; pt += 1) {
+            struct prof_pt *a = &prof->pts[pt - 1];
+            struct prof_pt *b = &prof->pts[pt];
+            if (secs < b->secs) {
+                rate = a->rate + (b->rate - a->rate) * (secs - a->secs) / (b->secs - a->secs);
+                break;
+            }
+        }
+    }
+
+    return (uint64_t)(rate + 0.5);
+
+}
+
+
+
+static int32_t prof_setup(struct etherate *eth) {
+
+    if (eth->app_opt.sk_mode != SKT_TX && eth->app_opt.sk_mode != SKT_BIDI) {
+        printf("Oops! --profile can only be used in Tx or bidirectional mode.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.tx_rate || eth->app_opt.burst_nr || eth->app_opt.lat_rate ||
+        eth->app_opt.xdp || eth->app_opt.rfc2544_loss >= 0 ||
+        eth->app_opt.bench_path != NULL) {
+        printf("Oops! --profile can't be used with -t, --bench, --burst, --latency, "
+               "--rfc2544 or --xdp.\n");
+        return EX_SOFTWARE;
+    }
+
+    eth->app_opt.prof = calloc(1, sizeof(struct prof));
+    if (eth->app_opt.prof == NULL) {
+        perror("Can't allocate rate profile");
+        return EXIT_FAILURE;
+    }
+
+    struct prof *prof = eth->app_opt.prof;
+
+    if (prof_parse(prof, eth->app_opt.prof_spec) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    if (prof->type == PROF_SINE) {
+        printf("Tx rate follows a sine from %.0f to %.0f fps, %.1f seconds per period.\n",
+               prof->min, prof->max, prof->period);
+    } else {
+
+        double end = prof->pts[prof->pt_nr - 1].secs;
+
+        // Stop at the end of the profile unless -d holds the last rate for longer
+        if (!eth->app_opt.dur_lim)
+            eth->app_opt.dur_lim = (uint64_t)ceil(end);
+
+        printf("Tx rate follows a profile of %" PRIu32 " points over %.1f seconds.\n",
+               prof->pt_nr, end);
+
+    }
+
+    // The workers start at the rate of time 0, thd_monitor() moves them on
+    prof->rate = prof_rate(prof, 0);
+    eth->app_opt.tx_rate = (prof->rate ? prof->rate : PACE_IDLE);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static void prof_tick(struct etherate *eth, uint64_t ns) {
+
+    uint64_t rate = prof_rate(eth->app_opt.prof, ns);
+
+    if (rate == eth->app_opt.prof->rate)
+        return;
+
+    eth->app_opt.prof->rate = rate;
+
+    // In Tx mode every worker sends, in bidi mode the first tx_nr
+    pace_set(eth->thd_opt,
+             (eth->app_opt.tx_nr ? eth->app_opt.tx_nr : eth->app_opt.thd_nr),
+             (rate ? rate : PACE_IDLE));
+
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+/*
+ * Tx rate profiles (--profile <spec>). The total Tx rate follows a shape
+ * over time instead of the flat -t rate:
+ *
+ *   ramp:<from>,<to>,<secs>    From <from> to <to> fps over <secs> seconds
+ *   step:<secs>,<fps>[,<fps>]  Each rate in turn for <secs> seconds
+ *   sine:<min>,<max>,<secs>    Between <min> and <max> fps, <secs> per period
+ *   <file>                     CSV lines of <secs>,<fps>
+ *
+ * The rate between two points of a ramp, step or CSV profile is
+ * interpolated, two points with the same time give a step, and after the
+ * last point its rate is held. Without -d the test stops at the last point,
+ * a sine runs until -d or Ctrl+C. Time 0 is when the first worker starts.
+ *
+ * Every DEF_MON_INTERVAL thd_monitor() works out the current rate and
+ * publishes each Tx worker's share with pace_set(), so the workers pick it
+ * up lock-free before their next send (see pace.h).
+ */
+
+#define PROF_CSV_LINE  256        // Longest line of a CSV profile
+#define PROF_PTS       0          // Profile of points, interpolated
+#define PROF_SINE      1          // Sine wave profile
+
+// One point of a ramp, step or CSV profile
+struct prof_pt {
+    double   rate;               // Frames per second
+    double   secs;               // Time since the start
+};
+
+// A parsed --profile
+struct prof {
+    double   max;                // Highest rate of a sine
+    double   min;                // Lowest rate of a sine
+    double   period;             // Seconds per sine period
+    struct   prof_pt *pts;
+    uint32_t pt_nr;
+    uint64_t rate;               // Rate last published
+    uint8_t  type;               // PROF_PTS or PROF_SINE
+};
+
+// Add a point to a profile, the points must not go back in time
+static int32_t prof_add(struct prof *prof, double secs, double rate);
+
+// Load a CSV profile of <secs>,<fps> lines
+static int32_t prof_load(struct prof *prof, const char *path);
+
+// Parse a list of numbers separated by commas, return how many or -1
+static int32_t prof_nums(const char *arg, double *nums, int32_t max);
+
+// Parse a ramp, step or sine formula or load a CSV file
+static int32_t prof_parse(struct prof *prof, const char *spec);
+
+// Return the rate of a profile in frames per second at a time in ns
+static uint64_t prof_rate(struct prof *prof, uint64_t ns);
+
+// Check the options, parse the profile and set the rate the workers start at
+static int32_t prof_setup(struct etherate *eth);
+
+// Publish the rate at a time in ns to the Tx workers if it changed
+static void prof_tick(struct etherate *eth, uint64_t ns);
+
+#endif // _PROFILE_H_
\ No newline at end of file
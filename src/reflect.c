@@ -0,0 +1,300 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "reflect.h"
+
+
+
+void *reflect_init(void* thd_opt_p) {
+
+    struct thd_opt *thd_opt = thd_opt_p;
+
+
+    // Save the thread tid
+    pid_t thread_id;
+    thread_id = syscall(SYS_gettid);
+    thd_opt->thd_id = thread_id;
+
+
+    // Set the thread cancel type and register the cleanup handler
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    pthread_cleanup_push(thd_cleanup, thd_opt_p);
+
+    
+    if (thd_opt->verbose) {
+        if (thd_opt->affinity >= 0) {
+            printf(
+                "Worker thread %" PRIu32 " started, bound to CPU %" PRId32 "\n",
+                thd_opt->thd_id, thd_opt->affinity
+            );
+        } else {
+            printf("Worker thread %" PRIu32 " started\n", thd_opt->thd_id);
+        }
+    }
+
+
+    if (thd_alloc_bufs(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+
+    // The Tx ring is on a second socket, so it has its own copy of the
+    // settings which is freed by thd_cleanup()
+    thd_opt->tx_opt = calloc(sizeof(struct thd_opt), 1);
+    if (thd_opt->tx_opt == NULL) {
+        tperror(thd_opt, "Can't calloc reflector Tx settings");
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+    struct thd_opt *tx_opt = thd_opt->tx_opt;
+    memcpy(tx_opt, thd_opt, sizeof(struct thd_opt));
+    tx_opt->err_str   = calloc(thd_opt->err_len, 1);
+    tx_opt->ign_out   = 0;
+    tx_opt->mmap_buf  = NULL;
+    tx_opt->quit      = 0;
+    tx_opt->ring      = NULL;
+    tx_opt->rx_buffer = NULL;
+    tx_opt->sk_mode   = SKT_TX;
+    tx_opt->sk_type   = SKT_PACKET_MMAP2;
+    tx_opt->sock      = 0;
+    tx_opt->thd_nr    = 1;
+    tx_opt->tx_buffer = NULL;
+    tx_opt->tx_opt    = NULL;
+
+    if (tx_opt->err_str == NULL) {
+        tperror(thd_opt, "Can't calloc reflector Tx settings");
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+
+    // Frames are received in TPACKET_V3 blocks and sent from TPACKET_V2
+    // slots, which hold one frame of up to frame_sz bytes each
+    tpacket_v3_ring_align(thd_opt);
+
+    if (tpacket_v3_sock(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+    tpacket_v2_ring_align(tx_opt);
+
+    if (tpacket_v2_sock(tx_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+
+    reflect_rx(thd_opt);
+
+
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
+    pthread_cleanup_pop(0);
+    return NULL;
+
+}
+
+
+
+static inline void reflect_frame(uint8_t *data, const uint8_t *frame, uint32_t len) {
+
+    // Swap the source and destination MACs as part of the one copy
+    memcpy(data, frame + ETH_ALEN, ETH_ALEN);
+    memcpy(data + ETH_ALEN, frame, ETH_ALEN);
+    memcpy(data + (ETH_ALEN * 2), frame + (ETH_ALEN * 2), len - (ETH_ALEN * 2));
+
+}
+
+
+
+void reflect_rx(struct thd_opt *thd_opt) {
+
+    struct thd_opt *tx_opt = thd_opt->tx_opt;
+
+    struct pollfd pfd;
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = thd_opt->sock;
+    pfd.events = POLLIN | POLLERR;
+    pfd.revents = 0;
+
+    // Length of the frame queued in each Tx slot, 0 if the slot is free
+    uint32_t *pending = calloc(tx_opt->frame_nr, sizeof(uint32_t));
+    if (pending == NULL) {
+        tperror(thd_opt, "Can't calloc Tx ring slot list");
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+    uint32_t blk_num = 0;
+    uint32_t done_num = 0;            // Oldest Tx slot which may still be pending
+    uint32_t drain_left = UINT32_MAX; // Blocks left to reflect once stopped
+    uint32_t tx_num = 0;
+    uint32_t tx_max = tx_opt->block_frm_sz - sizeof(struct tpacket2_hdr);
+    uint32_t unsent = 0;              // Frames not reflected as the Tx ring was full at the stop
+    struct   block_desc *pbd = NULL;
+
+    thd_opt->started = 1;
+
+    while (1) {
+
+        // Once stopped reflect at most one pass of the ring, the blocks which
+        // were retired, as it never empties under steady inbound traffic
+        if (drain_left == UINT32_MAX && thd_stopping(thd_opt))
+            drain_left = thd_opt->block_nr;
+        if (drain_left == 0)
+            break;
+
+        pbd = (struct block_desc *) thd_opt->ring[blk_num].iov_base;
+
+        if ((pbd->h1.block_status & TP_STATUS_USER) == 0) {
+
+            // Blocks already retired to userland have been reflected, stop here
+            if (drain_left != UINT32_MAX)
+                break;
+
+            if (poll(&pfd, 1, DEF_POLL_TIMEO) == -1 && errno != EINTR)
+                thd_opt->sk_err += 1;
+
+            continue;
+        }
+
+
+        uint32_t num_frms = pbd->h1.num_pkts;
+        uint32_t bytes = 0;
+        struct tpacket3_hdr *ppd;
+
+        ppd = (struct tpacket3_hdr *) ((uint8_t *) pbd + pbd->h1.offset_to_first_pkt);
+
+        for (uint32_t i = 0; i < num_frms; ++i) {
+
+            bytes += ppd->tp_snaplen;
+
+            // Truncated, runt or oversized frames can't be sent back as they were
+            if (ppd->tp_snaplen != ppd->tp_len || ppd->tp_snaplen < ETH_HLEN ||
+                ppd->tp_snaplen > tx_max) {
+                ppd = (struct tpacket3_hdr *) ((uint8_t *) ppd + ppd->tp_next_offset);
+                continue;
+            }
+
+            struct tpacket2_hdr *hdr = (void*)(tx_opt->mmap_buf + (tx_opt->block_frm_sz * tx_num));
+
+            // The Tx ring is full, block until the Kernel has sent the frame
+            // in this slot. The Rx ring then backs up and the frames which
+            // don't fit are counted by the Kernel as Rx drops.
+            while (pending[tx_num]) {
+                reflect_tx_done(thd_opt, pending, &done_num);
+                if (!pending[tx_num] || thd_stopping(thd_opt))
+                    break;
+                if (send(tx_opt->sock, NULL, 0, 0) == -1 &&
+                    errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT &&
+                    errno != ENOBUFS)
+                    thd_opt->sk_err += 1;
+            }
+
+            // Only when stopping, reported below
+            if (pending[tx_num]) {
+                unsent += 1;
+                ppd = (struct tpacket3_hdr *) ((uint8_t *) ppd + ppd->tp_next_offset);
+                continue;
+            }
+
+            reflect_frame((uint8_t*)hdr + sizeof(struct tpacket2_hdr),
+                          (uint8_t*)ppd + ppd->tp_mac, ppd->tp_snaplen);
+            hdr->tp_len = ppd->tp_snaplen;
+            hdr->tp_status = TP_STATUS_SEND_REQUEST;
+            pending[tx_num] = ppd->tp_snaplen;
+
+            tx_num = (tx_num + 1) % tx_opt->frame_nr;
+
+            ppd = (struct tpacket3_hdr *) ((uint8_t *) ppd + ppd->tp_next_offset);
+
+        }
+
+        thd_opt->rx_frms += num_frms;
+        thd_opt->rx_bytes += bytes;
+
+        // Reset the block stats back to KERNEL (userland is finished with it)
+        pbd->h1.block_status = TP_STATUS_KERNEL;
+
+        blk_num = (blk_num + 1) % thd_opt->block_nr;
+
+        if (drain_left != UINT32_MAX)
+            drain_left -= 1;
+
+
+        // Send the whole block's worth of frames with one syscall
+        if (send(tx_opt->sock, NULL, 0, MSG_DONTWAIT) == -1 &&
+            errno != EAGAIN && errno != EINTR && errno != ENOBUFS)
+            thd_opt->sk_err += 1;
+
+        reflect_tx_done(thd_opt, pending, &done_num);
+
+    }
+
+
+    // Wait for the frames still in the Tx ring
+    if (send(tx_opt->sock, NULL, 0, 0) == -1 &&
+        errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+        thd_opt->sk_err += 1;
+
+    reflect_tx_done(thd_opt, pending, &done_num);
+
+    if (unsent)
+        printf("%" PRIu32 ":%" PRIu32 " frames not reflected, the Tx ring was full when stopping\n",
+               thd_opt->thd_id, unsent);
+
+    free(pending);
+
+}
+
+
+
+void reflect_tx_done(struct thd_opt *thd_opt, uint32_t *pending, uint32_t *done_num) {
+
+    struct thd_opt *tx_opt = thd_opt->tx_opt;
+
+    // The slots are filled and sent in ring order, so stop at the first
+    // one which is free or still in flight
+    while (pending[*done_num]) {
+
+        uint32_t i = *done_num;
+        struct tpacket2_hdr *hdr = (void*)(tx_opt->mmap_buf + (tx_opt->block_frm_sz * i));
+
+        if (hdr->tp_status == TP_STATUS_AVAILABLE) {
+            thd_opt->tx_frms += 1;
+            thd_opt->tx_bytes += pending[i];
+        } else if (hdr->tp_status & TP_STATUS_WRONG_FORMAT) {
+            thd_opt->sk_err += 1;
+            hdr->tp_status = TP_STATUS_AVAILABLE;
+        } else {
+            break;
+        }
+
+        pending[i] = 0;
+        *done_num = (i + 1) % tx_opt->frame_nr;
+
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _REFLECT_H_
+#define _REFLECT_H_
+
+// Worker thread entry function
+void *reflect_init(void* thd_opt_p);
+
+// Copy a received frame into a Tx ring slot with the MACs swapped
+static inline void reflect_frame(uint8_t *data, const uint8_t *frame, uint32_t len);
+
+// Rx ring to Tx ring loop
+void reflect_rx(struct thd_opt *thd_opt);
+
+// Count the Tx ring slots the Kernel has finished with, from the slot done_num on
+void reflect_tx_done(struct thd_opt *thd_opt, uint32_t *pending, uint32_t *done_num);
+
+#endif // _REFLECT_H_
\ No newline at end of file
@@ -0,0 +1,414 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "rfc2544.h"
+
+static void rfc2544_addr(struct etherate *eth, uint16_t thread) {
+
+    struct   thd_opt *thd_opt = &eth->thd_opt[thread];
+    uint16_t src = thd_opt->if_idx;
+    uint16_t dst = (src + 1) % eth->sk_opt.if_nr;
+    uint16_t ethertype = htons(RFC2544_ETHERTYPE);
+
+    memcpy(thd_opt->frm_hdr, eth->sk_opt.if_opt[dst].mac, ETH_ALEN);
+    memcpy(thd_opt->frm_hdr + ETH_ALEN, eth->sk_opt.if_opt[src].mac, ETH_ALEN);
+    memcpy(thd_opt->frm_hdr + (ETH_ALEN * 2), &ethertype, sizeof(ethertype));
+
+    thd_opt->frm_hdr_set = 1;
+
+}
+
+
+
+static inline void rfc2544_rx(struct thd_opt *thd_opt, const uint8_t *frame, uint32_t len) {
+
+    uint32_t flow_id;
+
+    if (len < FLOW_ID_OFF + sizeof(flow_id))
+        return;
+
+    memcpy(&flow_id, frame + FLOW_ID_OFF, sizeof(flow_id));
+
+    // LLDP, STP or other traffic on the link would hide lost test frames
+    if ((ntohl(flow_id) >> 16) == RFC2544_MAGIC)
+        thd_opt->rfc2544_frms += 1;
+
+}
+
+
+
+static uint64_t rfc2544_line(struct etherate *eth, uint16_t frame_sz) {
+
+    uint8_t  tx_if[DEF_IF_MAX] = {0};
+    uint64_t line = 0;
+
+    // DPDK ports have no sysfs entry
+    if (eth->app_opt.sk_type == SKT_DPDK)
+        return 0;
+
+    for (uint16_t thread = 0; thread < eth->app_opt.tx_nr; thread += 1)
+        tx_if[thd_if_idx(eth, thread)] = 1;
+
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1) {
+
+        if (!tx_if[if_idx])
+            continue;
+
+        uint32_t speed = get_if_speed(eth->sk_opt.if_opt[if_idx].if_name);
+        if (speed == 0)
+            return 0;
+
+        // Each frame also takes 8 bytes of preamble and 12 of inter-frame gap
+        line += (uint64_t)speed * 1000000 / ((frame_sz + 20) * 8);
+
+    }
+
+    return line;
+
+}
+
+
+
+static double rfc2544_loss(struct rfc2544_trial *trial) {
+
+    // Other traffic on the Rx interfaces can be counted too
+    if (trial->rx_frms >= trial->tx_frms)
+        return 0;
+
+    return (double)(trial->tx_frms - trial->rx_frms) * 100 / trial->tx_frms;
+
+}
+
+
+
+static void rfc2544_print(struct rfc2544_res *res, uint32_t res_nr) {
+
+    printf("\nRFC 2544 throughput:\n");
+    printf("%5s %10s %10s %10s %7s %8s %6s\n",
+           "Frame", "Line Mfps", "Mfps", "Mbps", "% line", "Loss %", "Trials");
+
+    for (uint32_t idx = 0; idx < res_nr; idx += 1) {
+
+        printf("%5" PRIu16 " ", res[idx].frame_sz);
+
+        if (res[idx].line)
+            printf("%10.3f ", res[idx].line / 1000000.0);
+        else
+            printf("%10s ", "n/a");
+
+        if (!res[idx].found) {
+            printf("%10s %10s %7s %8s %6" PRIu32 "\n", "none", "-", "-", "-", res[idx].trials);
+            continue;
+        }
+
+        struct rfc2544_trial *best = &res[idx].best;
+        double fps = (double)best->tx_frms * 1000000000 / best->ns;
+
+        printf("%10.3f %10.1f ", fps / 1000000, fps * res[idx].frame_sz * 8 / 1000000);
+
+        if (res[idx].line)
+            printf("%7.2f ", fps * 100 / res[idx].line);
+        else
+            printf("%7s ", "n/a");
+
+        printf("%8.4f %6" PRIu32 "\n", rfc2544_loss(best), res[idx].trials);
+
+    }
+
+}
+
+
+
+static int32_t rfc2544_run(struct etherate *eth) {
+
+    // RFC 2544 Ethernet frame sizes, which include the FCS
+    const uint16_t frm_szs[] = {64, 128, 256, 512, 1024, 1280, 1518};
+    const uint32_t frm_sz_nr = sizeof(frm_szs) / sizeof(frm_szs[0]);
+    struct         rfc2544_res res[sizeof(frm_szs) / sizeof(frm_szs[0])];
+    uint32_t       res_nr = 0;
+    uint32_t       run_ms = (eth->app_opt.dur_lim ? eth->app_opt.dur_lim * 1000 : RFC2544_TRIAL_MS);
+    int32_t        ret = EXIT_SUCCESS;
+
+    // Random frame data up to the largest size
+    if (getrandom(eth->frm_opt.tx_buffer, DEF_FRM_SZ_MAX, 0) != DEF_FRM_SZ_MAX) {
+        perror("Can't generate random frame data");
+        return EXIT_FAILURE;
+    }
+
+    uint32_t mtu = bench_mtu(eth);
+
+    printf("Searching for the highest rate with at most %.4f%% loss, %.1f second "
+           "trials and %.1f seconds to settle:\n",
+           eth->app_opt.rfc2544_loss, run_ms / 1000.0, RFC2544_SETTLE_MS / 1000.0);
+
+    for (uint32_t frm_sz = 0; frm_sz < frm_sz_nr && !eth->app_opt.stop; frm_sz += 1) {
+
+        struct rfc2544_res *cur = &res[res_nr];
+
+        if (mtu != 0 && (uint32_t)(frm_szs[frm_sz] - ETH_FCS_LEN) > mtu + ETH_HLEN) {
+            printf("Skipping %" PRIu16 " byte frames, the interface MTU is %" PRIu32 ".\n",
+                   frm_szs[frm_sz], mtu);
+            continue;
+        }
+
+        memset(cur, 0, sizeof(struct rfc2544_res));
+        cur->frame_sz = frm_szs[frm_sz];
+        cur->line     = rfc2544_line(eth, cur->frame_sz);
+
+        // The FCS is added by the NIC
+        eth->frm_opt.frame_sz = cur->frame_sz - ETH_FCS_LEN;
+
+        uint64_t lo = 0;
+        uint64_t hi = cur->line;
+        uint64_t res_fps = 0;
+
+        while (cur->trials < RFC2544_STEPS) {
+
+            struct rfc2544_trial trial;
+
+            // The first trial is at line rate, then halfway between the
+            // highest rate that passed and the lowest that failed
+            uint64_t rate = (cur->trials ? lo + (hi - lo) / 2 : hi);
+
+            if (rfc2544_trial(eth, rate, run_ms, &trial) != EXIT_SUCCESS) {
+                ret = EXIT_FAILURE;
+                break;
+            }
+
+            // An interrupted trial doesn't count
+            if (eth->app_opt.stop)
+                break;
+
+            cur->trials += 1;
+
+            uint8_t pass = (trial.tx_frms && rfc2544_loss(&trial) <= eth->app_opt.rfc2544_loss);
+            double  fps = (double)trial.tx_frms * 1000000000 / trial.ns;
+
+            printf("%5" PRIu16 " bytes, %10.0f fps sent, %12" PRIu64 " Tx, %12" PRIu64
+                   " Rx, %8.4f%% loss, %s\n",
+                   cur->frame_sz, fps, trial.tx_frms, trial.rx_frms, rfc2544_loss(&trial),
+                   (pass ? "pass" : "fail"));
+
+            if (pass) {
+                lo = rate;
+                cur->best  = trial;
+                cur->found = 1;
+            } else {
+                hi = rate;
+            }
+
+            // Nothing faster can be sent, or no slower rate can pass
+            if (cur->trials == 1) {
+                if (pass)
+                    break;
+                if (hi == 0 || fps < hi)
+                    hi = fps;
+                res_fps = hi * RFC2544_RES;
+            }
+
+            if (hi - lo <= res_fps || hi <= 1)
+                break;
+
+        }
+
+        // Keep what finished when interrupted
+        if (ret != EXIT_SUCCESS || eth->app_opt.stop)
+            break;
+
+        res_nr += 1;
+
+    }
+
+    eth->app_opt.tx_rate = 0;
+
+    rfc2544_print(res, res_nr);
+
+    return ret;
+
+}
+
+
+
+static int32_t rfc2544_setup(struct etherate *eth) {
+
+    if (eth->app_opt.rfc2544_loss < 0 || eth->app_opt.rfc2544_loss >= 100) {
+        printf("Oops! The --rfc2544 loss threshold must be from 0 to less than 100%%.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.sk_mode != SKT_TX || eth->app_opt.mesh || eth->app_opt.xdp ||
+        eth->app_opt.memif_path != NULL || eth->app_opt.bench_path != NULL) {
+        printf("Oops! --rfc2544 runs its own Tx and Rx workers, it can't be used with\n"
+               "-r, -rt, -R, --bench, --memif, --mesh or --xdp.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.frm_lim || eth->app_opt.byte_lim || eth->app_opt.tx_rate) {
+        printf("Oops! --rfc2544 sets the rate and duration of each trial, don't use\n"
+               "-n, -N or -t (-d sets the trial duration).\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.sk_type == SKT_XDP_LIVE || eth->app_opt.sk_type == SKT_TAP) {
+        printf("Oops! --rfc2544 can't be used with -p5 or -p7.\n");
+        return EX_SOFTWARE;
+    }
+
+    // Only frames with the test flow ID are counted on Rx
+    if (eth->frm_opt.custom_frame) {
+        printf("Oops! --rfc2544 tags its own test frames, it can't be used with -C.\n");
+        return EX_SOFTWARE;
+    }
+
+    // The test frames go from one interface to the next
+    if (eth->app_opt.sk_type != SKT_DPDK &&
+        get_if_macs(eth) != EXIT_SUCCESS)
+        return EX_SOFTWARE;
+
+    eth->app_opt.sk_mode = SKT_BIDI;
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+static int32_t rfc2544_trial(struct etherate *eth, uint64_t rate, uint32_t run_ms,
+                             struct rfc2544_trial *trial) {
+
+    const struct timespec interval = {
+        .tv_sec  = 0,
+        .tv_nsec = DEF_MON_INTERVAL * 1000000L
+    };
+    uint16_t thd_nr = eth->app_opt.thd_nr;
+    uint16_t tx_nr = eth->app_opt.tx_nr;
+    uint16_t spawned = 0;
+    uint8_t  failed = 0;
+
+    memset(trial, 0, sizeof(struct rfc2544_trial));
+    trial->rate = rate;
+
+    // thd_setup() splits the rate between the Tx workers
+    eth->app_opt.tx_rate = rate;
+
+    // Start the Rx workers first, as thd_spawn_workers() does
+    for (spawned = 0; spawned < thd_nr; spawned += 1) {
+
+        uint16_t thread = (tx_nr + spawned) % thd_nr;
+
+        if (thread == 0)
+            thd_wait_rx(eth);
+
+        pthread_attr_init(&eth->app_opt.thd_attr[thread]);
+        pthread_attr_setdetachstate(&eth->app_opt.thd_attr[thread], PTHREAD_CREATE_JOINABLE);
+
+        if (thd_setup(eth, thread) != EXIT_SUCCESS) {
+            thd_cleanup(&eth->thd_opt[thread]);
+            failed = 1;
+            break;
+        }
+
+        // Tag the test frames so that only they are counted on Rx
+        if (thread < tx_nr) {
+            eth->thd_opt[thread].flow_id = ((uint32_t)RFC2544_MAGIC << 16) | thread;
+            if (eth->app_opt.sk_type != SKT_DPDK)
+                rfc2544_addr(eth, thread);
+        } else {
+            eth->thd_opt[thread].rfc2544_rx = 1;
+        }
+
+        if (thd_init_worker(eth, thread) != EXIT_SUCCESS) {
+            thd_cleanup(&eth->thd_opt[thread]);
+            failed = 1;
+            break;
+        }
+
+    }
+
+
+    uint64_t start = get_time_ns();
+    uint64_t end = start + run_ms * 1000000ULL;
+
+    while (!failed && !eth->app_opt.stop && get_time_ns() < end) {
+
+        for (uint16_t idx = 0; idx < spawned; idx += 1) {
+            if (eth->thd_opt[(tx_nr + idx) % thd_nr].quit)
+                failed = 1;
+        }
+
+        nanosleep(&interval, NULL);
+
+    }
+
+    // Stop the Tx workers and wait for them to drain their rings
+    for (uint16_t idx = 0; idx < spawned; idx += 1) {
+        uint16_t thread = (tx_nr + idx) % thd_nr;
+        if (thread < tx_nr)
+            thd_stop(&eth->thd_opt[thread]);
+    }
+
+    trial->ns = get_time_ns() - start;
+
+    for (uint16_t idx = 0; idx < spawned; idx += 1) {
+        uint16_t thread = (tx_nr + idx) % thd_nr;
+        if (thread < tx_nr)
+            pthread_join(eth->app_opt.thd[thread], NULL);
+    }
+
+    // Then give the frames still in flight time to arrive
+    uint64_t settle = get_time_ns() + RFC2544_SETTLE_MS * 1000000ULL;
+    while (!failed && !eth->app_opt.stop && get_time_ns() < settle)
+        nanosleep(&interval, NULL);
+
+    for (uint16_t idx = 0; idx < spawned; idx += 1) {
+        uint16_t thread = (tx_nr + idx) % thd_nr;
+        if (thread >= tx_nr) {
+            thd_stop(&eth->thd_opt[thread]);
+            pthread_join(eth->app_opt.thd[thread], NULL);
+        }
+    }
+
+    for (uint16_t idx = 0; idx < spawned; idx += 1) {
+        struct thd_opt *thd_opt = &eth->thd_opt[(tx_nr + idx) % thd_nr];
+        trial->rx_frms += thd_opt->rfc2544_frms;
+        trial->tx_frms += thd_opt->tx_frms;
+        thd_cleanup(thd_opt);
+        memset(thd_opt, 0, sizeof(struct thd_opt));
+    }
+
+    // Let the first worker on each interface join the fanout group first again
+    for (uint16_t if_idx = 0; if_idx < eth->sk_opt.if_nr; if_idx += 1)
+        eth->sk_opt.if_opt[if_idx].fanout_turn = 0;
+
+    if (failed) {
+        printf("Oops! A worker thread failed during the RFC 2544 trial.\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+}
\ No newline at end of file
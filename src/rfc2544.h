@@ -0,0 +1,99 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _RFC2544_H_
+#define _RFC2544_H_
+
+/*
+ * RFC 2544 throughput test (--rfc2544 <loss %>). The workers run in bidi
+ * mode, over two or more interfaces connected through the device under test
+ * or over one interface with the DUT looping the frames back. For each of
+ * the RFC 2544 Ethernet frame sizes a trial is first run at line rate (or
+ * unlimited if the interface speed is unknown). If more than <loss %> of the
+ * frames sent aren't received the rate is binary searched, using -t pacing,
+ * between zero and the rate which was actually sent. Each trial runs for -d
+ * seconds, the Rx workers are given RFC2544_SETTLE_MS to receive the frames
+ * still in flight after the Tx workers stop, and all workers are restarted
+ * for the next trial so every trial starts with empty queues.
+ *
+ * Each Tx worker addresses its frames from the MAC of its interface to the
+ * MAC of the next interface (itself with one interface), so that a switch
+ * or bridge forwards rather than floods them, and stamps them with a flow
+ * ID starting with RFC2544_MAGIC. The Rx workers only count the frames with
+ * that flow ID, so LLDP, STP and other traffic can't hide lost frames.
+ */
+
+#define RFC2544_ETHERTYPE 0x88b5 // IEEE 802 local experimental EtherType
+#define RFC2544_MAGIC     0x5246 // "RF", the top 16 bits of the test flow IDs
+#define RFC2544_RES       0.005  // Stop the search when within this fraction of the first rate
+#define RFC2544_SETTLE_MS 2000   // Time after Tx stops for frames in flight to arrive
+#define RFC2544_STEPS     12     // Most trials in the search of one frame size
+#define RFC2544_TRIAL_MS  60000  // Duration of each trial, -d overrides it
+
+// One trial at a fixed rate
+struct rfc2544_trial {
+    uint64_t rate;             // Rate asked for, 0 for no limit
+    uint64_t ns;               // Time the Tx workers ran for
+    uint64_t rx_frms;          // Test frames received, other traffic isn't counted
+    uint64_t tx_frms;
+};
+
+// The throughput found for one frame size
+struct rfc2544_res {
+    uint16_t frame_sz;         // Frame size with the FCS, as RFC 2544 counts it
+    uint64_t line;             // Line rate in frames per second, 0 if unknown
+    uint8_t  found;            // A trial passed, best is valid
+    struct   rfc2544_trial best;
+    uint32_t trials;
+};
+
+// Address a Tx worker's frames to the next interface
+static void rfc2544_addr(struct etherate *eth, uint16_t thread);
+
+// Count a received frame if it is a test frame
+static inline void rfc2544_rx(struct thd_opt *thd_opt, const uint8_t *frame, uint32_t len);
+
+// Return the line rate of the Tx interfaces in frames per second, 0 if unknown
+static uint64_t rfc2544_line(struct etherate *eth, uint16_t frame_sz);
+
+// Return the loss of a trial in percent
+static double rfc2544_loss(struct rfc2544_trial *trial);
+
+// Print the result table
+static void rfc2544_print(struct rfc2544_res *res, uint32_t res_nr);
+
+// Search each frame size for the highest rate within the loss threshold
+static int32_t rfc2544_run(struct etherate *eth);
+
+// Check the options can be used for the test and switch to bidi mode
+static int32_t rfc2544_setup(struct etherate *eth);
+
+// Run the workers for one trial at a rate, 0 for no limit
+static int32_t rfc2544_trial(struct etherate *eth, uint64_t rate, uint32_t run_ms,
+                             struct rfc2544_trial *trial);
+
+#endif // _RFC2544_H_
\ No newline at end of file
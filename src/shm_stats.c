@@ -0,0 +1,206 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "shm_stats.h"
+
+
+
+int32_t shm_stats_init(struct etherate *eth) {
+
+    struct stat_opt *stat_opt = &eth->stat_opt;
+
+    if (strchr(stat_opt->shm_name, '/') != NULL) {
+        printf("Oops! Stats segment name can't contain \"/\": %s\n",
+               stat_opt->shm_name);
+        return EXIT_FAILURE;
+    }
+
+    snprintf(stat_opt->shm_path, sizeof(stat_opt->shm_path),
+             "/dev/shm/%s", stat_opt->shm_name);
+
+    stat_opt->shm_sz = sizeof(struct shm_stats_hdr) +
+                       (sizeof(struct shm_stats_thd) * (eth->app_opt.thd_nr + 1));
+
+    int32_t fd = open(stat_opt->shm_path, O_CREAT | O_EXCL | O_RDWR, 0644);
+
+    // A segment left by an EtherateMT which has exited is replaced, readers
+    // which still have it mapped keep the old file. Truncating a segment
+    // another instance is writing would SIGBUS it and its readers.
+    if (fd == -1 && errno == EEXIST) {
+        if (shm_stats_stale(stat_opt->shm_path) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        if (unlink(stat_opt->shm_path) != 0 && errno != ENOENT) {
+            perror("Can't remove old stats segment");
+            return EXIT_FAILURE;
+        }
+        fd = open(stat_opt->shm_path, O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+
+    if (fd == -1) {
+        perror("Can't create stats segment");
+        return EXIT_FAILURE;
+    }
+
+    if (ftruncate(fd, (off_t)stat_opt->shm_sz) == -1) {
+        perror("Can't size stats segment");
+        close(fd);
+        unlink(stat_opt->shm_path);
+        return EXIT_FAILURE;
+    }
+
+    stat_opt->shm_buf = mmap(NULL, stat_opt->shm_sz, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+
+    if (close(fd) != 0)
+        perror("Can't close stats segment file");
+
+    if (stat_opt->shm_buf == MAP_FAILED) {
+        perror("Can't mmap stats segment");
+        stat_opt->shm_buf = NULL;
+        unlink(stat_opt->shm_path);
+        return EXIT_FAILURE;
+    }
+
+    // ftruncate() zero fills so only the fixed fields need setting
+    struct shm_stats_hdr *hdr = stat_opt->shm_buf;
+    hdr->magic    = SHM_STATS_MAGIC;
+    hdr->version  = SHM_STATS_VERSION;
+    hdr->hdr_sz   = sizeof(struct shm_stats_hdr);
+    hdr->thd_sz   = sizeof(struct shm_stats_thd);
+    hdr->thd_nr   = eth->app_opt.thd_nr;
+    hdr->sk_mode  = eth->app_opt.sk_mode;
+    hdr->sk_type  = eth->app_opt.sk_type;
+    hdr->pid      = getpid();
+    hdr->if_index = eth->sk_opt.if_opt[0].if_index;
+    memcpy(hdr->if_name, eth->sk_opt.if_opt[0].if_name, IF_NAMESIZE);
+    hdr->running  = 1;
+
+    printf("Publishing live stats to %s\n", stat_opt->shm_path);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+void shm_stats_publish(struct etherate *eth) {
+
+    struct stat_opt      *stat_opt = &eth->stat_opt;
+    struct shm_stats_hdr *hdr      = stat_opt->shm_buf;
+    struct shm_stats_thd *thd      = (struct shm_stats_thd*)(hdr + 1);
+    uint32_t             seq       = hdr->seq;
+
+    __atomic_store_n(&hdr->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    // The last entry is the aggregate of all threads
+    for (uint16_t thread = 0; thread <= eth->app_opt.thd_nr; thread += 1) {
+
+        struct thd_stats *now  = &stat_opt->now[thread];
+        struct thd_stats *prev = &stat_opt->prev[thread];
+
+        thd[thread].thd_id   = now->thd_id;
+        thd[thread].rx_bytes = now->rx_bytes;
+        thd[thread].rx_drops = now->rx_drops;
+        thd[thread].rx_frms  = now->rx_frms;
+        thd[thread].rx_qfrz  = now->rx_qfrz;
+        thd[thread].sk_err   = now->sk_err;
+        thd[thread].tx_bytes = now->tx_bytes;
+        thd[thread].tx_frms  = now->tx_frms;
+        thd[thread].rx_bps   = (now->rx_bytes - prev->rx_bytes) * 8;
+        thd[thread].rx_fps   = now->rx_frms - prev->rx_frms;
+        thd[thread].tx_bps   = (now->tx_bytes - prev->tx_bytes) * 8;
+        thd[thread].tx_fps   = now->tx_frms - prev->tx_frms;
+
+    }
+
+    hdr->duration = stat_opt->duration;
+    hdr->time     = (uint64_t)time(NULL);
+
+    __atomic_store_n(&hdr->seq, seq + 2, __ATOMIC_RELEASE);
+
+}
+
+
+
+void shm_stats_remove(struct etherate *eth) {
+
+    struct stat_opt *stat_opt = &eth->stat_opt;
+
+    if (stat_opt->shm_buf == NULL)
+        return;
+
+    // A monitor which still has the segment mapped sees the run has ended
+    struct shm_stats_hdr *hdr = stat_opt->shm_buf;
+    __atomic_store_n(&hdr->running, 0, __ATOMIC_RELEASE);
+
+    if (munmap(stat_opt->shm_buf, stat_opt->shm_sz) != 0)
+        perror("Can't unmap stats segment");
+
+    if (unlink(stat_opt->shm_path) != 0)
+        perror("Can't remove stats segment");
+
+    stat_opt->shm_buf = NULL;
+
+}
+
+
+
+int32_t shm_stats_stale(const char *path) {
+
+    struct shm_stats_hdr hdr;
+
+    int32_t fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        // Removed in the meantime
+        if (errno == ENOENT)
+            return EXIT_SUCCESS;
+        perror("Can't open existing stats segment");
+        return EXIT_FAILURE;
+    }
+
+    ssize_t rd = pread(fd, &hdr, sizeof(hdr), 0);
+
+    if (close(fd) != 0)
+        perror("Can't close existing stats segment");
+
+    if (rd != (ssize_t)sizeof(hdr) || hdr.magic != SHM_STATS_MAGIC) {
+        printf("Oops! %s exists and isn't an EtherateMT stats segment, remove it or "
+               "use another -S name.\n", path);
+        return EXIT_FAILURE;
+    }
+
+    // kill() fails with EPERM for a live process of another user
+    if (hdr.running && hdr.pid > 0 && (kill(hdr.pid, 0) == 0 || errno == EPERM)) {
+        printf("Oops! %s is in use by EtherateMT process %" PRId32 ", use another "
+               "-S name.\n", path, hdr.pid);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+}
\ No newline at end of file
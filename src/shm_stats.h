@@ -0,0 +1,96 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _SHM_STATS_H_
+#define _SHM_STATS_H_
+
+/*
+ * Layout of the live stats segment in /dev/shm, for external monitors.
+ *
+ * The segment is a struct shm_stats_hdr followed by thd_nr + 1 entries of
+ * struct shm_stats_thd, the last entry is the aggregate of all threads.
+ * Readers should check magic and version, then use hdr_sz and thd_sz to
+ * index the entries so that fields appended in later versions don't break
+ * them. All fields are native endian.
+ *
+ * The stats thread is the only writer and updates the segment once per
+ * interval using a sequence lock, a reader must:
+ *   1. Read seq, if it is odd a write is in progress, retry
+ *   2. Copy the header and entries
+ *   3. Read seq again, if it changed the copy is torn, retry
+ */
+
+#define SHM_STATS_MAGIC   0x45544d54  // "ETMT"
+#define SHM_STATS_VERSION 1
+
+struct shm_stats_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t hdr_sz;             // sizeof(struct shm_stats_hdr)
+    uint32_t thd_sz;             // sizeof(struct shm_stats_thd)
+    uint32_t seq;                // Odd while the stats thread is writing
+    uint16_t thd_nr;             // Number of worker threads
+    uint8_t  sk_mode;            // Tx/Rx/Bidi
+    uint8_t  sk_type;            // PACKET_MMAP, send(), sendmmsg() etc.
+    int32_t  pid;                // PID of the EtherateMT process
+    int32_t  if_index;           // First interface, worker N uses interface N % if_nr
+    char     if_name[IF_NAMESIZE];
+    uint64_t duration;           // Number of stats intervals completed
+    uint64_t time;               // Unix time of the last update
+    uint8_t  running;            // Cleared when EtherateMT exits
+    uint8_t  pad[7];
+};
+
+struct shm_stats_thd {
+    uint32_t thd_id;             // Worker thread tid, 0 for the aggregate
+    uint32_t pad;
+    uint64_t rx_bytes;           // Counters since start
+    uint64_t rx_drops;
+    uint64_t rx_frms;
+    uint64_t rx_qfrz;
+    uint64_t sk_err;
+    uint64_t tx_bytes;
+    uint64_t tx_frms;
+    uint64_t rx_bps;             // Rates during the last interval
+    uint64_t rx_fps;
+    uint64_t tx_bps;
+    uint64_t tx_fps;
+};
+
+// Create and map the /dev/shm stats segment
+int32_t shm_stats_init(struct etherate *eth);
+
+// Copy the current counters and rates into the stats segment
+void shm_stats_publish(struct etherate *eth);
+
+// Mark the stats segment as stopped, unmap and remove it
+void shm_stats_remove(struct etherate *eth);
+
+// Check an existing stats segment was left by an EtherateMT which has exited
+int32_t shm_stats_stale(const char *path);
+
+#endif // _SHM_STATS_H_
\ No newline at end of file
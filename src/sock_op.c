@@ -342,13 +342,90 @@ int32_t sock_op(uint8_t op, struct thd_opt *thd_opt) {
             }
 
 
-        case S_O_FANOUT:
+        // Join the fanout group, PACKET_FANOUT_QM hands Rx queue N to the
+        // Nth socket to join, so in that mode join in worker order
+        case S_O_FANOUT: {
+
+            uint32_t fanout_arg = (thd_opt->fanout_grp |
+                                  ((uint32_t)(thd_opt->fanout_type | thd_opt->fanout_flags) << 16));
+            int32_t fanout_ret;
+
+            if (thd_opt->fanout_type == PACKET_FANOUT_QM) {
+
+                // Don't wait forever if an earlier worker failed to start
+                uint64_t give_up = get_time_ns() + 1000000000ULL;
+                while (__atomic_load_n(thd_opt->fanout_turn, __ATOMIC_ACQUIRE) != thd_opt->fanout_idx) {
+                    if (get_time_ns() > give_up) {
+                        printf("%" PRIu32 ":Timed out waiting to join the fanout group in order\n",
+                               thd_opt->thd_id);
+                        break;
+                    }
+                    sched_yield();
+                }
+
+                fanout_ret = setsockopt(thd_opt->sock, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg));
+                __atomic_add_fetch(thd_opt->fanout_turn, 1, __ATOMIC_RELEASE);
+
+            } else {
+
+                fanout_ret = setsockopt(thd_opt->sock, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg));
+
+            }
+
+            if (fanout_ret == -1)
+                return -1;
+
+            // The group's socket is chosen by the program's return value
+            // modulo the number of sockets. Each joining socket attaches
+            // the same program, so the group has it as soon as one is in.
+            if (thd_opt->fanout_type == PACKET_FANOUT_CBPF) {
+
+                // Load the flow ID at FLOW_ID_OFF from the MAC header
+                static struct sock_filter fanout_cbpf[] = {
+                    { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_LL_OFF + FLOW_ID_OFF },
+                    { BPF_RET | BPF_A, 0, 0, 0 },
+                };
+                struct sock_fprog fanout_fprog = {
+                    .len    = sizeof(fanout_cbpf) / sizeof(fanout_cbpf[0]),
+                    .filter = fanout_cbpf,
+                };
+
+                return setsockopt(thd_opt->sock, SOL_PACKET, PACKET_FANOUT_DATA, &fanout_fprog, sizeof(fanout_fprog));
+
+            } else if (thd_opt->fanout_type == PACKET_FANOUT_EBPF) {
+
+                return setsockopt(thd_opt->sock, SOL_PACKET, PACKET_FANOUT_DATA, &thd_opt->fanout_prog, sizeof(thd_opt->fanout_prog));
+
+            }
+
+            return fanout_ret;
+
+        }
+
+
+        // Bound how long blocking socket calls can take so that the worker
+        // regularly returns to check if it has been asked to stop
+        case S_O_TIMEO:
+
+            ;
+            static const struct timeval sock_timeo = {
+                .tv_sec  = DEF_POLL_TIMEO / 1000,
+                .tv_usec = (DEF_POLL_TIMEO % 1000) * 1000
+            };
+
+            if (setsockopt(thd_opt->sock, SOL_SOCKET, SO_RCVTIMEO, &sock_timeo, sizeof(sock_timeo)) == -1)
+                return -1;
+
+            return setsockopt(thd_opt->sock, SOL_SOCKET, SO_SNDTIMEO, &sock_timeo, sizeof(sock_timeo));
+
+
+        // Don't pass frames sent from this host (by any socket) to this
+        // socket, so that Rx only counts frames which arrived on the wire
+        case S_O_IGN_OUT:
 
             ;
-            static const uint16_t fanout_type = PACKET_FANOUT_CPU;
-            static uint32_t fanout_arg;
-            fanout_arg = (thd_opt->fanout_grp | (fanout_type << 16));
-            return setsockopt(thd_opt->sock, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg));
+            static const int32_t ign_out = 1;
+            return setsockopt(thd_opt->sock, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ign_out, sizeof(ign_out));
 
 
         // Undefined socket operation
@@ -41,6 +41,8 @@
 #define S_O_RING_TP3    11
 #define S_O_MMAP_TP23   12
 #define S_O_FANOUT      13
+#define S_O_TIMEO       14
+#define S_O_IGN_OUT     15
 
 
 
@@ -0,0 +1,209 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "tap.h"
+
+void *tap_init(void* thd_opt_p) {
+
+    struct thd_opt *thd_opt = thd_opt_p;
+    
+    // Save the thread tid
+    pid_t thread_id;
+    thread_id = syscall(SYS_gettid);
+    thd_opt->thd_id = thread_id;
+
+    // Set the thread cancel type and register the cleanup handler
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    pthread_cleanup_push(thd_cleanup, thd_opt_p);
+
+
+    if (thd_opt->verbose) {
+        if (thd_opt->affinity >= 0) {
+            printf(
+                "Worker thread %" PRIu32 " started, bound to CPU %" PRId32 "\n",
+                thd_opt->thd_id, thd_opt->affinity
+            );
+        } else {
+            printf("Worker thread %" PRIu32 " started\n", thd_opt->thd_id);
+        }
+    }
+
+    if (thd_alloc_bufs(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+    if (tap_sock(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+    if (thd_opt->sk_mode == SKT_RX) {
+        tap_rx(thd_opt_p);
+    } else if (thd_opt->sk_mode == SKT_TX) {
+        tap_tx(thd_opt_p);
+    }
+
+
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
+    pthread_cleanup_pop(0);
+    return NULL;
+
+}
+
+
+
+void tap_rx(struct thd_opt *thd_opt) {
+
+    struct  virtio_net_hdr vnet_hdr;
+    struct  iovec iov[2] = {
+        { .iov_base = &vnet_hdr,          .iov_len = sizeof(vnet_hdr) },
+        { .iov_base = thd_opt->rx_buffer, .iov_len = DEF_FRM_SZ_MAX },
+    };
+    struct  pollfd pfd;
+    ssize_t rx_bytes;
+
+    pfd.fd = thd_opt->sock;
+    pfd.events = POLLIN;
+
+    thd_opt->started = 1;
+
+    while(!thd_stopping(thd_opt)) {
+
+        rx_bytes = readv(thd_opt->sock, iov, 2);
+
+        if (rx_bytes == -1) {
+            if (errno == EAGAIN) {
+                if (poll(&pfd, 1, DEF_POLL_TIMEO) == -1 && errno != EINTR)
+                    thd_opt->sk_err += 1;
+            } else if (errno != EINTR) {
+                thd_opt->sk_err += 1;
+            }
+        } else if (rx_bytes > (ssize_t)sizeof(vnet_hdr)) {
+            rx_bytes -= sizeof(vnet_hdr);
+            thd_opt->rx_bytes += rx_bytes;
+            thd_opt->rx_frms += 1;
+            if (thd_opt->mesh_rx != NULL)
+                mesh_rx(thd_opt, thd_opt->rx_buffer, rx_bytes);
+        }
+
+    }
+
+    // Count any frames already queued on the TAP queue, for a limited time
+    // as it never empties under steady inbound traffic
+    uint64_t drain_end = get_time_ns() + (DEF_DRAIN_TIMEO * 1000000ULL);
+
+    while(get_time_ns() < drain_end &&
+          (rx_bytes = readv(thd_opt->sock, iov, 2)) > (ssize_t)sizeof(vnet_hdr)) {
+        rx_bytes -= sizeof(vnet_hdr);
+        thd_opt->rx_bytes += rx_bytes;
+        thd_opt->rx_frms += 1;
+        if (thd_opt->mesh_rx != NULL)
+            mesh_rx(thd_opt, thd_opt->rx_buffer, rx_bytes);
+    }
+
+}
+
+
+
+int32_t tap_sock(struct thd_opt *thd_opt) {
+
+    // Non-blocking so that a stop request is noticed while Rx is idle
+    thd_opt->sock = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+
+    if (thd_opt->sock == -1) {
+        tperror(thd_opt, "Can't open /dev/net/tun");
+        thd_opt->sock = 0;
+        return EXIT_FAILURE;
+    }
+
+
+    // Each open() and TUNSETIFF on the same name attaches one more queue
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", (char*)thd_opt->if_name);
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_MULTI_QUEUE | IFF_VNET_HDR;
+
+    if (ioctl(thd_opt->sock, TUNSETIFF, &ifr) == -1) {
+        tperror(thd_opt, "Can't attach a queue to the TAP interface, it must be created "
+                         "with \"ip tuntap add <name> mode tap multi_queue\"");
+        return EXIT_FAILURE;
+    }
+
+
+    int32_t vnet_hdr_sz = sizeof(struct virtio_net_hdr);
+
+    if (ioctl(thd_opt->sock, TUNSETVNETHDRSZ, &vnet_hdr_sz) == -1) {
+        tperror(thd_opt, "Can't set the TAP vnet header size");
+        return EXIT_FAILURE;
+    }
+
+    if (thd_opt->verbose)
+        printf("%" PRIu32 ":Attached queue to TAP interface %s\n",
+               thd_opt->thd_id, thd_opt->if_name);
+
+
+    return EXIT_SUCCESS;
+}
+
+
+
+void tap_tx(struct thd_opt *thd_opt) {
+
+    // No checksum or GSO offload, the frame is sent as it is
+    struct  virtio_net_hdr vnet_hdr;
+    memset(&vnet_hdr, 0, sizeof(vnet_hdr));
+
+    struct  iovec iov[2] = {
+        { .iov_base = &vnet_hdr,          .iov_len = sizeof(vnet_hdr) },
+        { .iov_base = thd_opt->tx_buffer, .iov_len = thd_opt->frame_sz },
+    };
+    ssize_t tx_bytes;
+
+    thd_opt->started = 1;
+
+    while(!thd_stopping(thd_opt)) {
+
+        // Wait for the next frame to be due under -t
+        if (pace_tx(thd_opt, 1) == 0)
+            continue;
+
+        tx_bytes = writev(thd_opt->sock, iov, 2);
+
+        if (tx_bytes == -1) {
+            if (errno != EAGAIN && errno != EINTR)
+                thd_opt->sk_err += 1;
+        } else {
+            thd_opt->tx_bytes += tx_bytes - sizeof(vnet_hdr);
+            thd_opt->tx_frms += 1;
+            if (thd_opt->tx_frms == thd_opt->frm_lim)
+                break;
+        }
+
+    }
+
+}
\ No newline at end of file
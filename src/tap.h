@@ -0,0 +1,50 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _TAP_H_
+#define _TAP_H_
+
+/*
+ * TAP engine (-p7): each worker attaches its own queue to a multi-queue TAP
+ * interface, so the frames are written into and read from the host side of
+ * a vswitch, bridge or vhost-net datapath. Every frame is prefixed with a
+ * struct virtio_net_hdr, as vhost-net does, without any offloads set.
+ */
+
+// Worker thread entry function
+static void *tap_init(void* thd_opt_p);
+
+// Rx thread loop using readv()
+static void tap_rx(struct thd_opt *thd_opt);
+
+// Open /dev/net/tun and attach a queue of the TAP interface
+static int32_t tap_sock(struct thd_opt *thd_opt);
+
+// Tx thread loop using writev()
+static void tap_tx(struct thd_opt *thd_opt);
+
+#endif // _TAP_H_
\ No newline at end of file
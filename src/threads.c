@@ -33,6 +33,41 @@ static void thd_alloc(struct etherate *eth) {
     // thd_nr+1 to include the worker threads + the stats printing thread:
     eth->app_opt.thd = calloc(sizeof(pthread_t), (eth->app_opt.thd_nr + 1));
     eth->app_opt.thd_attr = calloc(sizeof(pthread_attr_t), (eth->app_opt.thd_nr + 1));
+    // thd_nr+1 to include the per-thread counters + the aggregate counters:
+    eth->stat_opt.now = calloc(sizeof(struct thd_stats), (eth->app_opt.thd_nr + 1));
+    eth->stat_opt.prev = calloc(sizeof(struct thd_stats), (eth->app_opt.thd_nr + 1));
+    eth->stat_opt.snap.thd = calloc(sizeof(struct thd_stats), (eth->app_opt.thd_nr + 1));
+}
+
+
+
+static int32_t thd_alloc_bufs(struct thd_opt *thd_opt) {
+
+    // Called by the worker after it has been pinned, so that with the
+    // default first-touch policy these pages are local to its NUMA node
+    thd_opt->rx_buffer = (uint8_t*)calloc(DEF_FRM_SZ_MAX, 1);
+    thd_opt->tx_buffer = (uint8_t*)calloc(DEF_FRM_SZ_MAX, 1);
+
+    if (thd_opt->rx_buffer == NULL || thd_opt->tx_buffer == NULL) {
+        tperror(thd_opt, "Can't calloc per-thread buffers");
+        return EXIT_FAILURE;
+    }
+
+    // Copy the frame data into the thread local Tx buffer
+    memcpy(thd_opt->tx_buffer, thd_opt->frm_src, DEF_FRM_SZ_MAX);
+
+    // Address the frame to a specific interface (mesh mode)
+    if (thd_opt->frm_hdr_set)
+        memcpy(thd_opt->tx_buffer, thd_opt->frm_hdr, ETH_HLEN);
+
+    // Stamp this worker's flow ID so that Rx can steer or count by it
+    if (thd_opt->frm_stamp) {
+        uint32_t flow_id = htonl(thd_opt->flow_id);
+        memcpy(thd_opt->tx_buffer + FLOW_ID_OFF, &flow_id, sizeof(flow_id));
+    }
+
+    return EXIT_SUCCESS;
+
 }
 
 
@@ -56,10 +91,71 @@ static void thd_cleanup(void *thd_opt_p) {
             tperror(thd_opt, "Can't close worker socket");
     }
 
+    // A reflector worker sends from a second socket
+    if (thd_opt->tx_opt != NULL) {
+        thd_cleanup(thd_opt->tx_opt);
+        free(thd_opt->tx_opt);
+        thd_opt->tx_opt = NULL;
+    }
+
+    // Closing the link detaches the XDP program, if the worker hasn't already
+    if (thd_opt->xdp_link > 0) {
+        if (close(thd_opt->xdp_link) != 0)
+            tperror(thd_opt, "Can't detach XDP program");
+    }
+
+    if (thd_opt->xdp_prog > 0) {
+        if (close(thd_opt->xdp_prog) != 0)
+            tperror(thd_opt, "Can't close XDP program");
+    }
+
+    if (thd_opt->xdp_map > 0) {
+        if (close(thd_opt->xdp_map) != 0)
+            tperror(thd_opt, "Can't close XDP counter map");
+    }
+
     free(thd_opt->err_str);
     free(thd_opt->ring);
     free(thd_opt->rx_buffer);
     free(thd_opt->tx_buffer);
+    free(thd_opt->xdp_ctrs);
+
+}
+
+
+
+static uint16_t thd_if_idx(struct etherate *eth, uint16_t thread) {
+
+    // In mesh mode a Tx worker sends from the source of its pair
+    if (eth->app_opt.mesh && thread < eth->app_opt.tx_nr)
+        return thread / (eth->sk_opt.if_nr - 1);
+
+    // When the Tx and Rx roles are split the Rx workers follow the Tx
+    // workers, and are spread over the interfaces in the same way
+    if (eth->app_opt.tx_nr && thread >= eth->app_opt.tx_nr)
+        return (thread - eth->app_opt.tx_nr) % eth->sk_opt.if_nr;
+
+    // Spread the workers round-robin so that each interface gets an equal share
+    return thread % eth->sk_opt.if_nr;
+
+}
+
+
+
+static int32_t thd_init_metrics(struct etherate *eth) {
+
+    if (pthread_create(
+            &eth->stat_opt.metrics_thd,
+            NULL,
+            metrics_serve,
+            (void*)eth
+        ) != 0)
+    {
+        perror("Can't create metrics thread");
+        return(EXIT_FAILURE);
+    }
+
+    return EXIT_SUCCESS;
 
 }
 
@@ -105,7 +201,44 @@ static int32_t thd_init_stats(struct etherate *eth) {
 
 static int32_t thd_init_worker(struct etherate *eth, uint16_t thread) {
 
-    if (eth->app_opt.sk_type == SKT_PACKET_MMAP2) {
+    if (eth->app_opt.xdp) {
+        if (pthread_create(
+                &eth->app_opt.thd[thread],
+                &eth->app_opt.thd_attr[thread],
+                xdp_init,
+                (void*)&eth->thd_opt[thread]
+            ) != 0)
+        {
+            perror("Can't create worker thread");
+            return(EXIT_FAILURE);
+        }
+
+    } else if (eth->app_opt.sk_mode == SKT_REFLECT) {
+        if (pthread_create(
+                &eth->app_opt.thd[thread],
+                &eth->app_opt.thd_attr[thread],
+                reflect_init,
+                (void*)&eth->thd_opt[thread]
+            ) != 0)
+        {
+            perror("Can't create worker thread");
+            return(EXIT_FAILURE);
+        }
+
+    // The latency probe worker always uses send()
+    } else if (eth->thd_opt[thread].lat_step != NULL) {
+        if (pthread_create(
+                &eth->app_opt.thd[thread],
+                &eth->app_opt.thd_attr[thread],
+                packet_init,
+                (void*)&eth->thd_opt[thread]
+            ) != 0)
+        {
+            perror("Can't create worker thread");
+            return(EXIT_FAILURE);
+        }
+
+    } else if (eth->app_opt.sk_type == SKT_PACKET_MMAP2) {
         if (pthread_create(
                 &eth->app_opt.thd[thread],
                 &eth->app_opt.thd_attr[thread],
@@ -166,6 +299,54 @@ static int32_t thd_init_worker(struct etherate *eth, uint16_t thread) {
             return(EXIT_FAILURE);
         }
 
+    } else if (eth->app_opt.sk_type == SKT_XDP_LIVE) {
+        if (pthread_create(
+                &eth->app_opt.thd[thread],
+                &eth->app_opt.thd_attr[thread],
+                xdp_live_init,
+                (void*)&eth->thd_opt[thread]
+            ) != 0)
+        {
+            perror("Can't create worker thread");
+            return(EXIT_FAILURE);
+        }
+
+    } else if (eth->app_opt.sk_type == SKT_DPDK) {
+        if (pthread_create(
+                &eth->app_opt.thd[thread],
+                &eth->app_opt.thd_attr[thread],
+                dpdk_init,
+                (void*)&eth->thd_opt[thread]
+            ) != 0)
+        {
+            perror("Can't create worker thread");
+            return(EXIT_FAILURE);
+        }
+
+    } else if (eth->app_opt.sk_type == SKT_TAP) {
+        if (pthread_create(
+                &eth->app_opt.thd[thread],
+                &eth->app_opt.thd_attr[thread],
+                tap_init,
+                (void*)&eth->thd_opt[thread]
+            ) != 0)
+        {
+            perror("Can't create worker thread");
+            return(EXIT_FAILURE);
+        }
+
+    } else if (eth->app_opt.sk_type == SKT_MEMIF) {
+        if (pthread_create(
+                &eth->app_opt.thd[thread],
+                &eth->app_opt.thd_attr[thread],
+                memif_init,
+                (void*)&eth->thd_opt[thread]
+            ) != 0)
+        {
+            perror("Can't create worker thread");
+            return(EXIT_FAILURE);
+        }
+
     }
 
     if (pthread_attr_destroy(&eth->app_opt.thd_attr[thread]) != 0) {
@@ -178,12 +359,35 @@ static int32_t thd_init_worker(struct etherate *eth, uint16_t thread) {
 
 
 
+static void thd_join_metrics(struct etherate *eth) {
+
+    if (eth->stat_opt.metrics_sock == -1)
+        return;
+
+    // The exporter only ever blocks in accept()/read()/write(),
+    // which are all cancellation points, it may also have exited by itself
+    int32_t pcancel = pthread_cancel(eth->stat_opt.metrics_thd);
+    if (pcancel != 0 && pcancel != ESRCH) {
+        printf("Can't cancel metrics thread, returned %" PRId32 "\n", pcancel);
+        return;
+    }
+
+    void *thd_ret = NULL;
+    pthread_join(eth->stat_opt.metrics_thd, &thd_ret);
+
+}
+
+
+
 static void thd_join_stats(struct etherate *eth) {
 
-    int32_t thd_ret;
+    // The stats thread takes a final sample of the drained counters then exits
+    __atomic_store_n(&eth->stat_opt.done, 1, __ATOMIC_RELAXED);
+
+    void *thd_ret = NULL;
     int32_t join_ret = pthread_join(
         eth->app_opt.thd[eth->app_opt.thd_nr],
-        (void*)&thd_ret
+        &thd_ret
     );
 
     if (join_ret != 0)
@@ -192,12 +396,12 @@ static void thd_join_stats(struct etherate *eth) {
             join_ret
         );
 
-    if (thd_ret != EXIT_SUCCESS) {
+    if ((intptr_t)thd_ret != EXIT_SUCCESS) {
         if (eth->app_opt.verbose)
             printf(
                 "Completed join with stats thread with a status of "
-                "%" PRId32 "\n",
-                thd_ret
+                "%" PRIdPTR "\n",
+                (intptr_t)thd_ret
             );
     }
 
@@ -209,9 +413,9 @@ static void thd_join_workers(struct etherate *eth) {
 
     for(uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
         
-        int32_t thd_ret;
+        void *thd_ret = NULL;
         int32_t join_ret = pthread_join(
-            eth->app_opt.thd[thread], (void*)&thd_ret
+            eth->app_opt.thd[thread], &thd_ret
         );
 
         if (join_ret != 0)
@@ -221,93 +425,245 @@ static void thd_join_workers(struct etherate *eth) {
                 eth->thd_opt[thread].thd_id, join_ret
             );
 
-        if (thd_ret != EXIT_SUCCESS) {
+        if ((intptr_t)thd_ret != EXIT_SUCCESS) {
             if (eth->app_opt.verbose)
                 printf(
-                    "Worker thread %" PRIu32 " returned %" PRId32 "\n",
-                    eth->thd_opt[thread].thd_id, thd_ret
+                    "Worker thread %" PRIu32 " returned %" PRIdPTR "\n",
+                    eth->thd_opt[thread].thd_id, (intptr_t)thd_ret
                 );
+        }
+
+        // Sockets are closed by etherate_cleanup(), after the stats thread
+        // has read the final socket stats
+
+    }
+
+}
+
+
+
+static void thd_monitor(struct etherate *eth) {
+
+    const struct timespec interval = {
+        .tv_sec  = 0,
+        .tv_nsec = DEF_MON_INTERVAL * 1000000L
+    };
+    const char *reason = NULL;
+    uint64_t start = 0;
+
+    // Frame and byte limits are counted on Rx when nothing is sent
+    uint8_t rx_lim = (eth->app_opt.sk_mode == SKT_RX ||
+                      eth->app_opt.sk_mode == SKT_REFLECT);
+
+    while (reason == NULL) {
+
+        nanosleep(&interval, NULL);
+
+        uint16_t finished = 0;
+        uint16_t tx_finished = 0;
+        uint64_t rx_bytes = 0;
+        uint64_t rx_frms = 0;
+
+        for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+
+            struct thd_opt *thd_opt = &eth->thd_opt[thread];
+
+            // The duration is measured from when the first worker starts
+            if (!start && thd_opt->started)
+                start = get_time_ns();
+
+            if (thd_opt->quit || thd_stopping(thd_opt)) {
+                finished += 1;
+                if (thd_opt->sk_mode == SKT_TX)
+                    tx_finished += 1;
+            }
+
+            rx_bytes += thd_opt->rx_bytes;
+            rx_frms += thd_opt->rx_frms;
 
-            eth->thd_opt[thread].quit = 1;
         }
 
-        thd_cleanup(&eth->thd_opt[thread]);
+        if (eth->app_opt.prof != NULL && start)
+            prof_tick(eth, get_time_ns() - start);
+
+        if (eth->app_opt.stop) {
+            reason = "Interrupted";
+        } else if (finished == eth->app_opt.thd_nr) {
+            reason = "All workers finished";
+        } else if (eth->app_opt.tx_nr && tx_finished == eth->app_opt.tx_nr) {
+            reason = "All Tx workers finished";
+        } else if (eth->app_opt.dur_lim && start &&
+                   get_time_ns() - start >= eth->app_opt.dur_lim * 1000000000ULL) {
+            reason = "Duration limit reached";
+        } else if (rx_lim && eth->app_opt.frm_lim &&
+                   rx_frms >= eth->app_opt.frm_lim) {
+            reason = "Frame limit reached";
+        } else if (rx_lim && eth->app_opt.byte_lim &&
+                   rx_bytes >= eth->app_opt.byte_lim) {
+            reason = "Byte limit reached";
+        }
 
     }
 
+    if (eth->app_opt.verbose)
+        printf("%s, stopping worker threads\n", reason);
+
+    thd_stop_workers(eth);
+
 }
 
 
 
 static int32_t thd_setup(struct etherate *eth, uint16_t thread) {
 
+    uint16_t      if_idx = thd_if_idx(eth, thread);
+    struct if_opt *if_opt = &eth->sk_opt.if_opt[if_idx];
+
     // Set up thread local copies of all settings
     eth->thd_opt[thread].affinity     = -1;
     eth->thd_opt[thread].block_frm_sz = eth->frm_opt.block_frm_sz;
     eth->thd_opt[thread].block_nr     = eth->frm_opt.block_nr;
     eth->thd_opt[thread].block_sz     = eth->frm_opt.block_sz;
+    eth->thd_opt[thread].dpdk_q       = (eth->app_opt.dpdk_qs == NULL ? NULL : &eth->app_opt.dpdk_qs[thread]);
     eth->thd_opt[thread].err_len      = eth->app_opt.err_len;
     eth->thd_opt[thread].err_str      = (char*)calloc(eth->app_opt.err_len, 1);
-    eth->thd_opt[thread].fanout_grp   = eth->app_opt.fanout_grp;
+    eth->thd_opt[thread].fanout_flags = eth->app_opt.fanout_flags;
+    eth->thd_opt[thread].fanout_grp   = if_opt->fanout_grp;
+    eth->thd_opt[thread].fanout_idx   = thread / eth->sk_opt.if_nr;
+    eth->thd_opt[thread].fanout_prog  = eth->app_opt.fanout_prog;
+    eth->thd_opt[thread].fanout_turn  = &if_opt->fanout_turn;
+    eth->thd_opt[thread].fanout_type  = eth->app_opt.fanout_type;
+    if (eth->app_opt.q_map != QMAP_OFF && eth->app_opt.sk_mode != SKT_TX)
+        eth->thd_opt[thread].fanout_type = PACKET_FANOUT_QM;
+    eth->thd_opt[thread].flow_id      = thread;
     eth->thd_opt[thread].frame_nr     = eth->frm_opt.frame_nr;
     eth->thd_opt[thread].frame_sz     = eth->frm_opt.frame_sz;
+    eth->thd_opt[thread].frm_hdr_set  = 0;
+    eth->thd_opt[thread].frm_src      = eth->frm_opt.tx_buffer;
+    eth->thd_opt[thread].frm_stamp    = !eth->frm_opt.custom_frame &&
+                                        eth->frm_opt.frame_sz >= FLOW_ID_OFF + sizeof(uint32_t);
     eth->thd_opt[thread].frm_sz_max   = DEF_FRM_SZ_MAX;
-    eth->thd_opt[thread].if_index     = eth->sk_opt.if_index;
+    eth->thd_opt[thread].if_idx       = if_idx;
+    eth->thd_opt[thread].if_index     = if_opt->if_index;
     strncpy(
         (char*)eth->thd_opt[thread].if_name,
-        (char*)eth->sk_opt.if_name,
+        (char*)if_opt->if_name,
         IF_NAMESIZE
     );
+    eth->thd_opt[thread].ign_out      = 0;
+    eth->thd_opt[thread].lat_res      = NULL;
+    eth->thd_opt[thread].lat_rx       = NULL;
+    eth->thd_opt[thread].lat_seq      = 0;
+    eth->thd_opt[thread].lat_step     = NULL;
+    eth->thd_opt[thread].memif_q      = (eth->app_opt.memif_qs == NULL ? NULL : &eth->app_opt.memif_qs[thread]);
+    eth->thd_opt[thread].mesh_nr      = 0;
+    eth->thd_opt[thread].mesh_other   = 0;
+    eth->thd_opt[thread].mesh_rx      = NULL;
     eth->thd_opt[thread].mmap_buf     = NULL;
     eth->thd_opt[thread].msgvec_vlen  = eth->sk_opt.msgvec_vlen;
     eth->thd_opt[thread].quit         = 0;
+    eth->thd_opt[thread].rfc2544_frms = 0;
+    eth->thd_opt[thread].rfc2544_rx   = 0;
     eth->thd_opt[thread].ring         = NULL;
-    eth->thd_opt[thread].rx_buffer    = (uint8_t*)calloc(DEF_FRM_SZ_MAX,1);
+    eth->thd_opt[thread].rx_buffer    = NULL;
     eth->thd_opt[thread].rx_bytes     = 0;
     eth->thd_opt[thread].rx_frms      = 0;
     eth->thd_opt[thread].started      = 0;
     eth->thd_opt[thread].sk_err       = 0;
     eth->thd_opt[thread].sk_mode      = eth->app_opt.sk_mode;
     eth->thd_opt[thread].sk_type      = eth->app_opt.sk_type;
-    eth->thd_opt[thread].thd_nr       = eth->app_opt.thd_nr;
+    eth->thd_opt[thread].stop         = 0;
+    eth->thd_opt[thread].thd_nr       = if_opt->thd_nr;
     eth->thd_opt[thread].thd_id       = 0;
-    eth->thd_opt[thread].tx_buffer    = (uint8_t*)calloc(DEF_FRM_SZ_MAX,1);
+    eth->thd_opt[thread].thd_idx      = thread;
+    eth->thd_opt[thread].tx_buffer    = NULL;
     eth->thd_opt[thread].tx_bytes     = 0;
     eth->thd_opt[thread].tx_frms      = 0;
+    eth->thd_opt[thread].tx_opt       = NULL;
     eth->thd_opt[thread].verbose      = eth->app_opt.verbose;
+    eth->thd_opt[thread].xdp_act      = 0;
+    eth->thd_opt[thread].xdp_ctrs     = NULL;
+    eth->thd_opt[thread].xdp_link     = 0;
+    eth->thd_opt[thread].xdp_map      = 0;
+    eth->thd_opt[thread].xdp_prog     = 0;
+
+    // Bidi and mesh mode run separate Tx and Rx workers, the Tx workers don't
+    // join the fanout group so that all received frames go to the Rx workers
+    if (eth->app_opt.tx_nr && thread < eth->app_opt.tx_nr) {
+        eth->thd_opt[thread].sk_mode    = SKT_TX;
+        eth->thd_opt[thread].thd_nr     = 1;
+    } else if (eth->app_opt.tx_nr) {
+        eth->thd_opt[thread].fanout_idx = (thread - eth->app_opt.tx_nr) / eth->sk_opt.if_nr;
+        eth->thd_opt[thread].ign_out    = 1;
+        eth->thd_opt[thread].sk_mode    = SKT_RX;
+        eth->thd_opt[thread].thd_nr     = if_opt->rx_nr;
+    }
 
-    if (eth->thd_opt[thread].err_str == NULL   ||
-        eth->thd_opt[thread].rx_buffer == NULL ||
-        eth->thd_opt[thread].tx_buffer == NULL) {
+    // A reflector worker receives on its own socket and is counted as Rx,
+    // it must not see the frames it sends itself
+    if (eth->app_opt.sk_mode == SKT_REFLECT) {
+        eth->thd_opt[thread].ign_out    = 1;
+        eth->thd_opt[thread].sk_mode    = SKT_RX;
+    }
+
+    if (eth->app_opt.mesh)
+        mesh_thd_setup(eth, thread);
+
+    if (eth->app_opt.xdp)
+        eth->thd_opt[thread].xdp_act = (eth->app_opt.sk_mode == SKT_REFLECT ? XDP_TX : XDP_DROP);
+
+    if (eth->thd_opt[thread].err_str == NULL) {
         printf("Failed to calloc() per-thread buffers!\n");
         return EXIT_FAILURE;
     }
 
-    // Copy the frame data into the thread local Tx buffer
-    memcpy(
-        eth->thd_opt[thread].tx_buffer,
-        eth->frm_opt.tx_buffer,
-        DEF_FRM_SZ_MAX
-    );
+    // Split the Tx frame limit (a byte limit is rounded up to whole frames)
+    // between the workers, spreading any remainder over the first workers
+    uint64_t frm_lim = eth->app_opt.frm_lim;
+    if (eth->app_opt.byte_lim) {
+        uint64_t byte_frms = (eth->app_opt.byte_lim + eth->frm_opt.frame_sz - 1) /
+                             eth->frm_opt.frame_sz;
+        if (!frm_lim || byte_frms < frm_lim)
+            frm_lim = byte_frms;
+    }
 
+    // In bidi/mesh mode only the first tx_nr workers send
+    uint16_t tx_nr = eth->app_opt.tx_nr ? eth->app_opt.tx_nr : eth->app_opt.thd_nr;
 
-    // CPU affinity must be set before the thread is started
+    eth->thd_opt[thread].frm_lim = 0;
+    if (eth->thd_opt[thread].sk_mode == SKT_TX && frm_lim) {
+        eth->thd_opt[thread].frm_lim = (frm_lim / tx_nr) +
+                                       (thread < (frm_lim % tx_nr));
+        // This worker has no share of the limit, it has nothing to send
+        if (eth->thd_opt[thread].frm_lim == 0)
+            eth->thd_opt[thread].stop = 1;
+    }
+
+    // Split the Tx rate the same way, the main thread may change it later
+    eth->thd_opt[thread].tx_rate = 0;
+    if (eth->thd_opt[thread].sk_mode == SKT_TX)
+        eth->thd_opt[thread].tx_rate = pace_share(eth->app_opt.tx_rate, thread, tx_nr);
+
+    // Each Tx worker sends its own bursts
+    eth->thd_opt[thread].burst_gap  = 0;
+    eth->thd_opt[thread].burst_left = 0;
+    eth->thd_opt[thread].burst_nr   = 0;
+    if (eth->thd_opt[thread].sk_mode == SKT_TX && eth->app_opt.burst_nr) {
+        eth->thd_opt[thread].burst_gap  = if_opt->burst_gap;
+        eth->thd_opt[thread].burst_left = eth->app_opt.burst_nr;
+        eth->thd_opt[thread].burst_nr   = eth->app_opt.burst_nr;
+    }
+
+    // The probe worker, the background load and the Rx histograms
+    if (eth->app_opt.lat_rate)
+        lat_thd_setup(eth, thread);
+
+    // CPU affinity must be set before the thread is started, the worker then
+    // allocates its buffers and ring so that they are on the same NUMA node
     if (eth->app_opt.thd_affin) {
 
         cpu_set_t cpu_set;
-        
-        /*
-         CPU count starts from 0, bind work threads to from CPU 1 onwards,
-         save CPU 0 for main() and stats thread.
-        */
-        int32_t cpu = (thread % eth->app_opt.thd_nr)+1;
-        /*
-         If the worker thread count is equal or higher than the number of CPUs
-         (including CPU 0), wrap around and start allocating from CPU 0 upwards
-        */
-        if (cpu >= get_nprocs()) {
-            cpu = (cpu % get_nprocs());
-        }
+        int32_t cpu = cpu_worker(eth, thread);
 
         // Zero out the CPU set, then add this specific CPU to the set
         CPU_ZERO(&cpu_set);
@@ -323,6 +679,25 @@ static int32_t thd_setup(struct etherate *eth, uint16_t thread) {
             eth->thd_opt[thread].affinity = cpu;
         }
 
+    // Without -x keep the workers on their interface's NUMA node and off
+    // the housekeeping CPUs (main() is pinned there and workers would
+    // inherit it), but let the scheduler choose the CPU
+    } else if (if_opt->numa_node >= 0 ||
+               CPU_COUNT(&eth->app_opt.hk_cpus) > 0) {
+
+        cpu_set_t cpu_set;
+
+        CPU_AND(&cpu_set, &eth->app_opt.thd_cpus, &if_opt->node_cpus);
+        if (CPU_COUNT(&cpu_set) == 0)
+            memcpy(&cpu_set, &eth->app_opt.thd_cpus, sizeof(cpu_set_t));
+
+        int32_t affin_ret = pthread_attr_setaffinity_np(
+            &eth->app_opt.thd_attr[thread], sizeof(cpu_set_t), &cpu_set
+        );
+
+        if (affin_ret != 0)
+            printf("Can't set NUMA node affinity for thread %" PRIu32 "\n", thread);
+
     }
 
     return EXIT_SUCCESS;
@@ -333,7 +708,16 @@ static int32_t thd_setup(struct etherate *eth, uint16_t thread) {
 
 static int32_t thd_spawn_workers(struct etherate *eth) {
 
-    for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+    // In bidi/mesh mode start the Rx workers first, otherwise the Tx
+    // workers can fill the Rx socket buffers before anything reads them
+    uint16_t first = eth->app_opt.tx_nr;
+
+    for (uint16_t spawned = 0; spawned < eth->app_opt.thd_nr; spawned += 1) {
+
+        uint16_t thread = (first + spawned) % eth->app_opt.thd_nr;
+
+        if (eth->app_opt.tx_nr && thread == 0)
+            thd_wait_rx(eth);
 
         pthread_attr_init(&eth->app_opt.thd_attr[thread]);
         pthread_attr_setdetachstate(&eth->app_opt.thd_attr[thread],
@@ -342,16 +726,16 @@ static int32_t thd_spawn_workers(struct etherate *eth) {
 
         // Setup and copy default per-thread structures and settings
         if (thd_setup(eth, thread) != EXIT_SUCCESS) {
-            for (uint16_t thd = 0; thd <= thread; thd += 1) {
-                thd_cleanup(&eth->thd_opt[thd]);
+            for (uint16_t thd = 0; thd <= spawned; thd += 1) {
+                thd_cleanup(&eth->thd_opt[(first + thd) % eth->app_opt.thd_nr]);
             }
             etherate_cleanup(eth);
             return EXIT_FAILURE;
         }
 
         if (thd_init_worker(eth, thread) != EXIT_SUCCESS) {
-            for (uint16_t thd = 0; thd <= thread; thd += 1) {
-                thd_cleanup(&eth->thd_opt[thd]);
+            for (uint16_t thd = 0; thd <= spawned; thd += 1) {
+                thd_cleanup(&eth->thd_opt[(first + thd) % eth->app_opt.thd_nr]);
             }
             etherate_cleanup(eth);
             return EXIT_FAILURE;
@@ -365,6 +749,64 @@ static int32_t thd_spawn_workers(struct etherate *eth) {
 
 
 
+static void thd_stop(struct thd_opt *thd_opt) {
+
+    __atomic_store_n(&thd_opt->stop, 1, __ATOMIC_RELAXED);
+
+}
+
+
+
+static void thd_stop_workers(struct etherate *eth) {
+
+    // With separate Tx and Rx workers stop the Tx workers first, then give the
+    // frames still in flight time to arrive so that they aren't counted as lost
+    if (eth->app_opt.tx_nr) {
+        for (uint16_t thread = 0; thread < eth->app_opt.tx_nr; thread += 1) {
+            thd_stop(&eth->thd_opt[thread]);
+        }
+        nanosleep(&(struct timespec){ .tv_sec = DEF_SETTLE_TIMEO / 1000,
+                                      .tv_nsec = (DEF_SETTLE_TIMEO % 1000) * 1000000L }, NULL);
+    }
+
+    for (uint16_t thread = 0; thread < eth->app_opt.thd_nr; thread += 1) {
+        thd_stop(&eth->thd_opt[thread]);
+    }
+
+}
+
+
+
+static uint8_t thd_stopping(struct thd_opt *thd_opt) {
+
+    return __atomic_load_n(&thd_opt->stop, __ATOMIC_RELAXED);
+
+}
+
+
+
+static void thd_wait_rx(struct etherate *eth) {
+
+    const struct timespec interval = {
+        .tv_sec  = 0,
+        .tv_nsec = DEF_MON_INTERVAL * 1000000L
+    };
+
+    // The Rx workers follow the Tx workers
+    for (uint16_t thread = eth->app_opt.tx_nr; thread < eth->app_opt.thd_nr; thread += 1) {
+
+        struct thd_opt *thd_opt = &eth->thd_opt[thread];
+
+        // A worker which failed to set up its socket never starts
+        while (!thd_opt->started && !thd_opt->quit && !eth->app_opt.stop)
+            nanosleep(&interval, NULL);
+
+    }
+
+}
+
+
+
 static void tperror(struct thd_opt *thd_opt, const char *msg) {
 
     printf("%" PRIu32 ":%s (%d: %s)\n",
@@ -31,24 +31,52 @@
 // Alloc thread controls for all threads
 static void thd_alloc(struct etherate *eth);
 
+// Allocate the per-thread Tx/Rx buffers from within the worker thread
+static int32_t thd_alloc_bufs(struct thd_opt *thd_opt);
+
 // Butch: "Thread's dead baby, Thread's dead"
 static void thd_cleanup(void *thd_opt_p);
 
+// Return the index in sk_opt.if_opt of the interface a worker thread uses
+static uint16_t thd_if_idx(struct etherate *eth, uint16_t thread);
+
+// Spawn the OpenMetrics exporter thread
+static int32_t thd_init_metrics(struct etherate *eth);
+
 // Spawn the stats printing thread
 static int32_t thd_init_stats(struct etherate *eth);
 
 // Spawn a worker thread
 static int32_t thd_init_worker(struct etherate *eth, uint16_t thread);
 
-// Join the stats thread on exit
+// Cancel and join the OpenMetrics exporter thread on exit
+static void thd_join_metrics(struct etherate *eth);
+
+// Stop the stats thread after a final sample, then join it
 static void thd_join_stats(struct etherate *eth);
 
-// Join worker threads on exit
+// Join worker threads once they have drained
 static void thd_join_workers(struct etherate *eth);
 
+// Wait until a duration, frame or byte limit is reached, all workers have
+// finished or SIGINT is received, then ask all workers to stop
+static void thd_monitor(struct etherate *eth);
+
 // Copy settings into a new worker thread
 static int32_t thd_setup(struct etherate *eth, uint16_t thread);
 
+// Ask a worker to stop, it drains then returns
+static void thd_stop(struct thd_opt *thd_opt);
+
+// Stop the Tx workers, wait for the frames in flight, then stop the Rx workers
+static void thd_stop_workers(struct etherate *eth);
+
+// Check if a worker has been asked to stop
+static uint8_t thd_stopping(struct thd_opt *thd_opt);
+
+// Wait for the bidi/mesh Rx workers to start receiving
+static void thd_wait_rx(struct etherate *eth);
+
 // Print a custom message with the errno text and thread ID of the calling thread
 static void tperror(struct thd_opt *thd_opt, const char *msg);
 
@@ -57,6 +57,10 @@ void *tpacket_v2_init(void* thd_opt_p) {
     }
 
 
+    if (thd_alloc_bufs(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
     tpacket_v2_ring_align(thd_opt_p);
 
     if (tpacket_v2_sock(thd_opt) != EXIT_SUCCESS) {
@@ -67,12 +71,12 @@ void *tpacket_v2_init(void* thd_opt_p) {
         tpacket_v2_rx(thd_opt_p);
     } else if (thd_opt->sk_mode == SKT_TX) {
         tpacket_v2_tx(thd_opt_p);
-    } else if (thd_opt->sk_mode == SKT_BIDI) {
-        printf("%" PRIu32 ":Not implemented yet!\n", thd_opt->thd_id);
-        pthread_exit((void*)EXIT_FAILURE);
     }
 
 
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
     pthread_cleanup_pop(0);
     return NULL;
 
@@ -242,62 +246,62 @@ void tpacket_v2_rx(struct thd_opt *thd_opt) {
 
     thd_opt->started = 1;
 
-    /*
-    struct tpacket2_hdr *hdr;
-
-    while (1) {
-
-        for (uint32_t i = 0; i < thd_opt->block_nr; i++) {
-
-            hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_sz * i));
-
-            if ((hdr->tp_status & TP_STATUS_USER) == TP_STATUS_USER) {
-                
-                thd_opt->rx_frms += 1;
-                thd_opt->rx_bytes += hdr->tp_snaplen;
-
-                hdr->tp_status = 0;
-                __sync_synchronize();
-
-            }
-        }
-
-    }
-    */
-
     struct pollfd pfd;
     memset(&pfd, 0, sizeof(pfd));
     pfd.fd = thd_opt->sock;
     pfd.events = POLLIN | POLLERR;
     pfd.revents = 0;
 
-    uint32_t blk_num = 0;
+    uint32_t frm_num = 0;
+    uint32_t drain_left = UINT32_MAX; // Frames left to count once stopped
     struct tpacket2_hdr *hdr = NULL;
 
     while(1) {
 
-        if (poll(&pfd, 1, -1) == -1) {
-            ///// TODO
-            /////tperror(thd_opt, "Rx poll() error");
-            ////pthread_exit((void*)EXIT_FAILURE);
-            thd_opt->sk_err += 1;
-        }
+        // Once stopped count at most one pass of the ring, the frames which
+        // were queued, as it never empties under steady inbound traffic
+        if (drain_left == UINT32_MAX && thd_stopping(thd_opt))
+            drain_left = thd_opt->frame_nr;
+        if (drain_left == 0)
+            break;
+
+        hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * frm_num));
+
+        if (!(hdr->tp_status & TP_STATUS_USER)) {
 
-        if (pfd.revents != POLLIN)
-            printf("%" PRIu32 ":Unexpected poll event %" PRId32 "\n", thd_opt->thd_id, pfd.revents);
+            // Frames already in the ring have been counted, stop here
+            if (drain_left != UINT32_MAX)
+                break;
 
-        hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * blk_num));
+            // Wait with a timeout so that a stop request is noticed on an
+            // idle link
+            if (poll(&pfd, 1, DEF_POLL_TIMEO) == -1 && errno != EINTR)
+                thd_opt->sk_err += 1;
 
-        if (!(hdr->tp_status & TP_STATUS_USER))
-            printf("%" PRIu32 ":No data in ring block, status %" PRIu32 "\n", thd_opt->thd_id, hdr->tp_status);
+            continue;
+        }
 
         thd_opt->rx_frms += 1;
         thd_opt->rx_bytes += hdr->tp_snaplen;
 
-        // Reset the block stats back to KERNEL (userland is finished with it)
+        if (thd_opt->mesh_rx != NULL)
+            mesh_rx(thd_opt, (uint8_t*)hdr + hdr->tp_mac, hdr->tp_snaplen);
+
+        // The Kernel Rx timestamp is on CLOCK_REALTIME
+        if (thd_opt->lat_rx != NULL)
+            lat_rx(thd_opt, (uint8_t*)hdr + hdr->tp_mac, hdr->tp_snaplen,
+                   (hdr->tp_sec * 1000000000ULL) + hdr->tp_nsec);
+
+        if (thd_opt->rfc2544_rx)
+            rfc2544_rx(thd_opt, (uint8_t*)hdr + hdr->tp_mac, hdr->tp_snaplen);
+
+        // Reset the frame status back to KERNEL (userland is finished with it)
         hdr->tp_status = TP_STATUS_KERNEL;
 
-        blk_num = (blk_num + 1) % thd_opt->block_nr;
+        frm_num = (frm_num + 1) % thd_opt->frame_nr;
+
+        if (drain_left != UINT32_MAX)
+            drain_left -= 1;
 
     }
 
@@ -363,6 +367,19 @@ int32_t tpacket_v2_sock(struct thd_opt *thd_opt) {
     }
 
 
+    // Don't block indefinitely so that stop requests are noticed
+    if (sock_op(S_O_TIMEO, thd_opt) == -1) {
+        tperror(thd_opt, "Can't set socket Tx/Rx timeout");
+        return EXIT_FAILURE;
+    }
+
+    // Only count frames which arrived on the wire
+    if (thd_opt->ign_out && sock_op(S_O_IGN_OUT, thd_opt) == -1) {
+        tperror(thd_opt, "Can't ignore outgoing frames on socket");
+        return EXIT_FAILURE;
+    }
+
+
     // Join this socket to the fanout group
     if (thd_opt->thd_nr > 1) {
 
@@ -458,16 +475,43 @@ void tpacket_v2_tx(struct thd_opt *thd_opt) {
     
     struct tpacket2_hdr *hdr;
     uint8_t *data;
-    uint32_t i;
     int64_t ret = 0;
+    uint32_t done_num = 0;  // Oldest slot which may still be in flight
+    uint32_t in_flight = 0; // Frames queued in the ring but not yet sent
+    uint32_t tx_num = 0;    // Next slot to fill, the Kernel's ring head starts at 0
+    uint64_t queued = 0;    // Frames handed to the ring in total
+    uint64_t drain_end = 0; // Time to give up waiting for in-flight frames
+
+    // Mark the slots this thread has queued, so that each frame is counted
+    // exactly once when the Kernel hands the slot back
+    uint8_t *pending = calloc(thd_opt->frame_nr, 1);
+    if (pending == NULL) {
+        tperror(thd_opt, "Can't calloc Tx ring slot list");
+        pthread_exit((void*)EXIT_FAILURE);
+    }
 
     thd_opt->started = 1;
 
 
     while(1) {
 
-        for (i = 0; i < thd_opt->frame_nr; i += 1) {
-            hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * i));
+        if (!drain_end &&
+            (thd_stopping(thd_opt) ||
+             (thd_opt->frm_lim && queued == thd_opt->frm_lim)))
+            drain_end = get_time_ns() + (DEF_DRAIN_TIMEO * 1000000ULL);
+
+        // Refill the free slots, unless stopping, in which case only the
+        // frames already in the ring are sent. Under -t only as many slots
+        // are filled as there are frames due.
+        uint32_t credit = 0;
+        if (!drain_end && in_flight < thd_opt->frame_nr)
+            credit = pace_tx(thd_opt, thd_opt->frame_nr - in_flight);
+
+        // The Kernel sends from its ring head and stops at the first slot
+        // which isn't a send request, so the slots are filled in ring order
+        while (credit && !pending[tx_num]) {
+
+            hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * tx_num));
             // TPACKET2_HDRLEN == (TPACKET_ALIGN(sizeof(struct tpacket2_hdr)) + sizeof(struct sockaddr_ll))
             // For raw Ethernet frames where the layer 2 headers are present
             // and the ring blocks are already aligned its fine to use:
@@ -476,6 +520,15 @@ void tpacket_v2_tx(struct thd_opt *thd_opt) {
             memcpy(data, thd_opt->tx_buffer, thd_opt->frame_sz);
             hdr->tp_len = thd_opt->frame_sz;
             hdr->tp_status = TP_STATUS_SEND_REQUEST;
+            pending[tx_num] = 1;
+            tx_num = (tx_num + 1) % thd_opt->frame_nr;
+            in_flight += 1;
+            queued += 1;
+            credit -= 1;
+
+            // Don't queue more than this thread's share of the frame limit
+            if (queued == thd_opt->frm_lim)
+                break;
             
         }
 
@@ -508,20 +561,49 @@ void tpacket_v2_tx(struct thd_opt *thd_opt) {
 
          Instead we must check the return code from sendto() for -1, and
          then walk the TX ring and check that status flag of each packet in the
-         ring to see if it was transmitted.
+         ring to see if it was transmitted. A timeout (SO_SNDTIMEO) while
+         waiting for the ring to empty is not an error.
         */
-        if (ret == -1) {
+        if (ret == -1 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
             thd_opt->sk_err += 1;
         }
 
-        for (i = 0; i < thd_opt->frame_nr; i += 1) {
-            hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * i));
+        // The slots are sent in ring order too, so stop at the first one
+        // which is free or still in flight
+        while (pending[done_num]) {
+
+            hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * done_num));
             if (hdr->tp_status == TP_STATUS_AVAILABLE) {
                 thd_opt->tx_frms += 1;
                 thd_opt->tx_bytes += thd_opt->frame_sz;
+            } else if (hdr->tp_status & TP_STATUS_WRONG_FORMAT) {
+                thd_opt->sk_err += 1;
+                hdr->tp_status = TP_STATUS_AVAILABLE;
+            } else {
+                break;
             }
-            
+
+            pending[done_num] = 0;
+            done_num = (done_num + 1) % thd_opt->frame_nr;
+            in_flight -= 1;
+
+        }
+
+        if (drain_end) {
+
+            if (in_flight == 0)
+                break;
+
+            if (get_time_ns() >= drain_end) {
+                printf("%" PRIu32 ":%" PRIu32 " frames still in the Tx ring after draining\n",
+                       thd_opt->thd_id, in_flight);
+                break;
+            }
+
         }
 
     }
+
+    free(pending);
+
 }
@@ -57,6 +57,10 @@ void *tpacket_v3_init(void* thd_opt_p) {
     }
 
 
+    if (thd_alloc_bufs(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
     tpacket_v3_ring_align(thd_opt_p);
 
 
@@ -71,24 +75,24 @@ void *tpacket_v3_init(void* thd_opt_p) {
     } else if (thd_opt->sk_mode == SKT_TX) {
         // af_packet.c: packet_set_ring()
         /* Opening a Tx-ring is NOT supported in TPACKET_V3 */
-        #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)
-        tpacket_v3_tx(thd_opt_p);
-        #else
-        uint32_t version     = (LINUX_VERSION_CODE >> 16);
-        uint32_t patch_level = (LINUX_VERSION_CODE & 0xffff) >> 8;
-        uint32_t sub_level   = (LINUX_VERSION_CODE & 0xff);
-        printf("Kernel version detected as %" PRIu32 ".%" PRIu32 ".%" PRIu32
-               ", TPACKET_V3 with PACKET_TX_RING requires 4.11.\n",
-               version, patch_level, sub_level);
-        pthread_exit((void*)EXIT_FAILURE);
-        #endif
+        // before 4.11, checked against the running Kernel rather than
+        // the one this was built on
+        uint32_t kernel_ver = probe_kernel_ver();
+        if (kernel_ver == 0 || kernel_ver >= KERNEL_VERSION(4,11,0)) {
+            tpacket_v3_tx(thd_opt_p);
+        } else {
+            printf("Kernel version detected as %" PRIu32 ".%" PRIu32 ".%" PRIu32
+                   ", TPACKET_V3 with PACKET_TX_RING requires 4.11.\n",
+                   kernel_ver >> 16, (kernel_ver >> 8) & 0xff, kernel_ver & 0xff);
+            pthread_exit((void*)EXIT_FAILURE);
+        }
         
-    } else if (thd_opt->sk_mode == SKT_BIDI) {
-        printf("%" PRIu32 ":Not implemented yet!\n", thd_opt->thd_id);
-        pthread_exit((void*)EXIT_FAILURE);
     }
 
 
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
     pthread_cleanup_pop(0);
     return NULL;
 
@@ -286,26 +290,34 @@ void tpacket_v3_rx(struct thd_opt *thd_opt) {
 
 
     uint32_t blk_num = 0;
+    uint32_t drain_left = UINT32_MAX; // Blocks left to count once stopped
     struct block_desc *pbd = NULL;
 
     thd_opt->started = 1;
     
     while (1) {
+
+        // Once stopped count at most one pass of the ring, the blocks which
+        // were retired, as it never empties under steady inbound traffic
+        if (drain_left == UINT32_MAX && thd_stopping(thd_opt))
+            drain_left = thd_opt->block_nr;
+        if (drain_left == 0)
+            break;
+
         pbd = (struct block_desc *) thd_opt->ring[blk_num].iov_base;
  
         if ((pbd->h1.block_status & TP_STATUS_USER) == 0) {
-            int32_t poll_ret = poll(&pfd, 1, -1);
 
-            if (poll_ret == -1) {
-                ///// TODO
-                /////tperror(thd_opt, "Rx poll error");
-                /////pthread_exit((void*)EXIT_FAILURE);
-                thd_opt->sk_err += 1;
-            }
+            // Blocks already retired to userland have been counted, stop here
+            if (drain_left != UINT32_MAX)
+                break;
 
-            if (pfd.revents != POLLIN)
-                printf("Unexpected poll event (%d)", pfd.revents);
+            // Wait with a timeout so that a stop request is noticed on an
+            // idle link
+            if (poll(&pfd, 1, DEF_POLL_TIMEO) == -1 && errno != EINTR)
+                thd_opt->sk_err += 1;
 
+            continue;
         }
 
 
@@ -318,6 +330,17 @@ void tpacket_v3_rx(struct thd_opt *thd_opt) {
         for (uint32_t i = 0; i < num_frms; ++i) {
             bytes += ppd->tp_snaplen;
 
+            if (thd_opt->mesh_rx != NULL)
+                mesh_rx(thd_opt, (uint8_t*)ppd + ppd->tp_mac, ppd->tp_snaplen);
+
+            // The Kernel Rx timestamp is on CLOCK_REALTIME
+            if (thd_opt->lat_rx != NULL)
+                lat_rx(thd_opt, (uint8_t*)ppd + ppd->tp_mac, ppd->tp_snaplen,
+                       (ppd->tp_sec * 1000000000ULL) + ppd->tp_nsec);
+
+            if (thd_opt->rfc2544_rx)
+                rfc2544_rx(thd_opt, (uint8_t*)ppd + ppd->tp_mac, ppd->tp_snaplen);
+
             ppd = (struct tpacket3_hdr *) ((uint8_t *) ppd + ppd->tp_next_offset);
         }
 
@@ -329,6 +352,9 @@ void tpacket_v3_rx(struct thd_opt *thd_opt) {
         pbd->h1.block_status = TP_STATUS_KERNEL;
 
         blk_num = (blk_num + 1) % thd_opt->block_nr;
+
+        if (drain_left != UINT32_MAX)
+            drain_left -= 1;
     }   
 
 
@@ -395,6 +421,19 @@ int32_t tpacket_v3_sock(struct thd_opt *thd_opt) {
     }
 
 
+    // Don't block indefinitely so that stop requests are noticed
+    if (sock_op(S_O_TIMEO, thd_opt) == -1) {
+        tperror(thd_opt, "Can't set socket Tx/Rx timeout");
+        return EXIT_FAILURE;
+    }
+
+    // Only count frames which arrived on the wire
+    if (thd_opt->ign_out && sock_op(S_O_IGN_OUT, thd_opt) == -1) {
+        tperror(thd_opt, "Can't ignore outgoing frames on socket");
+        return EXIT_FAILURE;
+    }
+
+
     // Join this socket to the fanout group
     if (thd_opt->thd_nr > 1) {
 
@@ -491,9 +530,21 @@ void tpacket_v3_tx(struct thd_opt *thd_opt) {
     
     struct tpacket3_hdr *hdr;
     uint8_t *data;
-    uint32_t i;
     int64_t ret = 0;
-    
+    uint32_t done_num = 0;  // Oldest slot which may still be in flight
+    uint32_t in_flight = 0; // Frames queued in the ring but not yet sent
+    uint32_t tx_num = 0;    // Next slot to fill, the Kernel's ring head starts at 0
+    uint64_t queued = 0;    // Frames handed to the ring in total
+    uint64_t drain_end = 0; // Time to give up waiting for in-flight frames
+
+    // Mark the slots this thread has queued, so that each frame is counted
+    // exactly once when the Kernel hands the slot back
+    uint8_t *pending = calloc(thd_opt->frame_nr, 1);
+    if (pending == NULL) {
+        tperror(thd_opt, "Can't calloc Tx ring slot list");
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
     thd_opt->started = 1;
 
     /*
@@ -515,12 +566,26 @@ void tpacket_v3_tx(struct thd_opt *thd_opt) {
           Packets with non-zero values of tp_next_offset will be dropped.
     */
 
-    
+
     while(1) {
 
+        if (!drain_end &&
+            (thd_stopping(thd_opt) ||
+             (thd_opt->frm_lim && queued == thd_opt->frm_lim)))
+            drain_end = get_time_ns() + (DEF_DRAIN_TIMEO * 1000000ULL);
+
+        // Refill the free slots, unless stopping, in which case only the
+        // frames already in the ring are sent. Under -t only as many slots
+        // are filled as there are frames due.
+        uint32_t credit = 0;
+        if (!drain_end && in_flight < thd_opt->frame_nr)
+            credit = pace_tx(thd_opt, thd_opt->frame_nr - in_flight);
 
-        for (i = 0; i < thd_opt->frame_nr; i += 1) {
-            hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * i));
+        // The Kernel sends from its ring head and stops at the first slot
+        // which isn't a send request, so the slots are filled in ring order
+        while (credit && !pending[tx_num]) {
+
+            hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * tx_num));
             ///// TODO
             // TPACKET2_HDRLEN == (TPACKET_ALIGN(sizeof(struct tpacket2_hdr)) + sizeof(struct sockaddr_ll))   ///// Update for TPACKET V3
             // For raw Ethernet frames where the layer 2 headers are present
@@ -530,26 +595,63 @@ void tpacket_v3_tx(struct thd_opt *thd_opt) {
             memcpy(data, thd_opt->tx_buffer, thd_opt->frame_sz);
             hdr->tp_len = thd_opt->frame_sz;
             hdr->tp_status = TP_STATUS_SEND_REQUEST;
+            pending[tx_num] = 1;
+            tx_num = (tx_num + 1) % thd_opt->frame_nr;
+            in_flight += 1;
+            queued += 1;
+            credit -= 1;
+
+            // Don't queue more than this thread's share of the frame limit
+            if (queued == thd_opt->frm_lim)
+                break;
             
         }
 
         ret = send(thd_opt->sock, NULL, 0, 0);
 
 
-        if (ret == -1) {
+        // A timeout (SO_SNDTIMEO) while waiting for the ring to empty is
+        // not an error
+        if (ret == -1 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
             thd_opt->sk_err += 1;
         }
 
-        for (i = 0; i < thd_opt->frame_nr; i += 1) {
-            hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * i));
+        // The slots are sent in ring order too, so stop at the first one
+        // which is free or still in flight
+        while (pending[done_num]) {
+
+            hdr = (void*)(thd_opt->mmap_buf + (thd_opt->block_frm_sz * done_num));
             if (hdr->tp_status == TP_STATUS_AVAILABLE) {
                 thd_opt->tx_frms += 1;
                 thd_opt->tx_bytes += thd_opt->frame_sz;
+            } else if (hdr->tp_status & TP_STATUS_WRONG_FORMAT) {
+                thd_opt->sk_err += 1;
+                hdr->tp_status = TP_STATUS_AVAILABLE;
+            } else {
+                break;
             }
-            
+
+            pending[done_num] = 0;
+            done_num = (done_num + 1) % thd_opt->frame_nr;
+            in_flight -= 1;
+
         }
 
+        if (drain_end) {
+
+            if (in_flight == 0)
+                break;
+
+            if (get_time_ns() >= drain_end) {
+                printf("%" PRIu32 ":%" PRIu32 " frames still in the Tx ring after draining\n",
+                       thd_opt->thd_id, in_flight);
+                break;
+            }
+
+        }
 
     }
 
+    free(pending);
+
 }
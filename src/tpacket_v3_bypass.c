@@ -39,6 +39,14 @@ void *tpacket_v3_init() {
 
 
 
+void *reflect_init() {
+
+    return tpacket_v3_init();
+
+}
+
+
+
 void tpacket_v3_stats() {
     return;
 }
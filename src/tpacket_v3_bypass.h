@@ -31,6 +31,8 @@
 // Fake function calls
 void *tpacket_v3_init();
 
+void *reflect_init();
+
 void tpacket_v3_stats();
 
 #endif // _TPACKET_V3_BYPASS_H_
\ No newline at end of file
@@ -0,0 +1,445 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "xdp.h"
+
+
+
+void *xdp_init(void* thd_opt_p) {
+
+    struct thd_opt *thd_opt = thd_opt_p;
+
+
+    // Save the thread tid
+    pid_t thread_id;
+    thread_id = syscall(SYS_gettid);
+    thd_opt->thd_id = thread_id;
+
+
+    // Set the thread cancel type and register the cleanup handler
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    pthread_cleanup_push(thd_cleanup, thd_opt_p);
+
+    
+    if (thd_opt->verbose) {
+        if (thd_opt->affinity >= 0) {
+            printf(
+                "Worker thread %" PRIu32 " started, bound to CPU %" PRId32 "\n",
+                thd_opt->thd_id, thd_opt->affinity
+            );
+        } else {
+            printf("Worker thread %" PRIu32 " started\n", thd_opt->thd_id);
+        }
+    }
+
+
+    if (xdp_load(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+
+    // Try native (driver) mode first, generic mode works with any driver but
+    // runs after the skb has been allocated, so it is much slower
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.link_create.prog_fd        = thd_opt->xdp_prog;
+    attr.link_create.target_ifindex = thd_opt->if_index;
+    attr.link_create.attach_type    = BPF_XDP;
+    attr.link_create.flags          = XDP_FLAGS_DRV_MODE;
+
+    thd_opt->xdp_link = syscall(SYS_bpf, BPF_LINK_CREATE, &attr, sizeof(attr));
+
+    if (thd_opt->xdp_link == -1) {
+        attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+        thd_opt->xdp_link = syscall(SYS_bpf, BPF_LINK_CREATE, &attr, sizeof(attr));
+
+        if (thd_opt->xdp_link != -1)
+            printf("%" PRIu32 ":%s has no native XDP support, using generic mode\n",
+                   thd_opt->thd_id, thd_opt->if_name);
+    }
+
+    if (thd_opt->xdp_link == -1) {
+        tperror(thd_opt, "Can't attach XDP program");
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+
+    // All the work is done in the Kernel, wait to be stopped
+    thd_opt->started = 1;
+
+    while(!thd_stopping(thd_opt)) {
+        nanosleep(&(struct timespec){ .tv_sec = 0, .tv_nsec = DEF_POLL_TIMEO * 1000000L }, NULL);
+    }
+
+    // Closing the link detaches the program, the map stays open until
+    // thd_cleanup() so that the stats thread can take the final sample
+    if (close(thd_opt->xdp_link) != 0)
+        tperror(thd_opt, "Can't detach XDP program");
+    thd_opt->xdp_link = 0;
+
+
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
+    pthread_cleanup_pop(0);
+    return NULL;
+
+}
+
+
+
+void *xdp_live_init(void* thd_opt_p) {
+
+    struct thd_opt *thd_opt = thd_opt_p;
+
+
+    // Save the thread tid
+    pid_t thread_id;
+    thread_id = syscall(SYS_gettid);
+    thd_opt->thd_id = thread_id;
+
+
+    // Set the thread cancel type and register the cleanup handler
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    pthread_cleanup_push(thd_cleanup, thd_opt_p);
+
+    
+    if (thd_opt->verbose) {
+        if (thd_opt->affinity >= 0) {
+            printf(
+                "Worker thread %" PRIu32 " started, bound to CPU %" PRId32 "\n",
+                thd_opt->thd_id, thd_opt->affinity
+            );
+        } else {
+            printf("Worker thread %" PRIu32 " started\n", thd_opt->thd_id);
+        }
+    }
+
+
+    if (thd_alloc_bufs(thd_opt) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+
+    // Every frame the Kernel builds from the template is sent, return XDP_TX
+    struct bpf_insn insns[] = {
+        { .code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_0, .imm = XDP_TX },
+        { .code = BPF_JMP | BPF_EXIT },
+    };
+
+    if (xdp_prog_load(thd_opt, insns, sizeof(insns) / sizeof(insns[0])) != EXIT_SUCCESS) {
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
+
+    xdp_live_tx(thd_opt);
+
+
+    // Let the monitor know this worker has finished
+    thd_stop(thd_opt);
+
+    pthread_cleanup_pop(0);
+    return NULL;
+
+}
+
+
+
+void xdp_live_tx(struct thd_opt *thd_opt) {
+
+    // XDP_TX sends out of the "ingress" interface, which live frames mode
+    // takes from the context, and the context must describe the whole frame
+    struct xdp_md ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.data_end        = thd_opt->frame_sz;
+    ctx.ingress_ifindex = thd_opt->if_index;
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.test.prog_fd      = thd_opt->xdp_prog;
+    attr.test.data_in      = (uint64_t)(uintptr_t)thd_opt->tx_buffer;
+    attr.test.data_size_in = thd_opt->frame_sz;
+    attr.test.ctx_in       = (uint64_t)(uintptr_t)&ctx;
+    attr.test.ctx_size_in  = sizeof(ctx);
+    attr.test.flags        = BPF_F_TEST_XDP_LIVE_FRAMES;
+
+    thd_opt->started = 1;
+
+    while(!thd_stopping(thd_opt)) {
+
+        // Each call runs until it has sent repeat frames, so keep it short
+        // enough to notice a stop and to send exactly frm_lim frames
+        uint32_t repeat = XDP_LIVE_REPEAT;
+        if (thd_opt->frm_lim && thd_opt->frm_lim - thd_opt->tx_frms < repeat)
+            repeat = thd_opt->frm_lim - thd_opt->tx_frms;
+
+        // Only send the frames due under -t
+        repeat = pace_tx(thd_opt, repeat);
+        if (repeat == 0)
+            continue;
+
+        attr.test.repeat = repeat;
+
+        if (syscall(SYS_bpf, BPF_PROG_TEST_RUN, &attr, sizeof(attr)) == -1) {
+
+            // Interrupted part way through, the frames sent are unknown
+            if (errno == EINTR) {
+                thd_opt->sk_err += 1;
+                continue;
+            }
+
+            tperror(thd_opt, "Can't run XDP program in live frames mode");
+            pthread_exit((void*)EXIT_FAILURE);
+        }
+
+        thd_opt->tx_bytes += (uint64_t)repeat * thd_opt->frame_sz;
+        thd_opt->tx_frms  += repeat;
+
+        if (thd_opt->frm_lim && thd_opt->tx_frms >= thd_opt->frm_lim)
+            break;
+
+    }
+
+}
+
+
+
+int32_t xdp_load(struct thd_opt *thd_opt) {
+
+    // The Kernel copies out one value per possible CPU, not online CPU
+    cpu_set_t possible;
+    if (cpu_list_read("/sys/devices/system/cpu/possible", &possible) != EXIT_SUCCESS) {
+        tperror(thd_opt, "Can't read the possible CPU list");
+        return EXIT_FAILURE;
+    }
+
+    thd_opt->xdp_cpus = 0;
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu += 1) {
+        if (CPU_ISSET(cpu, &possible)) thd_opt->xdp_cpus = cpu + 1;
+    }
+
+    thd_opt->xdp_ctrs = calloc(thd_opt->xdp_cpus, sizeof(struct xdp_ctr));
+    if (thd_opt->xdp_ctrs == NULL) {
+        tperror(thd_opt, "Can't calloc XDP counter buffer");
+        return EXIT_FAILURE;
+    }
+
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.map_type    = BPF_MAP_TYPE_PERCPU_ARRAY;
+    attr.key_size    = sizeof(uint32_t);
+    attr.value_size  = sizeof(struct xdp_ctr);
+    attr.max_entries = 1;
+
+    thd_opt->xdp_map = syscall(SYS_bpf, BPF_MAP_CREATE, &attr, sizeof(attr));
+
+    if (thd_opt->xdp_map == -1) {
+        tperror(thd_opt, "Can't create XDP counter map");
+        return EXIT_FAILURE;
+    }
+
+
+    // Count the frame in this CPU's map entry, then drop or reflect it:
+    // r6 = ctx, key = 0, r0 = map_lookup_elem(map, &key), if r0 == NULL skip
+    // the count, r0->frms += 1, r0->bytes += xdp_get_buff_len(ctx)
+    struct bpf_insn count[] = {
+        { .code = BPF_ALU64 | BPF_MOV | BPF_X, .dst_reg = BPF_REG_6, .src_reg = BPF_REG_1 },
+        { .code = BPF_ST | BPF_MEM | BPF_W, .dst_reg = BPF_REG_10, .off = -4, .imm = XDP_MAP_KEY },
+        { .code = BPF_LD | BPF_DW | BPF_IMM, .dst_reg = BPF_REG_1, .src_reg = BPF_PSEUDO_MAP_FD, .imm = thd_opt->xdp_map },
+        { .code = 0 },
+        { .code = BPF_ALU64 | BPF_MOV | BPF_X, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_10 },
+        { .code = BPF_ALU64 | BPF_ADD | BPF_K, .dst_reg = BPF_REG_2, .imm = -4 },
+        { .code = BPF_JMP | BPF_CALL, .imm = BPF_FUNC_map_lookup_elem },
+        { .code = BPF_JMP | BPF_JEQ | BPF_K, .dst_reg = BPF_REG_0, .off = 9, .imm = 0 },
+        { .code = BPF_ALU64 | BPF_MOV | BPF_X, .dst_reg = BPF_REG_7, .src_reg = BPF_REG_0 },
+        { .code = BPF_ALU64 | BPF_MOV | BPF_X, .dst_reg = BPF_REG_1, .src_reg = BPF_REG_6 },
+        { .code = BPF_JMP | BPF_CALL, .imm = BPF_FUNC_xdp_get_buff_len },
+        { .code = BPF_LDX | BPF_MEM | BPF_DW, .dst_reg = BPF_REG_1, .src_reg = BPF_REG_7, .off = offsetof(struct xdp_ctr, frms) },
+        { .code = BPF_ALU64 | BPF_ADD | BPF_K, .dst_reg = BPF_REG_1, .imm = 1 },
+        { .code = BPF_STX | BPF_MEM | BPF_DW, .dst_reg = BPF_REG_7, .src_reg = BPF_REG_1, .off = offsetof(struct xdp_ctr, frms) },
+        { .code = BPF_LDX | BPF_MEM | BPF_DW, .dst_reg = BPF_REG_1, .src_reg = BPF_REG_7, .off = offsetof(struct xdp_ctr, bytes) },
+        { .code = BPF_ALU64 | BPF_ADD | BPF_X, .dst_reg = BPF_REG_1, .src_reg = BPF_REG_0 },
+        { .code = BPF_STX | BPF_MEM | BPF_DW, .dst_reg = BPF_REG_7, .src_reg = BPF_REG_1, .off = offsetof(struct xdp_ctr, bytes) },
+    };
+
+    // return XDP_DROP
+    struct bpf_insn drop[] = {
+        { .code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_0, .imm = XDP_DROP },
+        { .code = BPF_JMP | BPF_EXIT },
+    };
+
+    // r2 = data, if data + 12 > data_end drop the runt, else swap the six
+    // 16 bit words of the destination and source MACs and return XDP_TX
+    struct bpf_insn reflect[] = {
+        { .code = BPF_LDX | BPF_MEM | BPF_W, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_6, .off = offsetof(struct xdp_md, data) },
+        { .code = BPF_LDX | BPF_MEM | BPF_W, .dst_reg = BPF_REG_3, .src_reg = BPF_REG_6, .off = offsetof(struct xdp_md, data_end) },
+        { .code = BPF_ALU64 | BPF_MOV | BPF_X, .dst_reg = BPF_REG_4, .src_reg = BPF_REG_2 },
+        { .code = BPF_ALU64 | BPF_ADD | BPF_K, .dst_reg = BPF_REG_4, .imm = ETH_ALEN * 2 },
+        { .code = BPF_JMP | BPF_JGT | BPF_X, .dst_reg = BPF_REG_4, .src_reg = BPF_REG_3, .off = 14 },
+        { .code = BPF_LDX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_3, .src_reg = BPF_REG_2, .off = 0 },
+        { .code = BPF_LDX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_4, .src_reg = BPF_REG_2, .off = 6 },
+        { .code = BPF_STX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_4, .off = 0 },
+        { .code = BPF_STX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_3, .off = 6 },
+        { .code = BPF_LDX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_3, .src_reg = BPF_REG_2, .off = 2 },
+        { .code = BPF_LDX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_4, .src_reg = BPF_REG_2, .off = 8 },
+        { .code = BPF_STX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_4, .off = 2 },
+        { .code = BPF_STX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_3, .off = 8 },
+        { .code = BPF_LDX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_3, .src_reg = BPF_REG_2, .off = 4 },
+        { .code = BPF_LDX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_4, .src_reg = BPF_REG_2, .off = 10 },
+        { .code = BPF_STX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_4, .off = 4 },
+        { .code = BPF_STX | BPF_MEM | BPF_H, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_3, .off = 10 },
+        { .code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_0, .imm = XDP_TX },
+        { .code = BPF_JMP | BPF_EXIT },
+        { .code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_0, .imm = XDP_DROP },
+        { .code = BPF_JMP | BPF_EXIT },
+    };
+
+    struct bpf_insn insns[sizeof(count) / sizeof(count[0]) + sizeof(reflect) / sizeof(reflect[0])];
+    uint32_t insn_cnt = sizeof(count) / sizeof(count[0]);
+
+    memcpy(insns, count, sizeof(count));
+
+    if (thd_opt->xdp_act == XDP_TX) {
+        memcpy(&insns[insn_cnt], reflect, sizeof(reflect));
+        insn_cnt += sizeof(reflect) / sizeof(reflect[0]);
+    } else {
+        memcpy(&insns[insn_cnt], drop, sizeof(drop));
+        insn_cnt += sizeof(drop) / sizeof(drop[0]);
+    }
+
+    if (xdp_prog_load(thd_opt, insns, insn_cnt) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    if (thd_opt->verbose)
+        printf("%" PRIu32 ":Loaded XDP program (fd %" PRId32 ") with counter map (fd %" PRId32 ")\n",
+               thd_opt->thd_id, thd_opt->xdp_prog, thd_opt->xdp_map);
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+int32_t xdp_prog_load(struct thd_opt *thd_opt, struct bpf_insn *insns, uint32_t insn_cnt) {
+
+    // With log_level 1 the verifier logs every instruction, and the load
+    // fails with ENOSPC if the log doesn't fit
+    char log_buf[16384] = {0};
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.prog_type            = BPF_PROG_TYPE_XDP;
+    attr.expected_attach_type = BPF_XDP;
+    attr.insns                = (uint64_t)(uintptr_t)insns;
+    attr.insn_cnt             = insn_cnt;
+    attr.license              = (uint64_t)(uintptr_t)"GPL";
+    attr.log_buf              = (uint64_t)(uintptr_t)log_buf;
+    attr.log_size             = sizeof(log_buf);
+    attr.log_level            = 1;
+
+    thd_opt->xdp_prog = syscall(SYS_bpf, BPF_PROG_LOAD, &attr, sizeof(attr));
+
+    if (thd_opt->xdp_prog == -1) {
+        tperror(thd_opt, "Can't load XDP program");
+        if (thd_opt->verbose && log_buf[0] != 0)
+            printf("%s\n", log_buf);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+}
+
+
+
+void xdp_sample(struct thd_opt *thd_opt) {
+
+    uint32_t key = XDP_MAP_KEY;
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.map_fd = thd_opt->xdp_map;
+    attr.key    = (uint64_t)(uintptr_t)&key;
+    attr.value  = (uint64_t)(uintptr_t)thd_opt->xdp_ctrs;
+
+    if (syscall(SYS_bpf, BPF_MAP_LOOKUP_ELEM, &attr, sizeof(attr)) == -1) {
+        thd_opt->sk_err += 1;
+        return;
+    }
+
+    uint64_t bytes = 0;
+    uint64_t frms  = 0;
+
+    for (uint32_t cpu = 0; cpu < thd_opt->xdp_cpus; cpu += 1) {
+        bytes += thd_opt->xdp_ctrs[cpu].bytes;
+        frms  += thd_opt->xdp_ctrs[cpu].frms;
+    }
+
+    thd_opt->rx_bytes = bytes;
+    thd_opt->rx_frms  = frms;
+
+    // Every counted frame is sent back, XDP_TX failures are only visible
+    // to the xdp:xdp_exception tracepoint
+    if (thd_opt->xdp_act == XDP_TX) {
+        thd_opt->tx_bytes = bytes;
+        thd_opt->tx_frms  = frms;
+    }
+
+}
+
+
+
+int32_t xdp_setup(struct etherate *eth) {
+
+    if (eth->app_opt.sk_mode != SKT_RX && eth->app_opt.sk_mode != SKT_REFLECT) {
+        printf("Oops! --xdp can only be used with -r or -R.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.mesh) {
+        printf("Oops! --xdp can't be used in mesh mode.\n");
+        return EX_SOFTWARE;
+    }
+
+    if (eth->app_opt.q_map != QMAP_OFF) {
+        printf("Oops! --xdp can't be used with -Q.\n");
+        return EX_SOFTWARE;
+    }
+
+    // An interface can only have one XDP program, which runs on every Rx queue
+    if (eth->app_opt.thd_nr > eth->sk_opt.if_nr)
+        printf("Using one XDP program per interface, -c is ignored.\n");
+
+    eth->app_opt.thd_nr = eth->sk_opt.if_nr;
+
+    return EXIT_SUCCESS;
+
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _XDP_H_
+#define _XDP_H_
+
+/*
+ * XDP mode: instead of AF_PACKET workers each interface gets a small XDP
+ * program which counts every frame into a per-CPU array map and then drops
+ * it (-r) or sends it back out with the MACs swapped (-R). The worker only
+ * attaches the program and waits, the stats thread reads the map.
+ *
+ * Live frames mode (-p5) is a Tx engine: BPF_PROG_TEST_RUN runs an XDP_TX
+ * program on copies of the test frame, which the Kernel sends straight into
+ * the driver's XDP transmit path without a syscall per frame.
+ */
+
+#define XDP_LIVE_REPEAT 65536 // Frames per BPF_PROG_TEST_RUN call in live frames mode
+#define XDP_MAP_KEY     0     // The map has a single entry of struct xdp_ctr
+
+struct xdp_ctr {
+    uint64_t frms;
+    uint64_t bytes;
+};
+
+// Worker thread entry function
+void *xdp_init(void* thd_opt_p);
+
+// Worker thread entry function for live frames mode
+void *xdp_live_init(void* thd_opt_p);
+
+// Have the Kernel build and send frames from the template in live frames mode
+void xdp_live_tx(struct thd_opt *thd_opt);
+
+// Create the counter map and load the drop or reflect program
+int32_t xdp_load(struct thd_opt *thd_opt);
+
+// Load an XDP program, printing the verifier log on failure if verbose
+int32_t xdp_prog_load(struct thd_opt *thd_opt, struct bpf_insn *insns, uint32_t insn_cnt);
+
+// Sum the per-CPU counters into the worker's Rx (and Tx) counters
+void xdp_sample(struct thd_opt *thd_opt);
+
+// Check the options and use one worker per interface
+int32_t xdp_setup(struct etherate *eth);
+
+#endif // _XDP_H_
\ No newline at end of file
@@ -0,0 +1,61 @@
+/*
+ * License: MIT
+ *
+ * Copyright (c) 2017-2020 James Bensley.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+void *xdp_init() {
+
+    uint32_t version     = (LINUX_VERSION_CODE >> 16);
+    uint32_t patch_level = (LINUX_VERSION_CODE & 0xffff) >> 8;
+    uint32_t sub_level   = (LINUX_VERSION_CODE & 0xff);
+
+    printf("Kernel version detected as %" PRIu32 ".%" PRIu32 ".%" PRIu32 ", XDP mode not supported.\n", version, patch_level, sub_level);
+
+    return NULL;
+
+}
+
+
+
+void *xdp_live_init() {
+
+    return xdp_init();
+
+}
+
+
+
+void xdp_sample() {
+    return;
+}
+
+
+
+int32_t xdp_setup() {
+
+    xdp_init();
+    return EX_SOFTWARE;
+
+}
\ No newline at end of file